@@ -0,0 +1,256 @@
+// Compares row-major and Z-order (Morton) layouts for the tile layers and the pathfinder's search state on wide worlds,
+// each with the tiles read from separate layers (tile type, base cost, congestion cost) or from packed tile records.
+// All runs do the exact same searches, the path length checksum printed per run has to match. Every search starts and
+// ends on open tiles of the same connected area, so each one finds a path.
+//
+// Usage: PathfindingBenchmark [height] [width...]
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <queue>
+#include <iostream>
+#include <iomanip>
+#include <cstdint>
+#include <algorithm>
+
+#include "Map.hpp"
+#include "Pathfinding.hpp"
+#include "TileRecord.hpp"
+#include "CounterRNG.hpp"
+#include "Util.hpp"
+
+namespace
+{
+constexpr std::size_t searchCount = 128;
+constexpr std::size_t maxSearchDistance = 384;
+
+using Endpoints = std::vector<std::pair<std::pair<std::size_t, std::size_t>, std::pair<std::size_t, std::size_t>>>;
+
+// The layers pathfinding reads, kept apart like in the simulation
+template<template<typename> typename Storage>
+struct Layers final
+{
+   Map<TileType    , Storage<TileType    >> worldMap;
+   Map<std::uint8_t, Storage<std::uint8_t>> baseCostMap;
+   Map<std::uint8_t, Storage<std::uint8_t>> congestionCostMap;
+};
+
+template<template<typename> typename Storage>
+Layers<Storage> makeLayers(const std::size_t width, const std::size_t height)
+{
+   Layers<Storage> layers{{width, height, TileType::Grass}, {width, height, 0}, {width, height, 0}};
+
+   // Grass with a fifth of the tiles covered by buildings and some congestion, the same for every layout
+   for (std::size_t y = 0; y < height; ++y)
+   {
+      for (std::size_t x = 0; x < width; ++x)
+      {
+         CounterRNG tileRNG{1, RNGSubsystem::BaseCost, y * width + x};
+
+         layers.worldMap.at(x, y) = (std::uniform_int_distribution<>{0, 4}(tileRNG) == 0) ? TileType::Building : TileType::Grass;
+         layers.baseCostMap.at(x, y) = static_cast<std::uint8_t>(std::uniform_int_distribution<>{10, 16}(tileRNG));
+         layers.congestionCostMap.at(x, y) = static_cast<std::uint8_t>(std::uniform_int_distribution<>{0, 3}(tileRNG));
+      }
+   }
+
+   return layers;
+}
+
+template<template<typename> typename Storage>
+Map<TileRecord, Storage<TileRecord>> makeTileRecords(const Layers<Storage>& layers)
+{
+   const auto width = layers.worldMap.width();
+   const auto height = layers.worldMap.height();
+
+   Map<TileRecord, Storage<TileRecord>> tileRecords{width, height, TileRecord{}};
+
+   for (std::size_t y = 0; y < height; ++y)
+   {
+      for (std::size_t x = 0; x < width; ++x)
+      {
+         tileRecords.at(x, y) = makeTileRecord(layers.worldMap.at(x, y), layers.baseCostMap.at(x, y), layers.congestionCostMap.at(x, y));
+      }
+   }
+
+   return tileRecords;
+}
+
+// Labels the areas of open tiles that are connected through straight steps. Diagonal steps need both straight
+// neighbours open, so they never connect anything more.
+std::vector<std::uint32_t> labelAreas(const Map<TileType>& worldMap)
+{
+   const auto width = worldMap.width();
+   const auto height = worldMap.height();
+
+   std::vector<std::uint32_t> areaLabels(width * height, 0);
+   std::uint32_t nextAreaLabel = 1;
+
+   std::queue<std::pair<std::size_t, std::size_t>> openTiles;
+
+   for (std::size_t y = 0; y < height; ++y)
+   {
+      for (std::size_t x = 0; x < width; ++x)
+      {
+         if (isBlockedForVillagers(worldMap.at(x, y)) || areaLabels[y * width + x] != 0)
+            continue;
+
+         areaLabels[y * width + x] = nextAreaLabel;
+         openTiles.emplace(x, y);
+
+         while (openTiles.empty() == false)
+         {
+            const auto [tileX, tileY] = openTiles.front();
+            openTiles.pop();
+
+            auto visit = [&] (const std::size_t neighborX, const std::size_t neighborY)
+            {
+               if (isBlockedForVillagers(worldMap.at(neighborX, neighborY)) || areaLabels[neighborY * width + neighborX] != 0)
+                  return;
+
+               areaLabels[neighborY * width + neighborX] = nextAreaLabel;
+               openTiles.emplace(neighborX, neighborY);
+            };
+
+            if (tileX > 0)          visit(tileX - 1, tileY);
+            if (tileX < width - 1)  visit(tileX + 1, tileY);
+            if (tileY > 0)          visit(tileX, tileY - 1);
+            if (tileY < height - 1) visit(tileX, tileY + 1);
+         }
+
+         ++nextAreaLabel;
+      }
+   }
+
+   return areaLabels;
+}
+
+Endpoints makeEndpoints(const Map<TileType>& worldMap)
+{
+   const auto width = worldMap.width();
+   const auto height = worldMap.height();
+
+   const auto areaLabels = labelAreas(worldMap);
+
+   Endpoints endpoints;
+
+   CounterRNG rng{1, RNGSubsystem::Pathfinding};
+
+   while (endpoints.size() < searchCount)
+   {
+      const auto startX = std::uniform_int_distribution<std::size_t>{0, width  - 1}(rng);
+      const auto startY = std::uniform_int_distribution<std::size_t>{0, height - 1}(rng);
+
+      const auto endX = std::clamp<std::size_t>(startX + std::uniform_int_distribution<std::size_t>{0, 2 * maxSearchDistance}(rng), maxSearchDistance, width  - 1 + maxSearchDistance) - maxSearchDistance;
+      const auto endY = std::clamp<std::size_t>(startY + std::uniform_int_distribution<std::size_t>{0, 2 * maxSearchDistance}(rng), maxSearchDistance, height - 1 + maxSearchDistance) - maxSearchDistance;
+
+      const auto startAreaLabel = areaLabels[startY * width + startX];
+
+      if (startAreaLabel == 0 || areaLabels[endY * width + endX] != startAreaLabel)
+         continue; // Blocked or unreachable
+
+      endpoints.emplace_back(std::make_pair(startX, startY), std::make_pair(endX, endY));
+   }
+
+   return endpoints;
+}
+
+// Same callables as PathfindingService::findPath, isBlockedAt(x, y) and costAt(x, y) are the only ways tiles are read
+template<typename PathfinderType, typename IsBlockedAt, typename CostAt>
+void run(const char* layoutName, const char* layersName, const std::size_t width, const std::size_t height, const Endpoints& endpoints, const IsBlockedAt& isBlockedAt, const CostAt& costAt)
+{
+   PathfinderType pathfinder{width, height};
+
+   auto canTraverse = [&] (const std::size_t fromX, const std::size_t fromY, const std::size_t toX, const std::size_t toY)
+   {
+      if (isBlockedAt(toX, toY))
+         return false;
+
+      if (fromX == toX || fromY == toY)
+         return true;
+
+      return ((isBlockedAt(fromX, toY) == false) && (isBlockedAt(toX, fromY) == false));
+   };
+
+   auto getTraversalCost = [&] (const std::size_t fromX, const std::size_t fromY, const std::size_t toX, const std::size_t toY)
+   {
+      const std::uint8_t factor = (fromX != toX && fromY != toY) ? 14 : 10;
+
+      return static_cast<std::int32_t>(factor * costAt(toX, toY));
+   };
+
+   auto heuristic = [&] (const std::size_t fromX, const std::size_t fromY, const std::size_t toX, const std::size_t toY)
+   {
+      const auto diffX = absDiff(fromX, toX);
+      const auto diffY = absDiff(fromY, toY);
+
+      return static_cast<std::int32_t>(10 * (diffX + diffY) - 6 * std::min(diffX, diffY));
+   };
+
+   std::size_t pathLengthChecksum = 0;
+
+   const auto startTime = std::chrono::steady_clock::now();
+
+   for (const auto& [start, end] : endpoints)
+   {
+      pathLengthChecksum += pathfinder.getPath(start.first, start.second, end.first, end.second, canTraverse, getTraversalCost, heuristic).size();
+   }
+
+   const auto elapsedMillisec = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+
+   std::cout << std::setw(6) << width << " x " << std::setw(5) << height << "  " << std::setw(9) << layoutName << "  " << std::setw(8) << layersName << "  " << std::fixed << std::setprecision(2) << std::setw(9) << (elapsedMillisec / searchCount) << " ms/search  checksum " << pathLengthChecksum << std::endl;
+}
+
+template<template<typename> typename Storage, typename PathfinderType>
+void runLayout(const char* layoutName, const std::size_t width, const std::size_t height, const Endpoints& endpoints)
+{
+   const auto layers = makeLayers<Storage>(width, height);
+
+   run<PathfinderType>(layoutName, "separate", width, height, endpoints,
+      [&] (const std::size_t x, const std::size_t y) { return isBlockedForVillagers(layers.worldMap.at(x, y)); },
+      [&] (const std::size_t x, const std::size_t y) { return static_cast<std::int32_t>(layers.baseCostMap.at(x, y)) + static_cast<std::int32_t>(layers.congestionCostMap.at(x, y)); }
+   );
+
+   const auto tileRecords = makeTileRecords(layers);
+
+   run<PathfinderType>(layoutName, "packed", width, height, endpoints,
+      [&] (const std::size_t x, const std::size_t y) { return tileRecords.at(x, y).isBlocked(); },
+      [&] (const std::size_t x, const std::size_t y) { return tileRecords.at(x, y).cost(); }
+   );
+}
+
+template<typename T>
+using DefaultRowMajorStorage = RowMajorStorage<T>;
+} // namespace
+
+int main(int argc, char** argv)
+{
+   std::size_t height = 1024;
+   std::vector<std::size_t> widths = {2048, 4096, 8192, 16384};
+
+   if (argc > 1)
+   {
+      height = std::stoul(argv[1]);
+   }
+
+   if (argc > 2)
+   {
+      widths.clear();
+
+      for (int argIndex = 2; argIndex < argc; ++argIndex)
+      {
+         widths.emplace_back(std::stoul(argv[argIndex]));
+      }
+   }
+
+   for (const auto width : widths)
+   {
+      const auto endpoints = makeEndpoints(makeLayers<DefaultRowMajorStorage>(width, height).worldMap);
+
+      runLayout<DefaultRowMajorStorage, Pathfinder      >("row-major", width, height, endpoints);
+      runLayout<MortonStorage         , MortonPathfinder>("morton"   , width, height, endpoints);
+   }
+
+   return 0;
+}
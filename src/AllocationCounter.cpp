@@ -0,0 +1,68 @@
+#include "AllocationCounter.hpp"
+
+#ifdef DESIREPATHSIM_COUNT_ALLOCATIONS
+
+#include <new>
+#include <cstdlib>
+
+namespace
+{
+thread_local std::uint64_t t_allocationCount = 0;
+} // namespace
+
+void* operator new(std::size_t bytes)
+{
+   t_allocationCount += 1;
+
+   if (bytes == 0)
+   {
+      bytes = 1;
+   }
+
+   while (true)
+   {
+      if (void* block = std::malloc(bytes); block != nullptr)
+         return block;
+
+      const auto newHandler = std::get_new_handler();
+
+      if (newHandler == nullptr)
+         throw std::bad_alloc{};
+
+      newHandler();
+   }
+}
+
+void operator delete(void* block) noexcept
+{
+   std::free(block);
+}
+
+void operator delete(void* block, std::size_t /*bytes*/) noexcept
+{
+   std::free(block);
+}
+
+bool AllocationCounter::isEnabled()
+{
+   return true;
+}
+
+std::uint64_t AllocationCounter::threadAllocationCount()
+{
+   return t_allocationCount;
+}
+
+#else
+
+bool AllocationCounter::isEnabled()
+{
+   return false;
+}
+
+std::uint64_t AllocationCounter::threadAllocationCount()
+{
+   return 0;
+}
+
+#endif // DESIREPATHSIM_COUNT_ALLOCATIONS
@@ -0,0 +1,17 @@
+#ifndef ALLOCATIONCOUNTER_HPP
+#define ALLOCATIONCOUNTER_HPP
+
+#include <cstdint>
+
+// Debug aid to check that ticking stops allocating. Built with DESIREPATHSIM_COUNT_ALLOCATIONS (CMake option of the
+// same name), the global operator new counts every call per thread. Memory taken from malloc directly, like by
+// HugePageAllocator, and over-aligned allocations are not counted.
+namespace AllocationCounter
+{
+bool isEnabled();
+
+// Number of operator new calls on the calling thread so far, always 0 if not enabled
+std::uint64_t threadAllocationCount();
+} // namespace AllocationCounter
+
+#endif // ALLOCATIONCOUNTER_HPP
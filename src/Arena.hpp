@@ -0,0 +1,177 @@
+#ifndef ARENA_HPP
+#define ARENA_HPP
+
+#include <vector>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+
+// Bump allocator for temporaries that all die at the same time, like the patterns of one world generation phase.
+// Deallocating single allocations does nothing, reset() frees everything at once. The blocks are kept across resets,
+// so once the arena has grown to what a phase needs, the following phases do not allocate at all.
+class Arena final
+{
+public:
+   explicit Arena(const std::size_t blockBytes = std::size_t{1} << 20);
+
+   Arena(const Arena&) = delete;
+   Arena(Arena&&) noexcept = default;
+
+   ~Arena() = default;
+
+   Arena& operator=(const Arena&) = delete;
+   Arena& operator=(Arena&&) noexcept = default;
+
+   void* allocate(const std::size_t bytes, const std::size_t alignment);
+
+   // Everything allocated so far must not be used anymore
+   void reset();
+
+   std::size_t capacityBytes() const;
+
+private:
+   struct Block final
+   {
+      std::unique_ptr<std::byte[]> memory;
+      std::size_t bytes;
+   };
+
+   std::size_t m_blockBytes;
+
+   std::vector<Block> m_blocks;
+
+   // Allocations are taken from m_blocks[m_blockIndex] at m_blockOffset, the blocks before are full
+   std::size_t m_blockIndex = 0;
+   std::size_t m_blockOffset = 0;
+};
+
+// Standard allocator on top of an Arena, for containers and Maps whose memory should come from the arena
+template<typename T>
+class ArenaAllocator
+{
+public:
+   using value_type = T;
+
+   explicit ArenaAllocator(Arena& arena);
+
+   template<typename U>
+   ArenaAllocator(const ArenaAllocator<U>& other);
+
+   ArenaAllocator(const ArenaAllocator&) = default;
+   ArenaAllocator(ArenaAllocator&&) noexcept = default;
+
+   ~ArenaAllocator() = default;
+
+   ArenaAllocator& operator=(const ArenaAllocator&) = default;
+   ArenaAllocator& operator=(ArenaAllocator&&) noexcept = default;
+
+   T* allocate(const std::size_t count);
+   void deallocate(T* pointer, const std::size_t count);
+
+   template<typename U>
+   bool operator==(const ArenaAllocator<U>& other) const;
+
+   template<typename U>
+   bool operator!=(const ArenaAllocator<U>& other) const;
+
+private:
+   template<typename> friend class ArenaAllocator;
+
+   Arena* m_arena;
+};
+
+inline Arena::Arena(const std::size_t blockBytes):
+   m_blockBytes{blockBytes}
+{
+   // NOP
+}
+
+inline void* Arena::allocate(const std::size_t bytes, const std::size_t alignment)
+{
+   for (; m_blockIndex < m_blocks.size(); ++m_blockIndex, m_blockOffset = 0)
+   {
+      auto& block = m_blocks[m_blockIndex];
+
+      const auto address = reinterpret_cast<std::uintptr_t>(block.memory.get()) + m_blockOffset;
+      const auto padding = (alignment - address % alignment) % alignment;
+
+      if (m_blockOffset + padding + bytes <= block.bytes)
+      {
+         m_blockOffset += padding + bytes;
+
+         return block.memory.get() + (m_blockOffset - bytes);
+      }
+   }
+
+   // None of the remaining blocks fits, add one that does
+   const auto blockBytes = std::max(m_blockBytes, bytes + alignment);
+
+   m_blocks.emplace_back(Block{std::make_unique<std::byte[]>(blockBytes), blockBytes});
+
+   m_blockIndex = m_blocks.size() - 1;
+   m_blockOffset = 0;
+
+   return allocate(bytes, alignment);
+}
+
+inline void Arena::reset()
+{
+   m_blockIndex = 0;
+   m_blockOffset = 0;
+}
+
+inline std::size_t Arena::capacityBytes() const
+{
+   std::size_t bytes = 0;
+
+   for (const auto& block : m_blocks)
+   {
+      bytes += block.bytes;
+   }
+
+   return bytes;
+}
+
+template<typename T>
+ArenaAllocator<T>::ArenaAllocator(Arena& arena):
+   m_arena{&arena}
+{
+   // NOP
+}
+
+template<typename T>
+template<typename U>
+ArenaAllocator<T>::ArenaAllocator(const ArenaAllocator<U>& other):
+   m_arena{other.m_arena}
+{
+   // NOP
+}
+
+template<typename T>
+T* ArenaAllocator<T>::allocate(const std::size_t count)
+{
+   return static_cast<T*>(m_arena->allocate(count * sizeof(T), alignof(T)));
+}
+
+template<typename T>
+void ArenaAllocator<T>::deallocate(T* /*pointer*/, const std::size_t /*count*/)
+{
+   // NOP, freed with the next reset of the arena
+}
+
+template<typename T>
+template<typename U>
+bool ArenaAllocator<T>::operator==(const ArenaAllocator<U>& other) const
+{
+   return (m_arena == other.m_arena);
+}
+
+template<typename T>
+template<typename U>
+bool ArenaAllocator<T>::operator!=(const ArenaAllocator<U>& other) const
+{
+   return (m_arena != other.m_arena);
+}
+
+#endif // ARENA_HPP
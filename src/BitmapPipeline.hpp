@@ -0,0 +1,509 @@
+#ifndef BITMAPPIPELINE_HPP
+#define BITMAPPIPELINE_HPP
+
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <cstdlib>
+#include <utility>
+#include <algorithm>
+
+#include "PackedBitmap.hpp"
+
+// Lazily evaluated expressions over packed bitmaps. Building an expression does no work; evaluate() streams the
+// result row by row into a bitmap, with every stage keeping only the few rows of its input it needs (three for a
+// neighbourhood, one otherwise). A chain like dilate -> erode -> shift -> mask is a single pass without any
+// intermediate bitmap.
+//
+// Expressions know how far a change of an input tile can spread (reach), so evaluate() can also recompute only the
+// part of the result that depends on a changed rectangle.
+//
+// Every expression provides:
+//   width(), height(), wordsPerRow()
+//   reach()                       - how far an input change spreads to each side
+//   prepare(beginWord, endWord)   - start of a pass that asks for words [beginWord, endWord) of increasing rows
+//   row(y)                        - row y, valid in the prepared words until the next call of row()
+namespace BitmapPipeline
+{
+using Word = PackedBitmap::Word;
+
+struct Reach final
+{
+   int left   = 0;
+   int top    = 0;
+   int right  = 0;
+   int bottom = 0;
+};
+
+class Source final
+{
+public:
+   explicit Source(const PackedBitmap& bitmap);
+
+   std::size_t width() const;
+   std::size_t height() const;
+   std::size_t wordsPerRow() const;
+
+   Reach reach() const;
+
+   void prepare(const std::size_t beginWord, const std::size_t endWord);
+
+   const Word* row(const std::size_t y);
+
+private:
+   const PackedBitmap* m_bitmap;
+};
+
+// Calls combine(center, anyNeighbor, allNeighbors) for every word, tiles outside of the bitmap count as 0
+template<typename Input, typename Combine>
+class Neighborhood final
+{
+public:
+   Neighborhood(Input input, const bool includeDiagonals, Combine combine);
+
+   std::size_t width() const;
+   std::size_t height() const;
+   std::size_t wordsPerRow() const;
+
+   Reach reach() const;
+
+   void prepare(const std::size_t beginWord, const std::size_t endWord);
+
+   const Word* row(const std::size_t y);
+
+private:
+   static constexpr std::size_t m_noRow = static_cast<std::size_t>(-1);
+
+   Input m_input;
+   bool m_includeDiagonals;
+   Combine m_combine;
+
+   std::size_t m_beginWord = 0;
+   std::size_t m_endWord = 0;
+   std::size_t m_inputBeginWord = 0;
+   std::size_t m_inputEndWord = 0;
+
+   // Rolling buffer of the last three input rows, row y lives in slot y % 3
+   std::vector<Word> m_inputRows;
+   std::array<std::size_t, 3> m_inputRowIndices;
+
+   std::vector<Word> m_emptyRow;
+   std::vector<Word> m_outRow;
+
+   const Word* inputRow(const std::size_t y, const int dy);
+};
+
+template<typename Input>
+class Shift final
+{
+public:
+   Shift(Input input, const int deltaX, const int deltaY, const std::uint8_t fill);
+
+   std::size_t width() const;
+   std::size_t height() const;
+   std::size_t wordsPerRow() const;
+
+   Reach reach() const;
+
+   void prepare(const std::size_t beginWord, const std::size_t endWord);
+
+   const Word* row(const std::size_t y);
+
+private:
+   Input m_input;
+   int m_deltaX;
+   int m_deltaY;
+   std::uint8_t m_fill;
+
+   std::size_t m_beginWord = 0;
+   std::size_t m_endWord = 0;
+
+   std::vector<Word> m_outRow;
+};
+
+// Input with every tile set in the mask cleared, both have to be of the same size
+template<typename Input, typename MaskInput>
+class Mask final
+{
+public:
+   Mask(Input input, MaskInput mask);
+
+   std::size_t width() const;
+   std::size_t height() const;
+   std::size_t wordsPerRow() const;
+
+   Reach reach() const;
+
+   void prepare(const std::size_t beginWord, const std::size_t endWord);
+
+   const Word* row(const std::size_t y);
+
+private:
+   Input m_input;
+   MaskInput m_mask;
+
+   std::size_t m_beginWord = 0;
+   std::size_t m_endWord = 0;
+
+   std::vector<Word> m_outRow;
+};
+
+inline Source source(const PackedBitmap& bitmap)
+{
+   return Source{bitmap};
+}
+
+template<typename Input>
+auto erode(Input input, const bool includeDiagonals)
+{
+   auto combine = [] (const Word center, const Word /*anyNeighbor*/, const Word allNeighbors) { return center & allNeighbors; };
+
+   return Neighborhood<Input, decltype(combine)>{std::move(input), includeDiagonals, combine};
+}
+
+template<typename Input>
+auto dilate(Input input, const bool includeDiagonals)
+{
+   auto combine = [] (const Word center, const Word anyNeighbor, const Word /*allNeighbors*/) { return center | anyNeighbor; };
+
+   return Neighborhood<Input, decltype(combine)>{std::move(input), includeDiagonals, combine};
+}
+
+template<typename Input>
+auto border(Input input, const bool includeDiagonals)
+{
+   auto combine = [] (const Word center, const Word anyNeighbor, const Word /*allNeighbors*/) { return ~center & anyNeighbor; };
+
+   return Neighborhood<Input, decltype(combine)>{std::move(input), includeDiagonals, combine};
+}
+
+template<typename Input>
+Shift<Input> shift(Input input, const int deltaX, const int deltaY, const std::uint8_t fill)
+{
+   return Shift<Input>{std::move(input), deltaX, deltaY, fill};
+}
+
+template<typename Input, typename MaskInput>
+Mask<Input, MaskInput> mask(Input input, MaskInput mask)
+{
+   return Mask<Input, MaskInput>{std::move(input), std::move(mask)};
+}
+
+// Writes every tile of the result that can depend on an input tile in [beginX, endX) x [beginY, endY) to outBitmap,
+// which must not be one of the sources of the expression
+template<typename Expression>
+void evaluate(Expression& expression, PackedBitmap& outBitmap, const std::size_t beginX, const std::size_t beginY, const std::size_t endX, const std::size_t endY)
+{
+   const auto reach = expression.reach();
+
+   const auto clampX = [&] (const std::ptrdiff_t x) { return static_cast<std::size_t>(std::clamp<std::ptrdiff_t>(x, 0, static_cast<std::ptrdiff_t>(outBitmap.width ()))); };
+   const auto clampY = [&] (const std::ptrdiff_t y) { return static_cast<std::size_t>(std::clamp<std::ptrdiff_t>(y, 0, static_cast<std::ptrdiff_t>(outBitmap.height()))); };
+
+   const auto outBeginX = clampX(static_cast<std::ptrdiff_t>(beginX) - reach.left  );
+   const auto outBeginY = clampY(static_cast<std::ptrdiff_t>(beginY) - reach.top   );
+   const auto outEndX   = clampX(static_cast<std::ptrdiff_t>(endX  ) + reach.right );
+   const auto outEndY   = clampY(static_cast<std::ptrdiff_t>(endY  ) + reach.bottom);
+
+   if (outBeginX >= outEndX || outBeginY >= outEndY)
+      return;
+
+   // Whole words are recomputed, the tiles around the rectangle in them come out the same as before
+   const auto beginWord = outBeginX / PackedBitmap::m_wordBits;
+   const auto endWord = (outEndX - 1) / PackedBitmap::m_wordBits + 1;
+
+   expression.prepare(beginWord, endWord);
+
+   for (auto y = outBeginY; y < outEndY; ++y)
+   {
+      const auto* row = expression.row(y);
+
+      std::copy(row + beginWord, row + endWord, outBitmap.row(y) + beginWord);
+   }
+}
+
+template<typename Expression>
+void evaluate(Expression& expression, PackedBitmap& outBitmap)
+{
+   evaluate(expression, outBitmap, 0, 0, outBitmap.width(), outBitmap.height());
+}
+
+inline Source::Source(const PackedBitmap& bitmap):
+   m_bitmap{&bitmap}
+{
+   // NOP
+}
+
+inline std::size_t Source::width() const
+{
+   return m_bitmap->width();
+}
+
+inline std::size_t Source::height() const
+{
+   return m_bitmap->height();
+}
+
+inline std::size_t Source::wordsPerRow() const
+{
+   return m_bitmap->wordsPerRow();
+}
+
+inline Reach Source::reach() const
+{
+   return Reach{};
+}
+
+inline void Source::prepare(const std::size_t /*beginWord*/, const std::size_t /*endWord*/)
+{
+   // NOP
+}
+
+inline const Word* Source::row(const std::size_t y)
+{
+   return m_bitmap->row(y);
+}
+
+template<typename Input, typename Combine>
+Neighborhood<Input, Combine>::Neighborhood(Input input, const bool includeDiagonals, Combine combine):
+   m_input{std::move(input)},
+   m_includeDiagonals{includeDiagonals},
+   m_combine{std::move(combine)},
+   m_inputRows(3 * m_input.wordsPerRow()),
+   m_inputRowIndices{m_noRow, m_noRow, m_noRow},
+   m_emptyRow(m_input.wordsPerRow(), 0),
+   m_outRow(m_input.wordsPerRow())
+{
+   // NOP
+}
+
+template<typename Input, typename Combine>
+std::size_t Neighborhood<Input, Combine>::width() const
+{
+   return m_input.width();
+}
+
+template<typename Input, typename Combine>
+std::size_t Neighborhood<Input, Combine>::height() const
+{
+   return m_input.height();
+}
+
+template<typename Input, typename Combine>
+std::size_t Neighborhood<Input, Combine>::wordsPerRow() const
+{
+   return m_input.wordsPerRow();
+}
+
+template<typename Input, typename Combine>
+Reach Neighborhood<Input, Combine>::reach() const
+{
+   const auto inputReach = m_input.reach();
+
+   return Reach{inputReach.left + 1, inputReach.top + 1, inputReach.right + 1, inputReach.bottom + 1};
+}
+
+template<typename Input, typename Combine>
+void Neighborhood<Input, Combine>::prepare(const std::size_t beginWord, const std::size_t endWord)
+{
+   m_beginWord = beginWord;
+   m_endWord = endWord;
+
+   // West and east neighbours carry over from the adjacent words
+   m_inputBeginWord = (beginWord > 0) ? (beginWord - 1) : 0;
+   m_inputEndWord = std::min(endWord + 1, wordsPerRow());
+
+   m_inputRowIndices.fill(m_noRow);
+
+   m_input.prepare(m_inputBeginWord, m_inputEndWord);
+}
+
+template<typename Input, typename Combine>
+const Word* Neighborhood<Input, Combine>::row(const std::size_t y)
+{
+   const auto* rowAbove = inputRow(y, -1);
+   const auto* rowCenter = inputRow(y, 0);
+   const auto* rowBelow = inputRow(y, 1);
+
+   for (auto wordIndex = m_beginWord; wordIndex < m_endWord; ++wordIndex)
+   {
+      m_outRow[wordIndex] = PackedRow::combineNeighborhood(rowAbove, rowCenter, rowBelow, wordsPerRow(), wordIndex, m_includeDiagonals, m_combine);
+   }
+
+   if (m_endWord == wordsPerRow())
+   {
+      m_outRow[m_endWord - 1] &= PackedBitmap::lastWordMask(width());
+   }
+
+   return m_outRow.data();
+}
+
+template<typename Input, typename Combine>
+const Word* Neighborhood<Input, Combine>::inputRow(const std::size_t y, const int dy)
+{
+   if ((dy < 0 && y == 0) || (dy > 0 && y + 1 >= height()))
+      return m_emptyRow.data();
+
+   const auto inputY = y + dy;
+   const auto slot = inputY % 3;
+
+   auto* cachedRow = m_inputRows.data() + slot * wordsPerRow();
+
+   if (m_inputRowIndices[slot] != inputY)
+   {
+      const auto* row = m_input.row(inputY);
+
+      std::copy(row + m_inputBeginWord, row + m_inputEndWord, cachedRow + m_inputBeginWord);
+
+      m_inputRowIndices[slot] = inputY;
+   }
+
+   return cachedRow;
+}
+
+template<typename Input>
+Shift<Input>::Shift(Input input, const int deltaX, const int deltaY, const std::uint8_t fill):
+   m_input{std::move(input)},
+   m_deltaX{deltaX},
+   m_deltaY{deltaY},
+   m_fill{fill},
+   m_outRow(m_input.wordsPerRow())
+{
+   // NOP
+}
+
+template<typename Input>
+std::size_t Shift<Input>::width() const
+{
+   return m_input.width();
+}
+
+template<typename Input>
+std::size_t Shift<Input>::height() const
+{
+   return m_input.height();
+}
+
+template<typename Input>
+std::size_t Shift<Input>::wordsPerRow() const
+{
+   return m_input.wordsPerRow();
+}
+
+template<typename Input>
+Reach Shift<Input>::reach() const
+{
+   const auto inputReach = m_input.reach();
+
+   return Reach{inputReach.left - m_deltaX, inputReach.top - m_deltaY, inputReach.right + m_deltaX, inputReach.bottom + m_deltaY};
+}
+
+template<typename Input>
+void Shift<Input>::prepare(const std::size_t beginWord, const std::size_t endWord)
+{
+   m_beginWord = beginWord;
+   m_endWord = endWord;
+
+   // See PackedRow::shiftedWord
+   const auto inputMarginWords = (static_cast<std::size_t>(std::abs(m_deltaX)) + PackedBitmap::m_wordBits - 1) / PackedBitmap::m_wordBits + 1;
+
+   m_input.prepare((beginWord > inputMarginWords) ? (beginWord - inputMarginWords) : 0, std::min(endWord + inputMarginWords, wordsPerRow()));
+}
+
+template<typename Input>
+const Word* Shift<Input>::row(const std::size_t y)
+{
+   const auto inputY = static_cast<std::ptrdiff_t>(y) - m_deltaY;
+
+   if (inputY < 0 || inputY >= static_cast<std::ptrdiff_t>(height()))
+   {
+      std::fill(m_outRow.begin(), m_outRow.end(), (m_fill != 0) ? ~Word{0} : Word{0});
+   }
+   else
+   {
+      const auto* inputRow = m_input.row(static_cast<std::size_t>(inputY));
+
+      for (auto wordIndex = m_beginWord; wordIndex < m_endWord; ++wordIndex)
+      {
+         m_outRow[wordIndex] = PackedRow::shiftedWord(inputRow, wordsPerRow(), wordIndex, m_deltaX);
+      }
+
+      if (m_fill != 0 && m_deltaX > 0)
+      {
+         PackedRow::setBits(m_outRow.data(), 0, std::min(width(), static_cast<std::size_t>(m_deltaX)));
+      }
+      else if (m_fill != 0 && m_deltaX < 0)
+      {
+         PackedRow::setBits(m_outRow.data(), static_cast<std::size_t>(std::max<std::ptrdiff_t>(0, static_cast<std::ptrdiff_t>(width()) + m_deltaX)), width());
+      }
+   }
+
+   if (m_endWord == wordsPerRow())
+   {
+      m_outRow[m_endWord - 1] &= PackedBitmap::lastWordMask(width());
+   }
+
+   return m_outRow.data();
+}
+
+template<typename Input, typename MaskInput>
+Mask<Input, MaskInput>::Mask(Input input, MaskInput mask):
+   m_input{std::move(input)},
+   m_mask{std::move(mask)},
+   m_outRow(m_input.wordsPerRow())
+{
+   // NOP
+}
+
+template<typename Input, typename MaskInput>
+std::size_t Mask<Input, MaskInput>::width() const
+{
+   return m_input.width();
+}
+
+template<typename Input, typename MaskInput>
+std::size_t Mask<Input, MaskInput>::height() const
+{
+   return m_input.height();
+}
+
+template<typename Input, typename MaskInput>
+std::size_t Mask<Input, MaskInput>::wordsPerRow() const
+{
+   return m_input.wordsPerRow();
+}
+
+template<typename Input, typename MaskInput>
+Reach Mask<Input, MaskInput>::reach() const
+{
+   const auto inputReach = m_input.reach();
+   const auto maskReach = m_mask.reach();
+
+   return Reach{std::max(inputReach.left, maskReach.left), std::max(inputReach.top, maskReach.top), std::max(inputReach.right, maskReach.right), std::max(inputReach.bottom, maskReach.bottom)};
+}
+
+template<typename Input, typename MaskInput>
+void Mask<Input, MaskInput>::prepare(const std::size_t beginWord, const std::size_t endWord)
+{
+   m_beginWord = beginWord;
+   m_endWord = endWord;
+
+   m_input.prepare(beginWord, endWord);
+   m_mask.prepare(beginWord, endWord);
+}
+
+template<typename Input, typename MaskInput>
+const Word* Mask<Input, MaskInput>::row(const std::size_t y)
+{
+   const auto* inputRow = m_input.row(y);
+   const auto* maskRow = m_mask.row(y);
+
+   for (auto wordIndex = m_beginWord; wordIndex < m_endWord; ++wordIndex)
+   {
+      m_outRow[wordIndex] = inputRow[wordIndex] & ~maskRow[wordIndex];
+   }
+
+   return m_outRow.data();
+}
+} // namespace BitmapPipeline
+
+#endif // BITMAPPIPELINE_HPP
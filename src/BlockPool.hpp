@@ -0,0 +1,230 @@
+#ifndef BLOCKPOOL_HPP
+#define BLOCKPOOL_HPP
+
+#include <new>
+#include <array>
+#include <memory>
+#include <mutex>
+#include <cstddef>
+#include <type_traits>
+
+// Thread-safe pool of memory blocks. Freed blocks are not returned to the heap, but kept in a free list for the next
+// allocation of the same size class, so objects and containers that are made and destroyed over and over stop
+// allocating once the pool has seen the most of them alive at the same time. Sizes are rounded up to one of a fixed
+// set of classes, four per power of two, so no block wastes more than a quarter of its size and growing arrays or
+// deque blocks cannot add free lists without bound. Blocks larger than m_maxPooledBytes go straight to the heap.
+// Blocks may be freed on a different thread than they were allocated on.
+class BlockPool final
+{
+public:
+   BlockPool() = default;
+
+   BlockPool(const BlockPool&) = delete;
+   BlockPool(BlockPool&&) = delete;
+
+   ~BlockPool();
+
+   BlockPool& operator=(const BlockPool&) = delete;
+   BlockPool& operator=(BlockPool&&) = delete;
+
+   void* allocate(const std::size_t bytes);
+   void deallocate(void* block, const std::size_t bytes);
+
+   static constexpr std::size_t m_minBlockBytesLog2 = 4;
+   static constexpr std::size_t m_maxPooledBytesLog2 = 20;
+
+   static constexpr std::size_t m_minBlockBytes = std::size_t{1} << m_minBlockBytesLog2;
+   static constexpr std::size_t m_maxPooledBytes = std::size_t{1} << m_maxPooledBytesLog2;
+
+private:
+   // Free blocks are linked through their first bytes
+   struct FreeBlock final
+   {
+      FreeBlock* next;
+   };
+
+   static_assert(sizeof(FreeBlock) <= m_minBlockBytes, "Every block must be able to hold the free list link");
+
+   static constexpr std::size_t m_classesPerPowerOfTwo = 4;
+   static constexpr std::size_t m_classCount = 1 + (m_maxPooledBytesLog2 - m_minBlockBytesLog2) * m_classesPerPowerOfTwo;
+
+   std::mutex m_mutex;
+
+   std::array<FreeBlock*, m_classCount> m_freeLists{};
+
+   static std::size_t classIndex(const std::size_t bytes);
+   static std::size_t classBytes(const std::size_t classIndex);
+   static std::size_t highestBit(const std::size_t value);
+};
+
+// Standard allocator on top of a shared BlockPool, the pool lives until the last allocator using it is gone
+template<typename T>
+class PoolAllocator
+{
+public:
+   using value_type = T;
+
+   using propagate_on_container_copy_assignment = std::true_type;
+   using propagate_on_container_move_assignment = std::true_type;
+   using propagate_on_container_swap = std::true_type;
+
+   explicit PoolAllocator(std::shared_ptr<BlockPool> pool);
+
+   template<typename U>
+   PoolAllocator(const PoolAllocator<U>& other);
+
+   // Allocators must stay usable when moved from, so moving copies
+   PoolAllocator(const PoolAllocator&) = default;
+
+   ~PoolAllocator() = default;
+
+   PoolAllocator& operator=(const PoolAllocator&) = default;
+
+   T* allocate(const std::size_t count);
+   void deallocate(T* pointer, const std::size_t count);
+
+   template<typename U>
+   bool operator==(const PoolAllocator<U>& other) const;
+
+   template<typename U>
+   bool operator!=(const PoolAllocator<U>& other) const;
+
+private:
+   template<typename> friend class PoolAllocator;
+
+   static_assert(alignof(T) <= __STDCPP_DEFAULT_NEW_ALIGNMENT__, "Pool blocks only have the default alignment");
+
+   std::shared_ptr<BlockPool> m_pool;
+};
+
+inline BlockPool::~BlockPool()
+{
+   for (auto* freeBlock : m_freeLists)
+   {
+      while (freeBlock != nullptr)
+      {
+         auto* block = freeBlock;
+
+         freeBlock = block->next;
+
+         ::operator delete(block);
+      }
+   }
+}
+
+inline void* BlockPool::allocate(const std::size_t bytes)
+{
+   if (bytes > m_maxPooledBytes)
+      return ::operator new(bytes);
+
+   const auto index = classIndex(bytes);
+
+   {
+      std::lock_guard lock{m_mutex};
+
+      if (m_freeLists[index] != nullptr)
+      {
+         auto* block = m_freeLists[index];
+
+         m_freeLists[index] = block->next;
+
+         return block;
+      }
+   }
+
+   return ::operator new(classBytes(index));
+}
+
+inline void BlockPool::deallocate(void* block, const std::size_t bytes)
+{
+   if (bytes > m_maxPooledBytes)
+   {
+      ::operator delete(block);
+
+      return;
+   }
+
+   const auto index = classIndex(bytes);
+
+   std::lock_guard lock{m_mutex};
+
+   m_freeLists[index] = ::new (block) FreeBlock{m_freeLists[index]};
+}
+
+inline std::size_t BlockPool::classIndex(const std::size_t bytes)
+{
+   if (bytes <= m_minBlockBytes)
+      return 0;
+
+   // Above m_minBlockBytes, the range (2^n, 2^(n+1)] is split into four classes of equal width
+   const auto lastByte = bytes - 1;
+   const auto powerOfTwo = highestBit(lastByte);
+
+   return 1 + (powerOfTwo - m_minBlockBytesLog2) * m_classesPerPowerOfTwo + ((lastByte >> (powerOfTwo - 2)) & (m_classesPerPowerOfTwo - 1));
+}
+
+inline std::size_t BlockPool::classBytes(const std::size_t classIndex)
+{
+   if (classIndex == 0)
+      return m_minBlockBytes;
+
+   const auto powerOfTwo = m_minBlockBytesLog2 + (classIndex - 1) / m_classesPerPowerOfTwo;
+   const auto step = (classIndex - 1) % m_classesPerPowerOfTwo;
+
+   return (std::size_t{1} << powerOfTwo) + ((step + 1) << (powerOfTwo - 2));
+}
+
+inline std::size_t BlockPool::highestBit(const std::size_t value)
+{
+   std::size_t bit = 0;
+
+   while ((value >> (bit + 1)) != 0)
+   {
+      ++bit;
+   }
+
+   return bit;
+}
+
+template<typename T>
+PoolAllocator<T>::PoolAllocator(std::shared_ptr<BlockPool> pool):
+   m_pool{std::move(pool)}
+{
+   // NOP
+}
+
+template<typename T>
+template<typename U>
+PoolAllocator<T>::PoolAllocator(const PoolAllocator<U>& other):
+   m_pool{other.m_pool}
+{
+   // NOP
+}
+
+template<typename T>
+T* PoolAllocator<T>::allocate(const std::size_t count)
+{
+   return static_cast<T*>(m_pool->allocate(count * sizeof(T)));
+}
+
+template<typename T>
+void PoolAllocator<T>::deallocate(T* pointer, const std::size_t count)
+{
+   m_pool->deallocate(pointer, count * sizeof(T));
+}
+
+template<typename T>
+template<typename U>
+bool PoolAllocator<T>::operator==(const PoolAllocator<U>& other) const
+{
+   return (m_pool == other.m_pool);
+}
+
+template<typename T>
+template<typename U>
+bool PoolAllocator<T>::operator!=(const PoolAllocator<U>& other) const
+{
+   return (m_pool != other.m_pool);
+}
+
+#endif // BLOCKPOOL_HPP
@@ -0,0 +1,396 @@
+#ifndef CHUNKEDSNAPSHOT_HPP
+#define CHUNKEDSNAPSHOT_HPP
+
+#include <vector>
+#include <array>
+#include <memory>
+#include <optional>
+#include <cstdint>
+#include <algorithm>
+#include <cassert>
+
+#include "Map.hpp"
+#include "BlockPool.hpp"
+
+// Remembers which fixed-size chunks of a map have been written to since the last publish
+class DirtyChunkMask final
+{
+public:
+   static constexpr std::size_t m_chunkEdgeTiles = 64;
+
+public:
+   DirtyChunkMask(const std::size_t mapWidth, const std::size_t mapHeight);
+
+   DirtyChunkMask(const DirtyChunkMask&) = default;
+   DirtyChunkMask(DirtyChunkMask&&) noexcept = default;
+
+   ~DirtyChunkMask() = default;
+
+   DirtyChunkMask& operator=(const DirtyChunkMask&) = default;
+   DirtyChunkMask& operator=(DirtyChunkMask&&) noexcept = default;
+
+   void add(const std::size_t x, const std::size_t y);
+   void add(const DirtyChunkMask& other);
+   void addAll();
+
+   void reset();
+
+   bool empty() const;
+
+   bool test(const std::size_t chunkX, const std::size_t chunkY) const;
+
+   std::size_t widthChunks() const;
+   std::size_t heightChunks() const;
+
+private:
+   std::size_t m_widthChunks;
+   std::size_t m_heightChunks;
+
+   std::vector<std::uint8_t> m_dirty;
+
+   std::size_t m_dirtyCount = 0;
+};
+
+inline DirtyChunkMask::DirtyChunkMask(const std::size_t mapWidth, const std::size_t mapHeight):
+   m_widthChunks {(mapWidth  + m_chunkEdgeTiles - 1) / m_chunkEdgeTiles},
+   m_heightChunks{(mapHeight + m_chunkEdgeTiles - 1) / m_chunkEdgeTiles},
+   m_dirty(m_widthChunks * m_heightChunks, 0)
+{
+   // NOP
+}
+
+inline void DirtyChunkMask::add(const std::size_t x, const std::size_t y)
+{
+   auto& dirty = m_dirty[(y / m_chunkEdgeTiles) * m_widthChunks + (x / m_chunkEdgeTiles)];
+
+   if (dirty == 0)
+   {
+      dirty = 1;
+      m_dirtyCount += 1;
+   }
+}
+
+inline void DirtyChunkMask::add(const DirtyChunkMask& other)
+{
+   for (std::size_t chunkIndex = 0; chunkIndex < m_dirty.size(); ++chunkIndex)
+   {
+      if (other.m_dirty[chunkIndex] != 0 && m_dirty[chunkIndex] == 0)
+      {
+         m_dirty[chunkIndex] = 1;
+         m_dirtyCount += 1;
+      }
+   }
+}
+
+inline void DirtyChunkMask::addAll()
+{
+   std::fill(std::begin(m_dirty), std::end(m_dirty), 1);
+
+   m_dirtyCount = m_dirty.size();
+}
+
+inline void DirtyChunkMask::reset()
+{
+   std::fill(std::begin(m_dirty), std::end(m_dirty), 0);
+
+   m_dirtyCount = 0;
+}
+
+inline bool DirtyChunkMask::empty() const
+{
+   return (m_dirtyCount == 0);
+}
+
+inline bool DirtyChunkMask::test(const std::size_t chunkX, const std::size_t chunkY) const
+{
+   return (m_dirty[chunkY * m_widthChunks + chunkX] != 0);
+}
+
+inline std::size_t DirtyChunkMask::widthChunks() const
+{
+   return m_widthChunks;
+}
+
+inline std::size_t DirtyChunkMask::heightChunks() const
+{
+   return m_heightChunks;
+}
+
+// Copy-on-write snapshots of a Map, split into chunks of DirtyChunkMask::m_chunkEdgeTiles squared tiles.
+// Publishing copies only the dirty chunks into new immutable chunk versions and shares all others with the
+// previous version. A View keeps its version alive for as long as it is held, old chunk versions are released
+// once the last View referencing them is gone.
+// Publishing is meant to be done by a single writer thread, Views can be used by any number of reader threads.
+// Tables and chunks come from a pool, so publishing stops allocating once as many versions as are ever alive at the
+// same time have been published, or reserved up front.
+template<typename T>
+class ChunkedSnapshot final
+{
+private:
+   static constexpr std::size_t m_chunkEdgeTiles = DirtyChunkMask::m_chunkEdgeTiles;
+
+   using Chunk = std::array<T, m_chunkEdgeTiles * m_chunkEdgeTiles>;
+
+   using ChunkPointer = std::shared_ptr<const Chunk>;
+
+   struct Table final
+   {
+      explicit Table(const PoolAllocator<ChunkPointer>& allocator);
+
+      std::uint64_t version = 0;
+
+      std::size_t width = 0;
+      std::size_t height = 0;
+
+      std::size_t widthChunks = 0;
+
+      std::vector<ChunkPointer, PoolAllocator<ChunkPointer>> chunks;
+   };
+
+public:
+   class View final
+   {
+   public:
+      View() = default;
+
+      View(const View&) = default;
+      View(View&&) noexcept = default;
+
+      ~View() = default;
+
+      View& operator=(const View&) = default;
+      View& operator=(View&&) noexcept = default;
+
+      const T& at(const std::size_t x, const std::size_t y) const;
+
+      std::size_t width() const;
+      std::size_t height() const;
+
+      std::uint64_t version() const;
+
+      std::optional<std::pair<std::size_t /*foundAtX*/, std::size_t /*foundAtY*/>>
+      find(const T value, const std::size_t startX = 0, const std::size_t startY = 0, const bool wrap = false) const;
+
+   private:
+      friend class ChunkedSnapshot;
+
+      explicit View(std::shared_ptr<const Table> table);
+
+      std::shared_ptr<const Table> m_table;
+   };
+
+public:
+   ChunkedSnapshot() = default;
+
+   ChunkedSnapshot(const ChunkedSnapshot&) = default;
+   ChunkedSnapshot(ChunkedSnapshot&&) noexcept = default;
+
+   ~ChunkedSnapshot() = default;
+
+   ChunkedSnapshot& operator=(const ChunkedSnapshot&) = default;
+   ChunkedSnapshot& operator=(ChunkedSnapshot&&) noexcept = default;
+
+   // Creates the next version from source, only chunks marked in dirtyChunks are copied
+   template<typename Storage>
+   View publish(const Map<T, Storage>& source, const DirtyChunkMask& dirtyChunks);
+
+   // Same as above, but the tiles of dirty chunks are made by calling makeTile(x, y), for layers that are combined
+   // from several maps
+   template<typename MakeTile>
+   View publish(const std::size_t width, const std::size_t height, const DirtyChunkMask& dirtyChunks, MakeTile&& makeTile);
+
+   View current() const;
+
+   // Fills the pool with the tables of versionCount versions and with chunkCount chunks
+   void reserve(const std::size_t versionCount, const std::size_t chunkCount);
+
+private:
+   std::shared_ptr<const Table> m_table;
+
+   std::shared_ptr<BlockPool> m_pool = std::make_shared<BlockPool>();
+
+   template<typename MakeTile>
+   ChunkPointer makeChunk(const std::size_t width, const std::size_t height, const std::size_t chunkX, const std::size_t chunkY, MakeTile& makeTile);
+};
+
+template<typename T>
+ChunkedSnapshot<T>::Table::Table(const PoolAllocator<ChunkPointer>& allocator):
+   chunks(allocator)
+{
+   // NOP
+}
+
+template<typename T>
+ChunkedSnapshot<T>::View::View(std::shared_ptr<const Table> table):
+   m_table{std::move(table)}
+{
+   // NOP
+}
+
+template<typename T>
+const T& ChunkedSnapshot<T>::View::at(const std::size_t x, const std::size_t y) const
+{
+   const auto& chunk = *m_table->chunks[(y / m_chunkEdgeTiles) * m_table->widthChunks + (x / m_chunkEdgeTiles)];
+
+   return chunk[(y % m_chunkEdgeTiles) * m_chunkEdgeTiles + (x % m_chunkEdgeTiles)];
+}
+
+template<typename T>
+std::size_t ChunkedSnapshot<T>::View::width() const
+{
+   return m_table->width;
+}
+
+template<typename T>
+std::size_t ChunkedSnapshot<T>::View::height() const
+{
+   return m_table->height;
+}
+
+template<typename T>
+std::uint64_t ChunkedSnapshot<T>::View::version() const
+{
+   return m_table->version;
+}
+
+template<typename T>
+std::optional<std::pair<std::size_t /*foundAtX*/, std::size_t /*foundAtY*/>>
+ChunkedSnapshot<T>::View::find(const T value, const std::size_t startX, const std::size_t startY, const bool wrap) const
+{
+   // Same search order as Map::find
+
+   if (startY >= height() || startX >= width())
+      return std::nullopt;
+
+   for (std::size_t x = startX; x < width(); ++x)
+   {
+      if (at(x, startY) == value)
+         return std::make_pair(x, startY);
+   }
+
+   for (std::size_t y = startY + 1; y < height(); ++y)
+   {
+      for (std::size_t x = 0; x < width(); ++x)
+      {
+         if (at(x, y) == value)
+            return std::make_pair(x, y);
+      }
+   }
+
+   if (wrap)
+   {
+      for (std::size_t y = 0; y <= startY; ++y)
+      {
+         for (std::size_t x = 0; x < (y == startY ? startX : width()); ++x)
+         {
+            if (at(x, y) == value)
+               return std::make_pair(x, y);
+         }
+      }
+   }
+
+   return std::nullopt;
+}
+
+template<typename T>
+template<typename Storage>
+typename ChunkedSnapshot<T>::View ChunkedSnapshot<T>::publish(const Map<T, Storage>& source, const DirtyChunkMask& dirtyChunks)
+{
+   return publish(source.width(), source.height(), dirtyChunks, [&] (const std::size_t x, const std::size_t y)
+   {
+      return source.at(x, y);
+   });
+}
+
+template<typename T>
+template<typename MakeTile>
+typename ChunkedSnapshot<T>::View ChunkedSnapshot<T>::publish(const std::size_t width, const std::size_t height, const DirtyChunkMask& dirtyChunks, MakeTile&& makeTile)
+{
+   auto table = std::allocate_shared<Table>(PoolAllocator<Table>{m_pool}, PoolAllocator<ChunkPointer>{m_pool});
+
+   table->version = (m_table != nullptr) ? (m_table->version + 1) : 0;
+
+   table->width  = width;
+   table->height = height;
+
+   table->widthChunks = dirtyChunks.widthChunks();
+
+   table->chunks.reserve(dirtyChunks.widthChunks() * dirtyChunks.heightChunks());
+
+   for (std::size_t chunkY = 0; chunkY < dirtyChunks.heightChunks(); ++chunkY)
+   {
+      for (std::size_t chunkX = 0; chunkX < dirtyChunks.widthChunks(); ++chunkX)
+      {
+         if (m_table == nullptr || dirtyChunks.test(chunkX, chunkY))
+         {
+            table->chunks.emplace_back(makeChunk(width, height, chunkX, chunkY, makeTile));
+         }
+         else
+         {
+            table->chunks.emplace_back(m_table->chunks[chunkY * m_table->widthChunks + chunkX]);
+         }
+      }
+   }
+
+   m_table = std::move(table);
+
+   return View{m_table};
+}
+
+template<typename T>
+typename ChunkedSnapshot<T>::View ChunkedSnapshot<T>::current() const
+{
+   return View{m_table};
+}
+
+template<typename T>
+void ChunkedSnapshot<T>::reserve(const std::size_t versionCount, const std::size_t chunkCount)
+{
+   assert(m_table != nullptr); // Tables are sized for the chunks of the published map
+
+   // Allocated the same way publishing does and released again, which leaves every block in the pool's free lists
+   std::vector<std::shared_ptr<Table>> tables;
+   std::vector<ChunkPointer> chunks;
+
+   tables.reserve(versionCount);
+   chunks.reserve(chunkCount);
+
+   for (std::size_t versionIndex = 0; versionIndex < versionCount; ++versionIndex)
+   {
+      auto table = std::allocate_shared<Table>(PoolAllocator<Table>{m_pool}, PoolAllocator<ChunkPointer>{m_pool});
+
+      table->chunks.reserve(m_table->chunks.size());
+
+      tables.emplace_back(std::move(table));
+   }
+
+   for (std::size_t chunkIndex = 0; chunkIndex < chunkCount; ++chunkIndex)
+   {
+      chunks.emplace_back(std::allocate_shared<Chunk>(PoolAllocator<Chunk>{m_pool}));
+   }
+}
+
+template<typename T>
+template<typename MakeTile>
+typename ChunkedSnapshot<T>::ChunkPointer ChunkedSnapshot<T>::makeChunk(const std::size_t width, const std::size_t height, const std::size_t chunkX, const std::size_t chunkY, MakeTile& makeTile)
+{
+   auto chunk = std::allocate_shared<Chunk>(PoolAllocator<Chunk>{m_pool});
+
+   const auto left = chunkX * m_chunkEdgeTiles;
+   const auto top  = chunkY * m_chunkEdgeTiles;
+
+   const auto right  = std::min(left + m_chunkEdgeTiles, width );
+   const auto bottom = std::min(top  + m_chunkEdgeTiles, height);
+
+   for (std::size_t y = top; y < bottom; ++y)
+   {
+      for (std::size_t x = left; x < right; ++x)
+      {
+         (*chunk)[(y - top) * m_chunkEdgeTiles + (x - left)] = makeTile(x, y);
+      }
+   }
+
+   return chunk;
+}
+
+#endif // CHUNKEDSNAPSHOT_HPP
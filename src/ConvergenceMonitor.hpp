@@ -0,0 +1,110 @@
+#ifndef CONVERGENCEMONITOR_HPP
+#define CONVERGENCEMONITOR_HPP
+
+#include <vector>
+#include <cstdint>
+#include <cstdlib>
+#include <algorithm>
+
+// Tells when the desire path network has stopped changing. Fed one sample per simulated second with two running
+// totals the simulation maintains anyway: the number of tiles paved so far and the base cost reduction of all desire
+// paths (see DesirePathsMap::costStepSum). Only the last windowSeconds + 1 samples are kept, so the change over the
+// window is the difference of two samples instead of a rescan of the map.
+//
+// Change is measured as paved tiles plus the net change of the cost reduction, relative to the size of the network
+// (paved tiles plus cost reduction). Tiles that go back and forth across a cost step as they are walked on and decay
+// do not add up, which is what a settled network looks like.
+class ConvergenceMonitor final
+{
+public:
+   // A windowSeconds of 0 disables the monitor
+   ConvergenceMonitor(const std::size_t windowSeconds, const int thresholdPerMille);
+
+   ConvergenceMonitor(const ConvergenceMonitor&) = default;
+   ConvergenceMonitor(ConvergenceMonitor&&) noexcept = default;
+
+   ~ConvergenceMonitor() = default;
+
+   ConvergenceMonitor& operator=(const ConvergenceMonitor&) = default;
+   ConvergenceMonitor& operator=(ConvergenceMonitor&&) noexcept = default;
+
+   bool enabled() const;
+
+   void addSample(const std::uint64_t pavedTileCount, const std::int64_t costStepSum);
+
+   // Change over the last window in per mille of the network size, only valid once a whole window has been sampled
+   bool windowFull() const;
+   int changePerMille() const;
+
+   bool converged() const;
+
+private:
+   struct Sample final
+   {
+      std::uint64_t pavedTileCount;
+      std::int64_t costStepSum;
+   };
+
+   int m_thresholdPerMille;
+
+   // Ring buffer, m_nextSample is the oldest sample once the buffer is full
+   std::vector<Sample> m_samples;
+   std::size_t m_nextSample = 0;
+   std::size_t m_sampleCount = 0;
+
+   const Sample& newestSample() const;
+};
+
+inline ConvergenceMonitor::ConvergenceMonitor(const std::size_t windowSeconds, const int thresholdPerMille):
+   m_thresholdPerMille{thresholdPerMille},
+   m_samples((windowSeconds > 0) ? (windowSeconds + 1) : 0)
+{
+   // NOP
+}
+
+inline bool ConvergenceMonitor::enabled() const
+{
+   return (m_samples.empty() == false);
+}
+
+inline void ConvergenceMonitor::addSample(const std::uint64_t pavedTileCount, const std::int64_t costStepSum)
+{
+   if (enabled() == false)
+      return;
+
+   m_samples[m_nextSample] = Sample{pavedTileCount, costStepSum};
+
+   m_nextSample = (m_nextSample + 1) % m_samples.size();
+   m_sampleCount = std::min(m_sampleCount + 1, m_samples.size());
+}
+
+inline bool ConvergenceMonitor::windowFull() const
+{
+   return (enabled() && m_sampleCount == m_samples.size());
+}
+
+inline int ConvergenceMonitor::changePerMille() const
+{
+   const auto& oldest = m_samples[m_nextSample];
+   const auto& newest = newestSample();
+
+   const auto change = static_cast<std::int64_t>(newest.pavedTileCount - oldest.pavedTileCount) + std::abs(newest.costStepSum - oldest.costStepSum);
+   const auto size = static_cast<std::int64_t>(newest.pavedTileCount) + newest.costStepSum;
+
+   if (size <= 0)
+      return 1000; // No network yet, nothing to converge to
+
+   return static_cast<int>(std::min<std::int64_t>(change * 1000 / size, 1000));
+}
+
+inline bool ConvergenceMonitor::converged() const
+{
+   return (windowFull() && changePerMille() < m_thresholdPerMille);
+}
+
+inline const ConvergenceMonitor::Sample& ConvergenceMonitor::newestSample() const
+{
+   return m_samples[(m_nextSample + m_samples.size() - 1) % m_samples.size()];
+}
+
+#endif // CONVERGENCEMONITOR_HPP
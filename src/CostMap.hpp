@@ -2,7 +2,8 @@
 #define COSTMAP_HPP
 
 #include "Map.hpp"
+#include "MappedStorage.hpp"
 
-using CostMap = Map<std::uint8_t>;
+using CostMap = Map<std::uint8_t, MappedStorage<std::uint8_t>>;
 
 #endif // COSTMAP_HPP
@@ -0,0 +1,104 @@
+#ifndef COUNTERRNG_HPP
+#define COUNTERRNG_HPP
+
+#include <cstdint>
+#include <limits>
+
+// Independent random streams, one per user of randomness. Keep existing values stable, they are part of the key.
+enum class RNGSubsystem : std::uint64_t
+{
+   WorldGen      = 1,
+   BaseCost      = 2,
+   VillagerSpawn = 3,
+   VillagerStep  = 4,
+   Pathfinding   = 5,
+   Rendering     = 6
+};
+
+// Counter-based random number generator using the "Squares" function by Bernard Widynski
+// (https://arxiv.org/abs/2004.06278). Every value is computed from a key and a counter only, so any thread can
+// create the stream for (seed, subsystem, entityId, tick) on the spot and will draw the exact same numbers as any
+// other thread would, without sharing state. Satisfies UniformRandomBitGenerator for use with <random>.
+class CounterRNG final
+{
+public:
+   using result_type = std::uint64_t;
+
+public:
+   CounterRNG(const std::uint64_t seed, const RNGSubsystem subsystem, const std::uint64_t entityId = 0, const std::uint64_t tick = 0);
+
+   CounterRNG(const CounterRNG&) = default;
+   CounterRNG(CounterRNG&&) noexcept = default;
+
+   ~CounterRNG() = default;
+
+   CounterRNG& operator=(const CounterRNG&) = default;
+   CounterRNG& operator=(CounterRNG&&) noexcept = default;
+
+   static constexpr result_type min()
+   {
+      return std::numeric_limits<result_type>::min();
+   }
+
+   static constexpr result_type max()
+   {
+      return std::numeric_limits<result_type>::max();
+   }
+
+   result_type operator()();
+
+private:
+   std::uint64_t m_key;
+   std::uint64_t m_counter = 0;
+
+   static std::uint64_t mix(const std::uint64_t value);
+   static std::uint64_t squares64(const std::uint64_t counter, const std::uint64_t key);
+};
+
+inline CounterRNG::CounterRNG(const std::uint64_t seed, const RNGSubsystem subsystem, const std::uint64_t entityId, const std::uint64_t tick)
+{
+   static constexpr std::uint64_t golden = 0x9E3779B97F4A7C15;
+
+   auto key = mix(seed + golden);
+
+   key = mix(key + golden + static_cast<std::uint64_t>(subsystem));
+   key = mix(key + golden + entityId);
+   key = mix(key + golden + tick);
+
+   m_key = key | 1; // Squares requires an odd key
+}
+
+inline CounterRNG::result_type CounterRNG::operator()()
+{
+   return squares64(m_counter++, m_key);
+}
+
+// SplitMix64 finalizer
+inline std::uint64_t CounterRNG::mix(std::uint64_t value)
+{
+   value ^= value >> 30;
+   value *= 0xBF58476D1CE4E5B9;
+   value ^= value >> 27;
+   value *= 0x94D049BB133111EB;
+   value ^= value >> 31;
+
+   return value;
+}
+
+inline std::uint64_t CounterRNG::squares64(const std::uint64_t counter, const std::uint64_t key)
+{
+   std::uint64_t x = counter * key;
+
+   const std::uint64_t y = x;
+   const std::uint64_t z = y + key;
+
+   x = x * x + y; x = (x >> 32) | (x << 32); // Round 1
+   x = x * x + z; x = (x >> 32) | (x << 32); // Round 2
+   x = x * x + y; x = (x >> 32) | (x << 32); // Round 3
+
+   const std::uint64_t t = x = x * x + z; x = (x >> 32) | (x << 32); // Round 4
+
+   return t ^ ((x * x + y) >> 32); // Round 5
+}
+
+#endif // COUNTERRNG_HPP
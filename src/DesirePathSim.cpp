@@ -2,12 +2,20 @@
 
 #include <future>
 #include <chrono>
+#include <thread>
+#include <cmath>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <iostream>
 
 #include <rlgl.h>
 
 #include "WorldGen.hpp"
-#include "Pathfinding.hpp"
 #include "Version.hpp"
+#include "MapFile.hpp"
+#include "AllocationCounter.hpp"
 
 DesirePathSim::DesirePathSim(const Options& options):
    m_options{options},
@@ -15,36 +23,60 @@ DesirePathSim::DesirePathSim(const Options& options):
    m_worldHeightTiles{m_options.screenHeightPixels * 2 / m_tileHeightPixels},
    m_worldWidthPixels{m_worldWidthTiles * m_tileWidthPixels},
    m_worldHeightPixels{m_worldHeightTiles * m_tileHeightPixels},
-   m_baseRNG{std::random_device{}()},
-   m_voronoiMap{m_worldWidthTiles, m_worldHeightTiles},
-   m_worldMap{m_worldWidthTiles, m_worldHeightTiles, TileType::Grass},
-   m_baseCostMap{m_worldWidthTiles, m_worldHeightTiles, 0},
-   m_desirePathsMap{m_worldWidthTiles, m_worldHeightTiles, 0},
+   m_seed{(m_options.seed != 0) ? m_options.seed : std::random_device{}()},
+   m_convergenceMonitor{static_cast<std::size_t>(std::max(m_options.convergenceWindowSeconds, 0)), m_options.convergenceThresholdPerMille},
+   m_voronoiMap{m_worldWidthTiles, m_worldHeightTiles, 0, getLayerFilePath("voronoi_map")},
+   m_worldMap{m_worldWidthTiles, m_worldHeightTiles, TileType::Grass, getLayerFilePath("world_map")},
+   m_baseCostMap{m_worldWidthTiles, m_worldHeightTiles, 0, getLayerFilePath("base_cost_map")},
+   m_desirePathsMap{static_cast<std::size_t>(m_worldWidthTiles), static_cast<std::size_t>(m_worldHeightTiles), getLayerFilePath("desire_paths")},
+   m_shadowCasterBitmap{m_worldWidthTiles, m_worldHeightTiles, 0},
    m_shadowBitmap{m_worldWidthTiles, m_worldHeightTiles, 0},
-   m_villagers{m_options.villagerCount}
+   m_congestionCostMap{static_cast<std::size_t>(m_worldWidthTiles), static_cast<std::size_t>(m_worldHeightTiles), 0, getLayerFilePath("congestion_cost_map")},
+   m_worldDirtyChunks{m_worldMap.width(), m_worldMap.height()},
+   m_congestionDirtyChunks{m_worldMap.width(), m_worldMap.height()},
+   m_tileRecordDirtyChunks{m_worldMap.width(), m_worldMap.height()},
+   m_villagerStore{std::max(m_options.villagerCapacity, m_options.villagerCount), m_worldMap.width(), m_worldMap.height()},
+   m_tickWorkerPool{std::max<std::size_t>(m_options.tickThreadCount, 1)},
+   m_tickRegionOffsets(m_worldDirtyChunks.widthChunks() * m_worldDirtyChunks.heightChunks() + 1, 0),
+   m_tickRegionNextSlots(m_tickRegionOffsets.size(), 0),
+   m_tickRegionVillagerIndices(m_villagerStore.capacity(), 0),
+   m_tickTaskOutputs(m_tickWorkerPool.threadCount()),
+   m_tickBlockEntryCounts((m_villagerStore.capacity() + m_tickBlockVillagerCount - 1) / m_tickBlockVillagerCount, 0),
+   m_villagerOnScreen(m_villagerStore.capacity(), 1),
+   m_visibleWorldRect{0.0f, 0.0f, static_cast<float>(m_worldWidthPixels), static_cast<float>(m_worldHeightPixels)},
+   m_pathfindingService{
+      (m_options.pathfindingThreadCount > 0) ? m_options.pathfindingThreadCount : m_options.pathfindingMinThreadCount,
+      (m_options.pathfindingThreadCount > 0) ? m_options.pathfindingThreadCount : ((m_options.pathfindingMaxThreadCount > 0) ? m_options.pathfindingMaxThreadCount : std::max<std::size_t>(std::thread::hardware_concurrency(), 1)),
+      m_worldMap.width(),
+      m_worldMap.height(),
+      m_seed,
+      m_options.mortonPathfinding,
+      m_options.deterministicSimulation ? 0 : static_cast<std::uint64_t>(std::max(m_options.pathCoalesceTicks, 0)) // Joining older searches depends on timing
+   },
+   m_scheduledPathRequests{PoolAllocator<ScheduledPathRequest>{m_tickPool}},
+   m_heldPathCompletions{HeldPathCompletions::allocator_type{m_tickPool}}
 {
+   CounterRNG worldGenRNG{m_seed, RNGSubsystem::WorldGen};
+
    std::uniform_int_distribution<> rngPercent{1, 100};
 
-   auto voronoiCentroidList = Voronoi::generateCentroids(0, 0, m_voronoiMap.width(), m_voronoiMap.height(), m_options.voronoiCentroidCountPerLevel, m_baseRNG);
+   auto voronoiCentroidList = Voronoi::generateCentroids(0, 0, m_voronoiMap.width(), m_voronoiMap.height(), m_options.voronoiCentroidCountPerLevel, worldGenRNG);
 
-   for (std::size_t centroidY = 0; centroidY < m_voronoiMap.height(); ++centroidY)
+   m_voronoiMap.forEachInRect(0, 0, m_voronoiMap.width(), m_voronoiMap.height(), [&] (const std::size_t centroidX, const std::size_t centroidY, std::size_t& centroidIndex)
    {
-      for (std::size_t centroidX = 0; centroidX < m_voronoiMap.width(); ++centroidX)
+      centroidIndex = Voronoi::getShortestDistanceCentroidIndex(centroidX, centroidY, voronoiCentroidList, [this] (const std::size_t aX, const std::size_t aY, const std::size_t bX, const std::size_t bY)
       {
-         m_voronoiMap.at(centroidX, centroidY) = Voronoi::getShortestDistanceCentroidIndex(centroidX, centroidY, voronoiCentroidList, [this] (const std::size_t aX, const std::size_t aY, const std::size_t bX, const std::size_t bY)
-         {
-            return Voronoi::distanceMinkowski(aX, aY, bX, bY, m_options.voronoiLevel0MinkowskiP);
-         });
-      }
-   }
+         return Voronoi::distanceMinkowski(aX, aY, bX, bY, m_options.voronoiLevel0MinkowskiP);
+      });
+   });
 
    // Subdivide level 1
 
    for (std::size_t subdivideCentroidIndex = 0; subdivideCentroidIndex < m_options.voronoiCentroidCountPerLevel; ++subdivideCentroidIndex)
    {
-      if (rngPercent(m_baseRNG) <= m_options.voronoiSubdivideProbabilityLevel1)
+      if (rngPercent(worldGenRNG) <= m_options.voronoiSubdivideProbabilityLevel1)
       {
-         Voronoi::subdivide(voronoiCentroidList, subdivideCentroidIndex, m_voronoiMap, m_options.voronoiCentroidCountPerLevel, m_baseRNG, [this] (const std::size_t aX, const std::size_t aY, const std::size_t bX, const std::size_t bY)
+         Voronoi::subdivide(voronoiCentroidList, subdivideCentroidIndex, m_voronoiMap, m_options.voronoiCentroidCountPerLevel, worldGenRNG, [this] (const std::size_t aX, const std::size_t aY, const std::size_t bX, const std::size_t bY)
          {
             return Voronoi::distanceMinkowski(aX, aY, bX, bY, m_options.voronoiLevel1MinkowskiP);
          });
@@ -55,9 +87,9 @@ DesirePathSim::DesirePathSim(const Options& options):
 
    for (std::size_t subdivideCentroidIndex = m_options.voronoiCentroidCountPerLevel; subdivideCentroidIndex < m_options.voronoiCentroidCountPerLevel + m_options.voronoiCentroidCountPerLevel * m_options.voronoiCentroidCountPerLevel; ++subdivideCentroidIndex)
    {
-      if (rngPercent(m_baseRNG) <= m_options.voronoiSubdivideProbabilityLevel2)
+      if (rngPercent(worldGenRNG) <= m_options.voronoiSubdivideProbabilityLevel2)
       {
-         Voronoi::subdivide(voronoiCentroidList, subdivideCentroidIndex, m_voronoiMap, m_options.voronoiCentroidCountPerLevel, m_baseRNG, [this] (const std::size_t aX, const std::size_t aY, const std::size_t bX, const std::size_t bY)
+         Voronoi::subdivide(voronoiCentroidList, subdivideCentroidIndex, m_voronoiMap, m_options.voronoiCentroidCountPerLevel, worldGenRNG, [this] (const std::size_t aX, const std::size_t aY, const std::size_t bX, const std::size_t bY)
          {
             return Voronoi::distanceMinkowski(aX, aY, bX, bY, m_options.voronoiLevel2MinkowskiP);
          });
@@ -72,16 +104,16 @@ DesirePathSim::DesirePathSim(const Options& options):
 
       Color color
       {
-         static_cast<unsigned char>(rngCellColorChannel(m_baseRNG)),
-         static_cast<unsigned char>(rngCellColorChannel(m_baseRNG)),
-         static_cast<unsigned char>(rngCellColorChannel(m_baseRNG)),
+         static_cast<unsigned char>(rngCellColorChannel(worldGenRNG)),
+         static_cast<unsigned char>(rngCellColorChannel(worldGenRNG)),
+         static_cast<unsigned char>(rngCellColorChannel(worldGenRNG)),
          255
       };
 
       m_voronoiColorTable.emplace_back(color);
    }
 
-   WorldGen worldGen{m_worldMap, m_baseRNG};
+   WorldGen worldGen{m_worldMap, worldGenRNG};
 
    worldGen.placeStreetsFromVoronoiMap(m_voronoiMap);
 
@@ -119,22 +151,40 @@ DesirePathSim::DesirePathSim(const Options& options):
    }
 
    updateBaseCostMap();
-   updateShadowBitmap();
+   updateShadowBitmap(0, 0, m_worldMap.width(), m_worldMap.height());
 
-   for (auto& villager : m_villagers)
-   {
-      std::uniform_int_distribution<> rngColorChannel{8, 128};
+   m_generatedStreetTileCount = countTiles(TileType::Street);
+
+   m_worldDirtyChunks.addAll();
+   m_congestionDirtyChunks.addAll();
+   publishWorldSnapshot();
+   reserveWorldSnapshots();
+
+   // What the tick collects per villager is reserved for all of them up front, so ticking does not allocate
+   m_dueVillagerIndices.reserve(m_villagerStore.capacity());
 
-      villager.m_color.r = static_cast<unsigned char>(rngColorChannel(m_baseRNG));
-      villager.m_color.g = static_cast<unsigned char>(rngColorChannel(m_baseRNG));
-      villager.m_color.b = static_cast<unsigned char>(rngColorChannel(m_baseRNG));
+   for (auto& taskOutput : m_tickTaskOutputs)
+   {
+      taskOutput.stressDeltas.reserve(m_villagerStore.capacity());
+   }
 
-      villager.m_movementPixelPerSec = static_cast<float>(std::uniform_int_distribution<>{15, 20}(m_baseRNG)) * 4.0f;
+   if (m_options.congestionCost > 0)
+   {
+      m_dueVillagerTiles.reserve(m_villagerStore.capacity());
+      m_occupancyChangedTiles.reserve(2 * m_villagerStore.capacity());
+   }
 
-      villager.setState(Villager::State::EnqueuedForPath);
-      m_pathfindingQueue.push(&villager);
+   for (std::size_t villagerIndex = 0; villagerIndex < m_options.villagerCount; ++villagerIndex)
+   {
+      spawnVillager();
    }
 
+   if (m_options.headless)
+      return; // No window, no textures, no raylib calls at all
+
+   // A tile is paved only once, so no more tiles than the map has are ever waiting to be redrawn
+   m_changedTiles.reserve(m_worldMap.width() * m_worldMap.height());
+
    InitWindow(m_options.screenWidthPixels, m_options.screenHeightPixels, getAppNameWithVersion());
 
    if (m_options.targetFPS > 0)
@@ -143,7 +193,7 @@ DesirePathSim::DesirePathSim(const Options& options):
    }
 
    m_worldMapTexture = LoadRenderTexture(m_worldWidthPixels, m_worldHeightPixels);
-   updateWorldMapTexture(m_worldMapTexture);
+   updateWorldMapTexture(m_worldMapTexture, m_worldSnapshot->worldMap);
 
    m_shadowMapTexture = LoadRenderTexture(m_worldWidthPixels, m_worldHeightPixels);
    updateShadowMapTexture(m_shadowMapTexture, m_shadowBitmap);
@@ -157,6 +207,9 @@ DesirePathSim::DesirePathSim(const Options& options):
 
 DesirePathSim::~DesirePathSim()
 {
+   if (m_options.headless)
+      return;
+
    UnloadRenderTexture(m_desirePathsMapTexture);
    UnloadRenderTexture(m_shadowMapTexture);
    UnloadRenderTexture(m_worldMapTexture);
@@ -166,52 +219,23 @@ DesirePathSim::~DesirePathSim()
 
 void DesirePathSim::run()
 {
+   if (m_options.headless)
+   {
+      runHeadless();
+
+      return;
+   }
+
    bool drawVoronoi = false;
    bool drawShadowMap = true;
    bool drawDesirePath = true;
    bool drawDesirePathUpdateRect = false;
    bool drawKeysInfo = false;
 
-   std::size_t currentDesirePathsMapUpdateIndex = 0;
-
-   float desirePathDecayRatePerSec = 0.25f;
-   float desirePathDecayAccu = 0.0f;
-
    float fpsUpdateRatePerSec = 2.0f;
    float fpsUpdateAccu = 0.0f;
    int fps = 0;
 
-   std::vector<Pathfinder> pathfinders;
-   pathfinders.reserve(m_options.pathfindingThreadCount);
-
-   std::vector<std::mt19937_64> pathfindingRNGs;
-   pathfindingRNGs.reserve(m_options.pathfindingThreadCount);
-
-   std::vector<std::future<void>> pathfindingFutures;
-   pathfindingFutures.reserve(m_options.pathfindingThreadCount);
-
-   for (std::size_t pathfindingThreadIndex = 0; pathfindingThreadIndex < m_options.pathfindingThreadCount; ++pathfindingThreadIndex)
-   {
-      pathfinders.emplace_back(m_worldMap.width(), m_worldMap.height());
-
-      pathfindingRNGs.emplace_back(m_baseRNG());
-
-      pathfindingFutures.emplace_back(std::async(std::launch::async, [&] (const std::size_t threadIndex)
-      {
-         using namespace std::chrono_literals;
-
-         while (m_stopPathfindingThread.load() == false)
-         {
-            if (auto villager = m_pathfindingQueue.tryPopFor(100ms).value_or(nullptr); villager != nullptr)
-            {
-               villager->reset(m_worldMap, pathfinders[threadIndex], m_baseCostMap, m_tileWidthPixels, m_tileHeightPixels, pathfindingRNGs[threadIndex]);
-            }
-         }
-      }, pathfindingThreadIndex));
-   }
-
-   UpdateRect mapUpdateRect; // If this becomes non-0, the map itself has changed there and needs a visual update
-
    std::vector<UpdateRect> desirePathsUpdateRects; // Every frame a different subsection of the desire paths will be redrawn
 
    {
@@ -245,6 +269,17 @@ void DesirePathSim::run()
       }
    }
 
+   m_stopSimulationThread.store(false);
+
+   auto simulationFuture = std::async(std::launch::async, [&]
+   {
+      runSimulation(desirePathsUpdateRects);
+   });
+
+   std::vector<std::pair<std::size_t, std::size_t>> changedTiles;
+
+   changedTiles.reserve(m_worldMap.width() * m_worldMap.height());
+
    while (WindowShouldClose() == false)
    {
       const auto delta = GetFrameTime();
@@ -258,26 +293,27 @@ void DesirePathSim::run()
          fpsUpdateAccu = 0.0f;
       }
 
-      tickVillagers(mapUpdateRect, delta);
+      const bool renderStateChanged = m_renderStates.consume();
 
-      updateDesirePathsMapTexture(m_desirePathsMapTexture, desirePathsUpdateRects[currentDesirePathsMapUpdateIndex]);
-      currentDesirePathsMapUpdateIndex = currentDesirePathsMapUpdateIndex == desirePathsUpdateRects.size() - 1 ? 0 : currentDesirePathsMapUpdateIndex + 1;
+      const auto& renderState = m_renderStates.readBuffer(); // Only valid after consume, which may swap buffers
 
-      desirePathDecayAccu += delta;
+      if (renderStateChanged)
+      {
+         updateDesirePathsMapTexture(m_desirePathsMapTexture, renderState);
+      }
 
-      if (desirePathDecayAccu >= 1.0f / desirePathDecayRatePerSec)
       {
-         if (m_options.decayDesirePaths)
-         {
-            decayDesirePaths(m_desirePathsMap, m_baseCostMap);
-         }
+         std::lock_guard lock{m_changedTilesMutex};
 
-         desirePathDecayAccu = 0.0f;
+         std::swap(changedTiles, m_changedTiles);
       }
 
-      if (mapUpdateRect.empty() == false)
+      if (changedTiles.empty() == false)
       {
-         updateWorldMapTexture(m_worldMapTexture, mapUpdateRect);
+         // The snapshot is published before the changed tiles are handed over, so it is at least as new as them
+         updateWorldMapTexture(m_worldMapTexture, std::atomic_load(&m_worldSnapshot)->worldMap, changedTiles);
+
+         changedTiles.clear();
       }
 
       if (IsKeyPressed(KEY_ESCAPE))
@@ -303,6 +339,21 @@ void DesirePathSim::run()
          drawDesirePathUpdateRect = !drawDesirePathUpdateRect;
       }
 
+      if (IsKeyPressed(KEY_R))
+      {
+         m_rerouteVillagersRequested.store(true);
+      }
+
+      if (IsKeyPressed(KEY_KP_ADD) || IsKeyPressed(KEY_EQUAL))
+      {
+         m_requestedPopulationChange.fetch_add(static_cast<std::int64_t>(m_populationChangeStep));
+      }
+
+      if (IsKeyPressed(KEY_KP_SUBTRACT) || IsKeyPressed(KEY_MINUS))
+      {
+         m_requestedPopulationChange.fetch_sub(static_cast<std::int64_t>(m_populationChangeStep));
+      }
+
       if (IsKeyPressed(KEY_F1))
       {
          drawKeysInfo = !drawKeysInfo;
@@ -317,6 +368,19 @@ void DesirePathSim::run()
 
       updateCamera(delta);
 
+      if (m_options.villagerLOD)
+      {
+         // Villagers a bit outside of the screen still count as visible, so none are seen catching up
+         const auto marginPixels = static_cast<float>(m_tileWidthPixels * 4);
+
+         const auto viewTopLeft     = GetScreenToWorld2D({0.0f, 0.0f}, m_camera);
+         const auto viewBottomRight = GetScreenToWorld2D({static_cast<float>(m_options.screenWidthPixels), static_cast<float>(m_options.screenHeightPixels)}, m_camera);
+
+         std::lock_guard lock{m_visibleWorldRectMutex};
+
+         m_visibleWorldRect = {viewTopLeft.x - marginPixels, viewTopLeft.y - marginPixels, viewBottomRight.x - viewTopLeft.x + 2.0f * marginPixels, viewBottomRight.y - viewTopLeft.y + 2.0f * marginPixels};
+      }
+
       BeginDrawing();
 
       ClearBackground({0, 0, 0, 255});
@@ -350,9 +414,9 @@ void DesirePathSim::run()
 
          // Draw villagers
 
-         for (const auto& villager : m_villagers)
+         for (const auto& villager : renderState.villagers)
          {
-            DrawRectangleV(villager.m_position, {static_cast<float>(m_tileWidthPixels), static_cast<float>(m_tileHeightPixels)}, villager.m_color);
+            DrawRectangleV(villager.position, {static_cast<float>(m_tileWidthPixels), static_cast<float>(m_tileHeightPixels)}, villager.color);
          }
 
          if (drawShadowMap)
@@ -368,7 +432,7 @@ void DesirePathSim::run()
 
          if (drawDesirePathUpdateRect)
          {
-            const auto& desirePathsMapUpdateRect = desirePathsUpdateRects[currentDesirePathsMapUpdateIndex];
+            const auto& desirePathsMapUpdateRect = renderState.desirePathsUpdateRect;
 
             Vector2 position{static_cast<float>(desirePathsMapUpdateRect.left * m_tileWidthPixels), static_cast<float>(desirePathsMapUpdateRect.top * m_tileHeightPixels)};
 
@@ -381,6 +445,16 @@ void DesirePathSim::run()
       EndMode2D();
 
       DrawText(TextFormat("FPS: %i", fps), 10, 10, 20, BLACK);
+      DrawText(TextFormat("TPS: %i", renderState.ticksPerSecond), 10, 30, 20, BLACK);
+      DrawText(TextFormat("Seed: %llu", static_cast<unsigned long long>(m_seed)), 10, 50, 20, BLACK);
+      DrawText(TextFormat("Searches saved: %llu", static_cast<unsigned long long>(m_pathfindingService.savedSearchCount())), 10, 70, 20, BLACK);
+      DrawText(TextFormat("Pathfinding threads: %i", static_cast<int>(m_pathfindingService.activeThreadCount())), 10, 90, 20, BLACK);
+      DrawText(TextFormat("Villagers: %i / %i (%i bytes each)", static_cast<int>(renderState.villagers.size()), static_cast<int>(m_villagerStore.capacity()), static_cast<int>(getBytesPerVillager())), 10, 110, 20, BLACK);
+
+      if (renderState.desirePathsChangePerMille >= 0)
+      {
+         DrawText(TextFormat("Desire path change: %i per mille%s", renderState.desirePathsChangePerMille, renderState.desirePathsConverged ? " (converged)" : ""), 10, 130, 20, BLACK);
+      }
 
       static constexpr int s_kkiKeyInfoFontSize = 20;
 
@@ -392,6 +466,8 @@ void DesirePathSim::run()
          "[S] Toggle shadow map\n"
          "[D] Toggle desire path\n"
          "[U] Toggle desire path update rect\n"
+         "[R] Re-route all villagers\n"
+         "[+]/[-] Spawn/despawn 100 villagers\n"
          "[ARROW KEYS] Move map\n"
          "[MOUSE WHEEL] Zoom\n";
 
@@ -411,303 +487,1273 @@ void DesirePathSim::run()
       EndDrawing();
    }
 
-   m_stopPathfindingThread.store(true);
+   m_stopSimulationThread.store(true);
 
-   for (auto& pathfindingFuture : pathfindingFutures)
-   {
-      pathfindingFuture.wait();
-   }
+   simulationFuture.wait();
 }
 
-void DesirePathSim::tickVillagers(
-   UpdateRect& mapUpdateRect,
-   const float delta
-)
+std::string DesirePathSim::getLayerFilePath(const std::string& layerName) const
 {
-   for (auto& villager : m_villagers)
-   {
-      villager.tick(m_worldMap, mapUpdateRect, m_baseCostMap, m_desirePathsMap, m_options.paveDesirePaths, m_tileWidthPixels, m_tileHeightPixels, m_baseRNG, delta);
+   if (m_options.layerDirectory.empty())
+      return {};
 
-      if (villager.getState() == Villager::State::AwaitingPath)
-      {
-         villager.setState(Villager::State::EnqueuedForPath);
-         m_pathfindingQueue.push(&villager);
-      }
-   }
+   const std::filesystem::path layerDirectory{m_options.layerDirectory};
+
+   std::filesystem::create_directories(layerDirectory);
+
+   return (layerDirectory / (layerName + ".layer")).string();
 }
 
-void DesirePathSim::updateCamera(const float delta)
+void DesirePathSim::runHeadless()
 {
-   auto cameraSpeed = 400.0f;
+   // Ticks as fast as possible on the calling thread, without any of the pacing runSimulation does
 
-   if (IsKeyDown(KEY_RIGHT_SHIFT))
-      cameraSpeed *= 2.0;
+   const auto tickDelta = 1.0f / static_cast<float>(std::max(m_options.simulationTicksPerSec, 1));
 
-   if (IsKeyDown(KEY_LEFT))
-      m_camera.target.x -= cameraSpeed * delta;
-   else if (IsKeyDown(KEY_RIGHT))
-      m_camera.target.x += cameraSpeed * delta;
+   const auto tickCount = static_cast<std::uint64_t>(std::max(m_options.simulationSeconds, 0)) * static_cast<std::uint64_t>(std::max(m_options.simulationTicksPerSec, 1));
 
-   if (IsKeyDown(KEY_UP))
-      m_camera.target.y -= cameraSpeed * delta;
-   else if (IsKeyDown(KEY_DOWN))
-      m_camera.target.y += cameraSpeed * delta;
-}
+   if (m_options.checkAllocations && AllocationCounter::isEnabled() == false)
+      throw std::runtime_error{"Checking allocations needs a build with DESIREPATHSIM_COUNT_ALLOCATIONS"};
 
-void DesirePathSim::drawVoronoiMap()
-{
-   for (std::size_t voronoiY = 0; voronoiY < m_voronoiMap.height(); ++voronoiY)
+   std::vector<std::pair<std::size_t, std::size_t>> changedTiles;
+
+   changedTiles.reserve(m_worldMap.width() * m_worldMap.height());
+
+   // Allocations are counted over the second half of the run only, once pools and buffers have warmed up
+   const auto allocationCountStartTick = tickCount / 2;
+
+   std::uint64_t allocationCountAtStart = 0;
+
+   const auto startTime = std::chrono::steady_clock::now();
+
+   for (std::uint64_t tickIndex = 0; tickIndex < tickCount; ++tickIndex)
    {
-      for (std::size_t voronoiX = 0; voronoiX < m_voronoiMap.width(); ++voronoiX)
+      if (tickIndex == allocationCountStartTick)
       {
-         Vector2 tilePos{static_cast<float>(voronoiX * m_tileWidthPixels), static_cast<float>(voronoiY * m_tileHeightPixels)};
-
-         DrawRectangleV(tilePos, {static_cast<float>(m_tileWidthPixels), static_cast<float>(m_tileHeightPixels)}, m_voronoiColorTable.at(m_voronoiMap.at(voronoiX, voronoiY)));
+         allocationCountAtStart = AllocationCounter::threadAllocationCount();
       }
+
+      tickSimulation(changedTiles, tickDelta);
+
+      changedTiles.clear(); // Nothing to redraw
+
+      if (m_convergenceMonitor.converged())
+         break;
    }
+
+   const auto elapsedSec = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+   const auto allocationCountedTicks = (m_tickIndex > allocationCountStartTick) ? (m_tickIndex - allocationCountStartTick) : 0;
+   const auto allocationCount = AllocationCounter::threadAllocationCount() - allocationCountAtStart;
+
+   const double allocationsPerTick = (allocationCountedTicks > 0) ? (static_cast<double>(allocationCount) / static_cast<double>(allocationCountedTicks)) : 0.0;
+
+   writeHeadlessOutput(elapsedSec, allocationsPerTick);
+
+   if (m_options.checkAllocations && allocationCount != 0)
+      throw std::runtime_error{"The simulation thread allocated " + std::to_string(allocationCount) + " times over the last " + std::to_string(allocationCountedTicks) + " ticks"};
 }
 
-void DesirePathSim::updateWorldMapTexture(RenderTexture2D& texture, UpdateRect& updateRect)
+void DesirePathSim::writeHeadlessOutput(const double elapsedSec, const double allocationsPerTick)
 {
-   std::uniform_int_distribution<> rngPercent{1, 100};
-
-   BeginTextureMode(texture);
+   const std::filesystem::path outputPath{m_options.outputPath};
 
-   for (std::size_t worldTileY = updateRect.top; worldTileY <= updateRect.bottom; ++worldTileY)
-   {
-      for (std::size_t worldTileX = updateRect.left; worldTileX <= updateRect.right; ++worldTileX)
-      {
-         Vector2 tilePos{static_cast<float>(worldTileX * m_tileWidthPixels), static_cast<float>(worldTileY * m_tileHeightPixels)};
+   std::filesystem::create_directories(outputPath);
 
-         Color color{0, 0, 0, 255};
+   writeMapPGM(m_worldMap, (outputPath / "world_map.pgm").string());
+   writeMapPGM(m_desirePathsMap.toMap(), (outputPath / "desire_paths.pgm").string());
 
-         if (m_worldMap.at(worldTileX, worldTileY) == TileType::Water)
-         {
-            if (worldTileY % 3 == 1)
-            {
-               color = (worldTileX % 3 == 0) ? Color{60, 170, 255, 255} : Color{20, 130, 230, 255};
-            }
-            else if (worldTileY % 3 == 0)
-            {
-               color = (worldTileX % 3 > 0) ? Color{60, 170, 255, 255} : Color{20, 130, 230, 255};
-            }
-            else
-            {
-               color = Color{20, 130, 230, 255};
-            }
+   std::uint64_t tripCount = 0;
+   std::size_t movingVillagerCount = 0;
 
-            // Bevel
-            if (worldTileX > 0 && m_worldMap.at(worldTileX - 1, worldTileY) != TileType::Water)
-            {
-               color.r -= 20;
-               color.g -= 20;
-               color.b -= 20;
-            }
-            else if (worldTileY > 0 && m_worldMap.at(worldTileX, worldTileY - 1) != TileType::Water)
-            {
-               color.r -= 20;
-               color.g -= 20;
-               color.b -= 20;
-            }
-         }
-         else if (m_worldMap.at(worldTileX, worldTileY) == TileType::Tree)
-         {
-            color = (worldTileX + worldTileY) % 2 ? Color{90, 180, 40, 255} : Color{70, 160, 20, 255};
+   for (std::size_t villagerIndex = 0; villagerIndex < m_villagerStore.size(); ++villagerIndex)
+   {
+      if (m_villagerStore.isAlive(villagerIndex) == false)
+         continue;
 
-            // Bevel
-            if (worldTileX < m_worldMap.width() - 1 && m_worldMap.at(worldTileX + 1, worldTileY) != TileType::Tree)
-            {
-               color.r -= 20;
-               color.g -= 20;
-               color.b -= 20;
-            }
-            else if (worldTileY < m_worldMap.height() - 1 && m_worldMap.at(worldTileX, worldTileY + 1) != TileType::Tree)
-            {
-               color.r -= 20;
-               color.g -= 20;
-               color.b -= 20;
-            }
-         }
-         else if (m_worldMap.at(worldTileX, worldTileY) == TileType::BuildingEntrance)
-         {
-            if (rngPercent(m_baseRNG) <= 90)
-            {
-               color = Color{150, 150, 150, 255};
-            }
-            else
-            {
-               color = Color{130, 130, 130, 255};
-            }
-         }
-         else if (m_worldMap.at(worldTileX, worldTileY) == TileType::Building)
-         {
-            color = worldTileX % 2 ? Color{230, 130, 80, 255} : Color{210, 110, 60, 255};
+      const auto& villager = m_villagerStore.villager(villagerIndex);
 
-            // Bevel
-            if (worldTileX > 0 && m_worldMap.at(worldTileX - 1, worldTileY) != TileType::Building)
-            {
-               color.r += 20;
-               color.g += 20;
-               color.b += 20;
-            }
-            else if (worldTileY > 0 && m_worldMap.at(worldTileX, worldTileY - 1) != TileType::Building)
-            {
-               color.r += 20;
-               color.g += 20;
-               color.b += 20;
-            }
-            else if (worldTileX < m_worldMap.width() - 1 && m_worldMap.at(worldTileX + 1, worldTileY) != TileType::Building)
-            {
-               color.r -= 20;
-               color.g -= 20;
-               color.b -= 20;
-            }
-            else if (worldTileY < m_worldMap.height() - 1 && m_worldMap.at(worldTileX, worldTileY + 1) != TileType::Building)
-            {
-               color.r -= 20;
-               color.g -= 20;
-               color.b -= 20;
-            }
-         }
-         else if (m_worldMap.at(worldTileX, worldTileY) == TileType::Street)
-         {
-            if (rngPercent(m_baseRNG) <= 90)
-            {
-               color = Color{150, 150, 150, 255};
-            }
-            else
-            {
-               color = Color{130, 130, 130, 255};
-            }
-         }
-         else if(m_worldMap.at(worldTileX, worldTileY) == TileType::Grass)
-         {
-            if (rngPercent(m_baseRNG) <= 20)
-            {
-               color = Color{110, 200, 60, 255};
-            }
-            else
-            {
-               color = Color{130, 220, 80, 255};
-            }
-         }
+      tripCount += villager.m_tripCount;
 
-         DrawRectangleV(tilePos, {static_cast<float>(m_tileWidthPixels), static_cast<float>(m_tileHeightPixels)}, color);
+      if (villager.getState() == Villager::State::Moving)
+      {
+         movingVillagerCount += 1;
       }
    }
 
-   EndTextureMode();
+   const double ticksPerSec = (elapsedSec > 0.0) ? (static_cast<double>(m_tickIndex) / elapsedSec) : 0.0;
+
+   // Per tick, moving the villagers and finding the ones to tick
+   const double villagerScanMillisec = (m_tickIndex > 0) ? (m_villagerScanSec * 1000.0 / static_cast<double>(m_tickIndex)) : 0.0;
+
+   std::ostringstream stats;
+
+   stats << "version="                << getVersionStr()                         << '\n';
+   stats << "seed="                   << m_seed                                  << '\n';
+   stats << "world_width_tiles="      << m_worldMap.width()                      << '\n';
+   stats << "world_height_tiles="     << m_worldMap.height()                     << '\n';
+   stats << "villager_count="         << m_villagerStore.aliveCount()            << '\n';
+   stats << "villager_capacity="      << m_villagerStore.capacity()              << '\n';
+   stats << "bytes_per_villager="     << getBytesPerVillager()                   << '\n';
+   stats << "ticks="                  << m_tickIndex                             << '\n';
+   stats << "simulated_seconds="      << m_simulationTime                        << '\n';
+   stats << "elapsed_seconds="        << elapsedSec                              << '\n';
+   stats << "ticks_per_second="       << ticksPerSec                             << '\n';
+   stats << "villager_scan_ms="       << villagerScanMillisec                    << '\n';
+   stats << "trips_requested="        << tripCount                               << '\n';
+   stats << "villagers_moving="       << movingVillagerCount                     << '\n';
+   stats << "searches_saved="         << m_pathfindingService.savedSearchCount() << '\n';
+   stats << "street_tiles_generated=" << m_generatedStreetTileCount              << '\n';
+   stats << "street_tiles_final="     << countTiles(TileType::Street)            << '\n';
+   stats << "desire_path_tiles="      << m_desirePathsMap.activeTileCount()      << '\n';
+
+   if (m_convergenceMonitor.windowFull())
+   {
+      stats << "change_per_mille="    << m_convergenceMonitor.changePerMille()   << '\n';
+      stats << "converged="           << m_convergenceMonitor.converged()        << '\n';
+   }
 
-   updateRect.reset();
-}
+   if (AllocationCounter::isEnabled())
+   {
+      stats << "allocations_per_tick=" << allocationsPerTick << '\n';
+   }
 
-void DesirePathSim::updateWorldMapTexture(RenderTexture2D& texture)
-{
-   UpdateRect updateRect{0, 0, m_worldMap.width() - 1, m_worldMap.height() - 1};
+   const auto statsFilePath = (outputPath / "stats.txt").string();
 
-   updateWorldMapTexture(texture, updateRect);
+   std::ofstream statsFile{statsFilePath};
+
+   if (statsFile.is_open() == false)
+      throw std::runtime_error{"Could not open \"" + statsFilePath + "\" for writing"};
+
+   statsFile << stats.str();
+
+   std::cout << stats.str();
 }
 
-void DesirePathSim::updateShadowMapTexture(RenderTexture2D& texture, const Bitmap& shadowBitmap)
+std::size_t DesirePathSim::countTiles(const TileType tileType) const
 {
-   BeginTextureMode(texture);
+   std::size_t tileCount = 0;
 
-   for (std::size_t worldTileY = 0; worldTileY < shadowBitmap.height(); ++worldTileY)
+   m_worldMap.forEachInRect(0, 0, m_worldMap.width(), m_worldMap.height(), [&] (const std::size_t /*tileX*/, const std::size_t /*tileY*/, const TileType value)
    {
-      for (std::size_t worldTileX = 0; worldTileX < shadowBitmap.width(); ++worldTileX)
+      if (value == tileType)
       {
-         Vector2 tilePos{static_cast<float>(worldTileX * m_tileWidthPixels), static_cast<float>(worldTileY * m_tileHeightPixels)};
-
-         Color color{0, 0, 0, 0};
-
-         if (shadowBitmap.at(worldTileX, worldTileY) == 1) // Shadow
-         {
-            color = Color{0, 0, 0, 150};
-         }
-
-         DrawRectangleV(tilePos, {static_cast<float>(m_tileWidthPixels), static_cast<float>(m_tileHeightPixels)}, color);
+         tileCount += 1;
       }
-   }
+   });
 
-   EndTextureMode();
+   return tileCount;
 }
 
-void DesirePathSim::updateDesirePathsMapTexture(RenderTexture2D& texture, const UpdateRect& updateRect)
+void DesirePathSim::runSimulation(const std::vector<UpdateRect>& desirePathsUpdateRects)
 {
-   BeginTextureMode(texture);
+   using Clock = std::chrono::steady_clock;
 
-   const Vector2 updateRectPos  = {static_cast<float>(updateRect.left    * m_tileWidthPixels), static_cast<float>(updateRect.top      * m_tileHeightPixels)};
-   const Vector2 updateRectSize = {static_cast<float>(updateRect.width() * m_tileWidthPixels), static_cast<float>(updateRect.height() * m_tileHeightPixels)};
+   std::size_t currentDesirePathsMapUpdateIndex = 0;
 
-   //                SRC_ALPHA, SRC_ALPHA,    MIN
-   rlSetBlendFactors(   0x0302,    0x0302, 0x8007); // Clear
-   rlSetBlendMode(BLEND_CUSTOM);
-   DrawRectangleV(updateRectPos, updateRectSize, {0, 0, 0, 0});
-   rlSetBlendMode(BLEND_ALPHA);
+   // Every tick advances the simulation by the same amount, independent of how long it took in real time
+   const auto tickDelta = 1.0f / static_cast<float>(std::max(m_options.simulationTicksPerSec, 1));
 
-   for (std::size_t worldTileY = updateRect.top; worldTileY <= updateRect.bottom; ++worldTileY)
+   const auto frameBudget = std::chrono::milliseconds{std::max(m_options.simulationFrameBudgetMillisec, 1)};
+
+   const bool asFastAsPossible = (m_options.simulationSpeed <= 0);
+
+   // Simulated time that is due but has not been ticked yet
+   double pendingSimulationTime = 0.0;
+
+   float tpsUpdateRatePerSec = 2.0f;
+   float tpsUpdateAccu = 0.0f;
+   int tpsTickCount = 0;
+   int tps = 0;
+
+   std::vector<std::pair<std::size_t, std::size_t>> changedTiles;
+
+   changedTiles.reserve(m_worldMap.width() * m_worldMap.height());
+
+   auto lastFrameStartTime = Clock::now();
+
+   while (m_stopSimulationThread.load() == false)
    {
-      for (std::size_t worldTileX = updateRect.left; worldTileX <= updateRect.right; ++worldTileX)
+      const auto frameStartTime = Clock::now();
+
+      const auto realDelta = std::chrono::duration<float>(frameStartTime - lastFrameStartTime).count();
+
+      lastFrameStartTime = frameStartTime;
+
+      if (asFastAsPossible == false)
       {
-         const Vector2 tilePos{static_cast<float>(worldTileX * m_tileWidthPixels), static_cast<float>(worldTileY * m_tileHeightPixels)};
+         pendingSimulationTime += static_cast<double>(realDelta) * m_options.simulationSpeed;
+      }
 
-         const int selfAlpha = m_desirePathsMap.at(worldTileX, worldTileY);
+      // Tick until caught up with real time or until the frame budget is used up, whichever comes first
 
-         int neighborAlphaSum = 0;
+      while (m_stopSimulationThread.load() == false && (asFastAsPossible || pendingSimulationTime >= tickDelta))
+      {
+         tickSimulation(changedTiles, tickDelta);
 
-         if (worldTileX > 0                      ) neighborAlphaSum += m_desirePathsMap.at(worldTileX - 1, worldTileY    );
-         if (worldTileX < m_worldMap.width () - 1) neighborAlphaSum += m_desirePathsMap.at(worldTileX + 1, worldTileY    );
-         if (worldTileY > 0                      ) neighborAlphaSum += m_desirePathsMap.at(worldTileX    , worldTileY - 1);
-         if (worldTileY < m_worldMap.height() - 1) neighborAlphaSum += m_desirePathsMap.at(worldTileX    , worldTileY + 1);
+         pendingSimulationTime -= tickDelta;
+         tpsTickCount += 1;
 
-         const auto finalAlpha = static_cast<unsigned char>(std::max(selfAlpha, neighborAlphaSum / 4)); // Could be less than 4 neighbors but let's not care too much about map edges
+         if (Clock::now() - frameStartTime >= frameBudget)
+         {
+            // Falling behind, drop what could not be simulated instead of trying to catch up forever
+            pendingSimulationTime = std::min(pendingSimulationTime, static_cast<double>(tickDelta));
 
-         const auto color = Color{90, 80, 50, finalAlpha};
+            break;
+         }
+      }
 
-         DrawRectangleV(tilePos, {static_cast<float>(m_tileWidthPixels), static_cast<float>(m_tileHeightPixels)}, color);
+      tpsUpdateAccu += realDelta;
+
+      if (tpsUpdateAccu >= 1.0f / tpsUpdateRatePerSec)
+      {
+         tps = static_cast<int>(static_cast<float>(tpsTickCount) / tpsUpdateAccu);
+
+         tpsUpdateAccu = 0.0f;
+         tpsTickCount = 0;
       }
-   }
 
-   EndTextureMode();
-}
+      if (changedTiles.empty() == false)
+      {
+         std::lock_guard lock{m_changedTilesMutex};
 
-void DesirePathSim::updateDesirePathsMapTexture(RenderTexture2D& texture)
-{
-   UpdateRect updateRect{0, 0, m_desirePathsMap.width() - 1, m_desirePathsMap.height() - 1};
+         m_changedTiles.insert(std::end(m_changedTiles), std::begin(changedTiles), std::end(changedTiles));
 
-   updateDesirePathsMapTexture(texture, updateRect);
-}
+         changedTiles.clear();
+      }
 
-void DesirePathSim::updateBaseCostMap()
-{
-   for (std::size_t y = 0; y < m_worldMap.height(); ++y)
-   {
-      for (std::size_t x = 0; x < m_worldMap.width(); ++x)
+      publishRenderState(desirePathsUpdateRects[currentDesirePathsMapUpdateIndex], tps);
+      currentDesirePathsMapUpdateIndex = currentDesirePathsMapUpdateIndex == desirePathsUpdateRects.size() - 1 ? 0 : currentDesirePathsMapUpdateIndex + 1;
+
+      if (asFastAsPossible == false && pendingSimulationTime < tickDelta)
       {
-         m_baseCostMap.at(x, y) = getBaseCostForValue(m_worldMap.at(x, y), m_baseRNG);
+         // Sleep until the next tick is due
+         const auto realTimeUntilNextTick = (tickDelta - pendingSimulationTime) / m_options.simulationSpeed;
+
+         std::this_thread::sleep_until(frameStartTime + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(realTimeUntilNextTick)));
       }
    }
 }
 
-void DesirePathSim::updateShadowBitmap()
+void DesirePathSim::tickSimulation(std::vector<std::pair<std::size_t, std::size_t>>& changedTiles, const float delta)
 {
-   for (std::size_t y = 0; y < m_worldMap.height(); ++y)
+   static constexpr float desirePathDecayRatePerSec = 0.25f;
+
+   const auto changedTileCountBefore = changedTiles.size();
+
+   tickVillagers(changedTiles, delta);
+
+   m_pavedTileCount += changedTiles.size() - changedTileCountBefore;
+
+   m_desirePathDecayAccu += delta;
+
+   if (m_desirePathDecayAccu >= 1.0f / desirePathDecayRatePerSec)
    {
-      for (std::size_t x = 0; x < m_worldMap.width(); ++x)
+      if (m_options.decayDesirePaths)
       {
-         if (m_worldMap.at(x, y) == TileType::Building || m_worldMap.at(x, y) == TileType::Tree)
-         {
-            m_shadowBitmap.at(x, y) = 1;
-         }
-         else
-         {
-            m_shadowBitmap.at(x, y) = 0;
-         }
+         decayDesirePaths(m_desirePathsMap, m_baseCostMap, m_worldDirtyChunks);
       }
+
+      m_desirePathDecayAccu = 0.0f;
    }
 
-   auto shadowBitmapDilatedEroded = BitmapTransform::dilate(m_shadowBitmap, false);
-   shadowBitmapDilatedEroded = BitmapTransform::erode(shadowBitmapDilatedEroded, false);
-   auto shadowBitmapDilatedErodedShifted = BitmapTransform::shift(shadowBitmapDilatedEroded, 1, 1, 0);
-   m_shadowBitmap = BitmapTransform::mask(shadowBitmapDilatedErodedShifted, m_shadowBitmap, 0, 0);
+   m_convergenceSampleAccu += delta;
+
+   if (m_convergenceSampleAccu >= 1.0f)
+   {
+      m_convergenceMonitor.addSample(m_pavedTileCount, m_desirePathsMap.costStepSum());
+
+      m_convergenceSampleAccu -= 1.0f;
+   }
+
+   if (m_options.congestionCost > 0 && (m_tickIndex % m_congestionUpdateIntervalTicks) == 0)
+   {
+      updateCongestionCostMap();
+   }
+
+   // Published every tick, so which snapshot a path request sees only depends on the tick it was made in
+   if (m_worldDirtyChunks.empty() == false || m_congestionDirtyChunks.empty() == false)
+   {
+      publishWorldSnapshot();
+   }
+}
+
+void DesirePathSim::tickVillagers(
+   std::vector<std::pair<std::size_t, std::size_t>>& changedTiles,
+   const float delta
+)
+{
+   if (m_rerouteVillagersRequested.exchange(false))
+   {
+      rerouteVillagers();
+   }
+
+   changePopulation(delta);
+
+   applyPathCompletions();
+
+   const auto villagerCount = m_villagerStore.size();
+
+   m_simulationTime += delta;
+
+   const auto scanStartTime = std::chrono::steady_clock::now();
+
+   m_dueVillagerIndices.clear();
+
+   if (m_options.eventDrivenMovement)
+   {
+      m_movementWheel.advance(static_cast<std::uint64_t>(std::floor(m_simulationTime * m_movementWheelTicksPerSec)), m_dueVillagerIndices);
+
+      // Drop duplicates and entries left over from paths that have been replaced in the meantime
+
+      std::sort(std::begin(m_dueVillagerIndices), std::end(m_dueVillagerIndices));
+
+      m_dueVillagerIndices.erase(std::unique(std::begin(m_dueVillagerIndices), std::end(m_dueVillagerIndices)), std::end(m_dueVillagerIndices));
+
+      m_dueVillagerIndices.erase(std::remove_if(std::begin(m_dueVillagerIndices), std::end(m_dueVillagerIndices), [&] (const std::size_t villagerIndex)
+      {
+         switch (m_villagerStore.villager(villagerIndex).getState())
+         {
+         case Villager::State::PathProvided:
+            return false;
+         case Villager::State::Moving:
+            return (toMovementWheelTick(m_villagerStore.arrivalTime(villagerIndex)) > m_movementWheel.currentTick());
+         default:
+            return true;
+         }
+      }), std::end(m_dueVillagerIndices));
+   }
+   else
+   {
+      const bool useLOD = (m_options.villagerLOD && m_options.analyticTrips == false);
+
+      Rectangle visibleWorldRect = {};
+
+      if (useLOD)
+      {
+         std::lock_guard lock{m_visibleWorldRectMutex};
+
+         visibleWorldRect = m_visibleWorldRect;
+      }
+
+      const auto blockCount = (villagerCount + m_tickBlockVillagerCount - 1) / m_tickBlockVillagerCount;
+
+      m_tickWorkerPool.run(blockCount, [&] (const std::size_t blockIndex)
+      {
+         const auto beginIndex = blockIndex * m_tickBlockVillagerCount;
+         const auto endIndex = std::min(beginIndex + m_tickBlockVillagerCount, villagerCount);
+
+         // With analytic trips no one is ever between two tiles, only villagers with a new path are due
+         if (m_options.analyticTrips == false)
+         {
+            if (useLOD)
+            {
+               for (auto villagerIndex = beginIndex; villagerIndex < endIndex; ++villagerIndex)
+               {
+                  const auto x = m_villagerStore.m_positionX[villagerIndex];
+                  const auto y = m_villagerStore.m_positionY[villagerIndex];
+
+                  m_villagerOnScreen[villagerIndex] = (x >= visibleWorldRect.x && y >= visibleWorldRect.y && x < visibleWorldRect.x + visibleWorldRect.width && y < visibleWorldRect.y + visibleWorldRect.height) ? 1 : 0;
+               }
+
+               m_villagerStore.moveVillagers(beginIndex, endIndex, delta, m_villagerOnScreen.data());
+            }
+            else
+            {
+               m_villagerStore.moveVillagers(beginIndex, endIndex, delta);
+            }
+         }
+
+         std::size_t dueCount = 0;
+
+         for (auto villagerIndex = beginIndex; villagerIndex < endIndex; ++villagerIndex)
+         {
+            bool isDue = m_villagerStore.needsTick(villagerIndex);
+
+            if (isDue == false && useLOD && m_villagerStore.hasDeferredTime(villagerIndex))
+            {
+               // Off-screen villagers take turns catching up, villagers that just came into view do so right away
+               isDue = (m_villagerOnScreen[villagerIndex] != 0 || (villagerIndex + m_tickIndex) % m_lodTickInterval == 0);
+            }
+
+            if (isDue)
+            {
+               m_tickRegionVillagerIndices[beginIndex + dueCount++] = villagerIndex;
+            }
+         }
+
+         m_tickBlockEntryCounts[blockIndex] = dueCount;
+      });
+
+      for (std::size_t blockIndex = 0; blockIndex < blockCount; ++blockIndex)
+      {
+         const auto blockDueIndices = std::begin(m_tickRegionVillagerIndices) + blockIndex * m_tickBlockVillagerCount;
+
+         m_dueVillagerIndices.insert(std::end(m_dueVillagerIndices), blockDueIndices, blockDueIndices + m_tickBlockEntryCounts[blockIndex]);
+      }
+   }
+
+   m_villagerScanSec += std::chrono::duration<double>(std::chrono::steady_clock::now() - scanStartTime).count();
+
+   const auto regionCount = m_tickRegionOffsets.size() - 1;
+
+   auto getRegionIndex = [&] (const std::size_t villagerIndex)
+   {
+      const auto tileX = std::min(static_cast<std::size_t>(std::max(m_villagerStore.m_positionX[villagerIndex], 0.0f)) / m_tileWidthPixels , m_worldMap.width () - 1);
+      const auto tileY = std::min(static_cast<std::size_t>(std::max(m_villagerStore.m_positionY[villagerIndex], 0.0f)) / m_tileHeightPixels, m_worldMap.height() - 1);
+
+      return (tileY / DirtyChunkMask::m_chunkEdgeTiles) * m_worldDirtyChunks.widthChunks() + (tileX / DirtyChunkMask::m_chunkEdgeTiles);
+   };
+
+   // Counting sort of all due villagers by region, keeps villagers of the same region in index order
+
+   std::fill(std::begin(m_tickRegionOffsets), std::end(m_tickRegionOffsets), 0);
+
+   m_dueVillagerTiles.clear();
+
+   for (const auto villagerIndex : m_dueVillagerIndices)
+   {
+      m_tickRegionOffsets[getRegionIndex(villagerIndex) + 1] += 1;
+
+      if (m_options.congestionCost > 0)
+      {
+         m_dueVillagerTiles.emplace_back(m_villagerStore.occupiedTile(villagerIndex));
+      }
+   }
+
+   for (std::size_t regionIndex = 1; regionIndex <= regionCount; ++regionIndex)
+   {
+      m_tickRegionOffsets[regionIndex] += m_tickRegionOffsets[regionIndex - 1];
+   }
+
+   std::copy(std::begin(m_tickRegionOffsets), std::end(m_tickRegionOffsets), std::begin(m_tickRegionNextSlots));
+
+   for (const auto villagerIndex : m_dueVillagerIndices)
+   {
+      m_tickRegionVillagerIndices[m_tickRegionNextSlots[getRegionIndex(villagerIndex)]++] = villagerIndex;
+   }
+
+   auto tickRegion = [&] (const std::size_t regionIndex, TickTaskOutput& taskOutput)
+   {
+      for (auto slot = m_tickRegionOffsets[regionIndex]; slot < m_tickRegionOffsets[regionIndex + 1]; ++slot)
+      {
+         const auto villagerIndex = m_tickRegionVillagerIndices[slot];
+
+         if (m_options.analyticTrips)
+         {
+            m_villagerStore.walkPath(villagerIndex, m_worldMap, taskOutput.stressDeltas, m_tileWidthPixels, m_tileHeightPixels, m_seed);
+         }
+         else if (m_villagerStore.hasDeferredTime(villagerIndex))
+         {
+            m_villagerStore.catchUpVillager(villagerIndex, m_worldMap, taskOutput.stressDeltas, m_tileWidthPixels, m_tileHeightPixels, m_seed, m_simulationTime);
+         }
+         else
+         {
+            m_villagerStore.tickVillager(villagerIndex, m_worldMap, taskOutput.stressDeltas, m_tileWidthPixels, m_tileHeightPixels, m_seed, m_simulationTime);
+         }
+      }
+   };
+
+   // Each task takes a run of neighbouring regions with about the same number of due villagers. Too few villagers
+   // for a second task are ticked on this thread alone, waking up the pool would cost more than it saves.
+   const auto dueVillagerCount = m_dueVillagerIndices.size();
+   const auto taskCount = std::clamp<std::size_t>(dueVillagerCount / m_tickTaskMinVillagerCount, 1, m_tickWorkerPool.threadCount());
+
+   m_tickWorkerPool.run(taskCount, [&] (const std::size_t taskIndex)
+   {
+      // The first region starting at or after the task's share of the sorted villagers
+      auto getFirstRegionIndex = [&] (const std::size_t taskBoundaryIndex)
+      {
+         if (taskBoundaryIndex == taskCount)
+            return regionCount;
+
+         const auto firstSlot = taskBoundaryIndex * dueVillagerCount / taskCount;
+
+         return static_cast<std::size_t>(std::lower_bound(std::begin(m_tickRegionOffsets), std::end(m_tickRegionOffsets) - 1, firstSlot) - std::begin(m_tickRegionOffsets));
+      };
+
+      auto& taskOutput = m_tickTaskOutputs[taskIndex];
+
+      taskOutput.stressDeltas.clear();
+
+      const auto endRegionIndex = getFirstRegionIndex(taskIndex + 1);
+
+      for (auto regionIndex = getFirstRegionIndex(taskIndex); regionIndex < endRegionIndex; ++regionIndex)
+      {
+         tickRegion(regionIndex, taskOutput);
+      }
+   });
+
+   // Merge in fixed region order
+
+   for (std::size_t taskIndex = 0; taskIndex < taskCount; ++taskIndex)
+   {
+      for (const auto& stressDelta : m_tickTaskOutputs[taskIndex].stressDeltas)
+      {
+         applyDesirePathStressDelta(stressDelta, m_worldMap, changedTiles, m_worldDirtyChunks, m_baseCostMap, m_desirePathsMap, m_options.paveDesirePaths, m_seed);
+      }
+   }
+
+   // Tiles a villager only passed through within the tick are left with the same count, so comparing the tile before
+   // and after is enough
+   for (std::size_t dueIndex = 0; dueIndex < m_dueVillagerTiles.size(); ++dueIndex)
+   {
+      const auto previousTile = m_dueVillagerTiles[dueIndex];
+      const auto currentTile = m_villagerStore.occupiedTile(m_dueVillagerIndices[dueIndex]);
+
+      if (previousTile != currentTile)
+      {
+         recordOccupancyChange(previousTile);
+         recordOccupancyChange(currentTile);
+      }
+   }
+
+   // Villagers that reached their destination during the tick, in region order
+   for (std::size_t slot = 0; slot < dueVillagerCount; ++slot)
+   {
+      const auto villagerIndex = m_tickRegionVillagerIndices[slot];
+
+      if (m_villagerStore.villager(villagerIndex).getState() == Villager::State::AwaitingPath)
+      {
+         requestPath(villagerIndex);
+      }
+   }
+
+   if (m_options.eventDrivenMovement)
+   {
+      for (const auto villagerIndex : m_dueVillagerIndices)
+      {
+         if (m_villagerStore.villager(villagerIndex).getState() == Villager::State::Moving)
+         {
+            m_movementWheel.schedule(villagerIndex, toMovementWheelTick(m_villagerStore.arrivalTime(villagerIndex)));
+         }
+      }
+   }
+
+   m_tickIndex += 1;
+}
+
+std::uint64_t DesirePathSim::toMovementWheelTick(const double time)
+{
+   return static_cast<std::uint64_t>(std::ceil(time * m_movementWheelTicksPerSec));
+}
+
+void DesirePathSim::spawnVillager()
+{
+   const auto villagerId = m_nextVillagerId;
+
+   const auto handle = m_villagerStore.spawn(villagerId);
+
+   if (handle.has_value() == false)
+      return; // At capacity
+
+   m_nextVillagerId += 1;
+
+   auto& villager = m_villagerStore.villager(handle->index);
+
+   CounterRNG villagerSpawnRNG{m_seed, RNGSubsystem::VillagerSpawn, villagerId};
+
+   std::uniform_int_distribution<> rngColorChannel{8, 128};
+
+   villager.m_color.r = static_cast<unsigned char>(rngColorChannel(villagerSpawnRNG));
+   villager.m_color.g = static_cast<unsigned char>(rngColorChannel(villagerSpawnRNG));
+   villager.m_color.b = static_cast<unsigned char>(rngColorChannel(villagerSpawnRNG));
+
+   villager.m_movementPixelPerSec = static_cast<float>(std::uniform_int_distribution<>{15, 20}(villagerSpawnRNG)) * 4.0f;
+
+   requestPath(handle->index);
+}
+
+void DesirePathSim::despawnVillager(const std::size_t villagerIndex)
+{
+   const auto& villager = m_villagerStore.villager(villagerIndex);
+
+   if (villager.getState() == Villager::State::EnqueuedForPath)
+   {
+      m_pathfindingService.cancel(villager.m_pathTicket);
+   }
+
+   recordOccupancyChange(m_villagerStore.occupiedTile(villagerIndex));
+
+   m_villagerStore.despawn(villagerIndex);
+}
+
+void DesirePathSim::changePopulation(const float delta)
+{
+   auto populationChange = m_requestedPopulationChange.exchange(0);
+
+   if (m_options.villagerSpawnRatePerSec > 0)
+   {
+      m_villagerSpawnAccu += delta * static_cast<float>(m_options.villagerSpawnRatePerSec);
+
+      const auto scheduledSpawnCount = static_cast<std::int64_t>(m_villagerSpawnAccu);
+
+      m_villagerSpawnAccu -= static_cast<float>(scheduledSpawnCount);
+
+      populationChange += scheduledSpawnCount;
+   }
+
+   for (; populationChange > 0 && m_villagerStore.aliveCount() < m_villagerStore.capacity(); --populationChange)
+   {
+      spawnVillager();
+   }
+
+   // Despawn from the highest index down, so the next spawns can fill up the same indices again
+
+   for (auto villagerIndex = m_villagerStore.size(); populationChange < 0 && villagerIndex > 0; --villagerIndex)
+   {
+      if (m_villagerStore.isAlive(villagerIndex - 1))
+      {
+         despawnVillager(villagerIndex - 1);
+
+         populationChange += 1;
+      }
+   }
+}
+
+std::size_t DesirePathSim::getBytesPerVillager() const
+{
+   // Besides the store, the tick keeps a region slot, a due slot, an on-screen flag and a stress delta per tick thread,
+   // with congestion also the tile left and two changed tiles, and every render state a position and color
+   auto tickBytes = 2 * sizeof(std::size_t) + sizeof(std::uint8_t) + m_tickWorkerPool.threadCount() * sizeof(DesirePathStressDelta);
+
+   if (m_options.congestionCost > 0)
+   {
+      tickBytes += 3 * sizeof(std::uint32_t);
+   }
+
+   return VillagerStore::bytesPerVillager() + tickBytes + 3 * sizeof(RenderState::Villager);
+}
+
+void DesirePathSim::requestPath(const std::size_t villagerIndex)
+{
+   auto& villager = m_villagerStore.villager(villagerIndex);
+
+   const auto villagerHandle = m_villagerStore.handle(villagerIndex);
+
+   villager.m_pathTicket = m_pathfindingService.submit(PathRequest{villagerHandle, villager.m_id, villager.m_tripCount, m_worldSnapshot});
+   villager.m_tripCount += 1;
+
+   villager.setState(Villager::State::EnqueuedForPath);
+
+   if (m_options.deterministicSimulation)
+   {
+      m_scheduledPathRequests.emplace_back(ScheduledPathRequest{m_tickIndex + m_deterministicPathLatencyTicks, villagerHandle, villager.m_pathTicket});
+   }
+}
+
+void DesirePathSim::applyPathCompletions()
+{
+   m_pathfindingService.drainCompletions(m_pathCompletions);
+
+   if (m_options.deterministicSimulation == false)
+   {
+      // Paths are applied whenever they happen to be done
+      for (auto& completion : m_pathCompletions)
+      {
+         applyPathCompletion(completion);
+      }
+
+      return;
+   }
+
+   auto holdPathCompletions = [this] ()
+   {
+      for (auto& completion : m_pathCompletions)
+      {
+         const auto ticket = completion.ticket;
+
+         m_heldPathCompletions.emplace(ticket, std::move(completion));
+      }
+   };
+
+   holdPathCompletions();
+
+   // Apply in request order whatever is scheduled until now, waiting for searches that are late
+
+   while (m_scheduledPathRequests.empty() == false && m_scheduledPathRequests.front().applyTick <= m_tickIndex)
+   {
+      const auto scheduledPathRequest = m_scheduledPathRequests.front();
+
+      if (isPathRequestCurrent(scheduledPathRequest.villager, scheduledPathRequest.ticket) == false)
+      {
+         // Cancelled
+         m_heldPathCompletions.erase(scheduledPathRequest.ticket);
+         m_scheduledPathRequests.pop_front();
+
+         continue;
+      }
+
+      const auto heldPathCompletionIt = m_heldPathCompletions.find(scheduledPathRequest.ticket);
+
+      if (heldPathCompletionIt == std::end(m_heldPathCompletions))
+      {
+         m_pathfindingService.waitForCompletions();
+         m_pathfindingService.drainCompletions(m_pathCompletions);
+
+         holdPathCompletions();
+
+         continue;
+      }
+
+      auto completion = std::move(heldPathCompletionIt->second);
+
+      m_heldPathCompletions.erase(heldPathCompletionIt);
+      m_scheduledPathRequests.pop_front();
+
+      applyPathCompletion(completion); // Might schedule a new request
+   }
+}
+
+bool DesirePathSim::isPathRequestCurrent(const VillagerHandle villagerHandle, const PathTicket ticket) const
+{
+   if (m_villagerStore.isValid(villagerHandle) == false)
+      return false; // Despawned, maybe even replaced by a new villager
+
+   const auto& villager = m_villagerStore.villager(villagerHandle.index);
+
+   return villager.getState() == Villager::State::EnqueuedForPath && villager.m_pathTicket == ticket;
+}
+
+void DesirePathSim::applyPathCompletion(PathCompletion& completion)
+{
+   if (isPathRequestCurrent(completion.villager, completion.ticket) == false)
+      return; // Outdated
+
+   const std::size_t villagerIndex = completion.villager.index;
+   const auto& villager = m_villagerStore.villager(villagerIndex);
+
+   m_villagerStore.setPath(villagerIndex, std::move(completion.path));
+
+   if (villager.getState() == Villager::State::AwaitingPath)
+   {
+      requestPath(villagerIndex); // No path found, try another pair of entrances
+   }
+   else if (m_options.eventDrivenMovement)
+   {
+      m_movementWheel.schedule(villagerIndex, 0); // Start moving with the next tick
+   }
+}
+
+void DesirePathSim::rerouteVillagers()
+{
+   for (std::size_t villagerIndex = 0; villagerIndex < m_villagerStore.size(); ++villagerIndex)
+   {
+      if (m_villagerStore.isAlive(villagerIndex) == false)
+         continue;
+
+      const auto& villager = m_villagerStore.villager(villagerIndex);
+
+      if (villager.getState() == Villager::State::EnqueuedForPath)
+      {
+         m_pathfindingService.cancel(villager.m_pathTicket);
+      }
+
+      m_villagerStore.stop(villagerIndex);
+
+      requestPath(villagerIndex);
+   }
+}
+
+void DesirePathSim::publishRenderState(const UpdateRect& desirePathsUpdateRect, const int ticksPerSecond)
+{
+   auto& renderState = m_renderStates.writeBuffer();
+
+   // Every block fills the entries from the start of its own index range, which only have to be moved together if
+   // villagers were despawned
+   const auto villagerCount = m_villagerStore.size();
+   const auto blockCount = (villagerCount + m_tickBlockVillagerCount - 1) / m_tickBlockVillagerCount;
+
+   renderState.villagers.resize(villagerCount);
+
+   m_tickWorkerPool.run(blockCount, [&] (const std::size_t blockIndex)
+   {
+      const auto beginIndex = blockIndex * m_tickBlockVillagerCount;
+      const auto endIndex = std::min(beginIndex + m_tickBlockVillagerCount, villagerCount);
+
+      auto renderVillager = std::begin(renderState.villagers) + beginIndex;
+
+      for (auto villagerIndex = beginIndex; villagerIndex < endIndex; ++villagerIndex)
+      {
+         if (m_villagerStore.isAlive(villagerIndex) == false)
+            continue;
+
+         if (m_options.eventDrivenMovement)
+         {
+            renderVillager->position = m_villagerStore.positionAt(villagerIndex, m_simulationTime);
+         }
+         else
+         {
+            renderVillager->position = {m_villagerStore.m_positionX[villagerIndex], m_villagerStore.m_positionY[villagerIndex]};
+         }
+
+         renderVillager->color = m_villagerStore.villager(villagerIndex).m_color;
+
+         ++renderVillager;
+      }
+
+      m_tickBlockEntryCounts[blockIndex] = static_cast<std::size_t>(renderVillager - std::begin(renderState.villagers)) - beginIndex;
+   });
+
+   if (m_villagerStore.aliveCount() != villagerCount)
+   {
+      auto renderVillagerEnd = std::begin(renderState.villagers);
+
+      for (std::size_t blockIndex = 0; blockIndex < blockCount; ++blockIndex)
+      {
+         const auto blockRenderVillagers = std::begin(renderState.villagers) + blockIndex * m_tickBlockVillagerCount;
+
+         renderVillagerEnd = std::copy(blockRenderVillagers, blockRenderVillagers + m_tickBlockEntryCounts[blockIndex], renderVillagerEnd);
+      }
+
+      renderState.villagers.erase(renderVillagerEnd, std::end(renderState.villagers));
+   }
+
+   renderState.desirePathsUpdateRect = desirePathsUpdateRect;
+
+   renderState.desirePathsCopyRect.left   = (desirePathsUpdateRect.left > 0) ? desirePathsUpdateRect.left - 1 : 0;
+   renderState.desirePathsCopyRect.top    = (desirePathsUpdateRect.top  > 0) ? desirePathsUpdateRect.top  - 1 : 0;
+   renderState.desirePathsCopyRect.right  = std::min(desirePathsUpdateRect.right  + 1, m_desirePathsMap.width () - 1);
+   renderState.desirePathsCopyRect.bottom = std::min(desirePathsUpdateRect.bottom + 1, m_desirePathsMap.height() - 1);
+
+   const auto& copyRect = renderState.desirePathsCopyRect;
+
+   renderState.desirePathsCopy.resize(copyRect.width() * copyRect.height());
+
+   m_desirePathsMap.forEachInRect(copyRect.left, copyRect.top, copyRect.right + 1, copyRect.bottom + 1, [&] (const std::size_t worldTileX, const std::size_t worldTileY, const std::uint8_t stress)
+   {
+      renderState.desirePathsCopy[(worldTileY - copyRect.top) * copyRect.width() + (worldTileX - copyRect.left)] = stress;
+   });
+
+   renderState.ticksPerSecond = ticksPerSecond;
+
+   renderState.desirePathsChangePerMille = m_convergenceMonitor.windowFull() ? m_convergenceMonitor.changePerMille() : -1;
+   renderState.desirePathsConverged = m_convergenceMonitor.converged();
+
+   m_renderStates.publish();
+}
+
+void DesirePathSim::updateCamera(const float delta)
+{
+   auto cameraSpeed = 400.0f;
+
+   if (IsKeyDown(KEY_RIGHT_SHIFT))
+      cameraSpeed *= 2.0;
+
+   if (IsKeyDown(KEY_LEFT))
+      m_camera.target.x -= cameraSpeed * delta;
+   else if (IsKeyDown(KEY_RIGHT))
+      m_camera.target.x += cameraSpeed * delta;
+
+   if (IsKeyDown(KEY_UP))
+      m_camera.target.y -= cameraSpeed * delta;
+   else if (IsKeyDown(KEY_DOWN))
+      m_camera.target.y += cameraSpeed * delta;
+}
+
+void DesirePathSim::drawVoronoiMap()
+{
+   for (std::size_t voronoiY = 0; voronoiY < m_voronoiMap.height(); ++voronoiY)
+   {
+      for (std::size_t voronoiX = 0; voronoiX < m_voronoiMap.width(); ++voronoiX)
+      {
+         Vector2 tilePos{static_cast<float>(voronoiX * m_tileWidthPixels), static_cast<float>(voronoiY * m_tileHeightPixels)};
+
+         DrawRectangleV(tilePos, {static_cast<float>(m_tileWidthPixels), static_cast<float>(m_tileHeightPixels)}, m_voronoiColorTable.at(m_voronoiMap.at(voronoiX, voronoiY)));
+      }
+   }
+}
+
+void DesirePathSim::updateWorldMapTexture(RenderTexture2D& texture, const WorldMapView& worldMap, const std::vector<std::pair<std::size_t, std::size_t>>& changedTiles)
+{
+   BeginTextureMode(texture);
+
+   for (const auto& [worldTileX, worldTileY] : changedTiles)
+   {
+      drawWorldMapTile(worldMap, worldTileX, worldTileY);
+   }
+
+   EndTextureMode();
+}
+
+void DesirePathSim::updateWorldMapTexture(RenderTexture2D& texture, const WorldMapView& worldMap)
+{
+   BeginTextureMode(texture);
+
+   for (std::size_t worldTileY = 0; worldTileY < worldMap.height(); ++worldTileY)
+   {
+      for (std::size_t worldTileX = 0; worldTileX < worldMap.width(); ++worldTileX)
+      {
+         drawWorldMapTile(worldMap, worldTileX, worldTileY);
+      }
+   }
+
+   EndTextureMode();
+}
+
+void DesirePathSim::drawWorldMapTile(const WorldMapView& worldMap, const std::size_t worldTileX, const std::size_t worldTileY)
+{
+   // Keyed by tile, so redrawing a tile keeps its look
+   CounterRNG tileRNG{m_seed, RNGSubsystem::Rendering, worldTileY * worldMap.width() + worldTileX};
+
+   std::uniform_int_distribution<> rngPercent{1, 100};
+
+   Vector2 tilePos{static_cast<float>(worldTileX * m_tileWidthPixels), static_cast<float>(worldTileY * m_tileHeightPixels)};
+
+   Color color{0, 0, 0, 255};
+
+   if (worldMap.at(worldTileX, worldTileY) == TileType::Water)
+   {
+      if (worldTileY % 3 == 1)
+      {
+         color = (worldTileX % 3 == 0) ? Color{60, 170, 255, 255} : Color{20, 130, 230, 255};
+      }
+      else if (worldTileY % 3 == 0)
+      {
+         color = (worldTileX % 3 > 0) ? Color{60, 170, 255, 255} : Color{20, 130, 230, 255};
+      }
+      else
+      {
+         color = Color{20, 130, 230, 255};
+      }
+
+      // Bevel
+      if (worldTileX > 0 && worldMap.at(worldTileX - 1, worldTileY) != TileType::Water)
+      {
+         color.r -= 20;
+         color.g -= 20;
+         color.b -= 20;
+      }
+      else if (worldTileY > 0 && worldMap.at(worldTileX, worldTileY - 1) != TileType::Water)
+      {
+         color.r -= 20;
+         color.g -= 20;
+         color.b -= 20;
+      }
+   }
+   else if (worldMap.at(worldTileX, worldTileY) == TileType::Tree)
+   {
+      color = (worldTileX + worldTileY) % 2 ? Color{90, 180, 40, 255} : Color{70, 160, 20, 255};
+
+      // Bevel
+      if (worldTileX < worldMap.width() - 1 && worldMap.at(worldTileX + 1, worldTileY) != TileType::Tree)
+      {
+         color.r -= 20;
+         color.g -= 20;
+         color.b -= 20;
+      }
+      else if (worldTileY < worldMap.height() - 1 && worldMap.at(worldTileX, worldTileY + 1) != TileType::Tree)
+      {
+         color.r -= 20;
+         color.g -= 20;
+         color.b -= 20;
+      }
+   }
+   else if (worldMap.at(worldTileX, worldTileY) == TileType::BuildingEntrance)
+   {
+      if (rngPercent(tileRNG) <= 90)
+      {
+         color = Color{150, 150, 150, 255};
+      }
+      else
+      {
+         color = Color{130, 130, 130, 255};
+      }
+   }
+   else if (worldMap.at(worldTileX, worldTileY) == TileType::Building)
+   {
+      color = worldTileX % 2 ? Color{230, 130, 80, 255} : Color{210, 110, 60, 255};
+
+      // Bevel
+      if (worldTileX > 0 && worldMap.at(worldTileX - 1, worldTileY) != TileType::Building)
+      {
+         color.r += 20;
+         color.g += 20;
+         color.b += 20;
+      }
+      else if (worldTileY > 0 && worldMap.at(worldTileX, worldTileY - 1) != TileType::Building)
+      {
+         color.r += 20;
+         color.g += 20;
+         color.b += 20;
+      }
+      else if (worldTileX < worldMap.width() - 1 && worldMap.at(worldTileX + 1, worldTileY) != TileType::Building)
+      {
+         color.r -= 20;
+         color.g -= 20;
+         color.b -= 20;
+      }
+      else if (worldTileY < worldMap.height() - 1 && worldMap.at(worldTileX, worldTileY + 1) != TileType::Building)
+      {
+         color.r -= 20;
+         color.g -= 20;
+         color.b -= 20;
+      }
+   }
+   else if (worldMap.at(worldTileX, worldTileY) == TileType::Street)
+   {
+      if (rngPercent(tileRNG) <= 90)
+      {
+         color = Color{150, 150, 150, 255};
+      }
+      else
+      {
+         color = Color{130, 130, 130, 255};
+      }
+   }
+   else if(worldMap.at(worldTileX, worldTileY) == TileType::Grass)
+   {
+      if (rngPercent(tileRNG) <= 20)
+      {
+         color = Color{110, 200, 60, 255};
+      }
+      else
+      {
+         color = Color{130, 220, 80, 255};
+      }
+   }
+
+   DrawRectangleV(tilePos, {static_cast<float>(m_tileWidthPixels), static_cast<float>(m_tileHeightPixels)}, color);
+}
+
+void DesirePathSim::updateShadowMapTexture(RenderTexture2D& texture, const PackedBitmap& shadowBitmap)
+{
+   BeginTextureMode(texture);
+
+   for (std::size_t worldTileY = 0; worldTileY < shadowBitmap.height(); ++worldTileY)
+   {
+      for (std::size_t worldTileX = 0; worldTileX < shadowBitmap.width(); ++worldTileX)
+      {
+         Vector2 tilePos{static_cast<float>(worldTileX * m_tileWidthPixels), static_cast<float>(worldTileY * m_tileHeightPixels)};
+
+         Color color{0, 0, 0, 0};
+
+         if (shadowBitmap.at(worldTileX, worldTileY) == 1) // Shadow
+         {
+            color = Color{0, 0, 0, 150};
+         }
+
+         DrawRectangleV(tilePos, {static_cast<float>(m_tileWidthPixels), static_cast<float>(m_tileHeightPixels)}, color);
+      }
+   }
+
+   EndTextureMode();
+}
+
+void DesirePathSim::updateDesirePathsMapTexture(RenderTexture2D& texture, const RenderState& renderState)
+{
+   const auto& updateRect = renderState.desirePathsUpdateRect;
+
+   BeginTextureMode(texture);
+
+   const Vector2 updateRectPos  = {static_cast<float>(updateRect.left    * m_tileWidthPixels), static_cast<float>(updateRect.top      * m_tileHeightPixels)};
+   const Vector2 updateRectSize = {static_cast<float>(updateRect.width() * m_tileWidthPixels), static_cast<float>(updateRect.height() * m_tileHeightPixels)};
+
+   //                SRC_ALPHA, SRC_ALPHA,    MIN
+   rlSetBlendFactors(   0x0302,    0x0302, 0x8007); // Clear
+   rlSetBlendMode(BLEND_CUSTOM);
+   DrawRectangleV(updateRectPos, updateRectSize, {0, 0, 0, 0});
+   rlSetBlendMode(BLEND_ALPHA);
+
+   // The copy has a border of one tile around the update rect unless the update rect touches the edge of the map, so
+   // neighbours within the copy are exactly the neighbours within the map
+   const auto desirePaths = renderState.desirePathsCopyView();
+   const auto& copyRect = renderState.desirePathsCopyRect;
+
+   for (std::size_t worldTileY = updateRect.top; worldTileY <= updateRect.bottom; ++worldTileY)
+   {
+      const auto copyY = worldTileY - copyRect.top;
+
+      const auto* row      = desirePaths.row(copyY);
+      const auto* rowAbove = (copyY > 0                       ) ? desirePaths.row(copyY - 1) : nullptr;
+      const auto* rowBelow = (copyY < desirePaths.height() - 1) ? desirePaths.row(copyY + 1) : nullptr;
+
+      for (std::size_t worldTileX = updateRect.left; worldTileX <= updateRect.right; ++worldTileX)
+      {
+         const auto copyX = worldTileX - copyRect.left;
+
+         const Vector2 tilePos{static_cast<float>(worldTileX * m_tileWidthPixels), static_cast<float>(worldTileY * m_tileHeightPixels)};
+
+         const int selfAlpha = row[copyX];
+
+         int neighborAlphaSum = 0;
+
+         if (copyX > 0                      ) neighborAlphaSum += row[copyX - 1];
+         if (copyX < desirePaths.width() - 1) neighborAlphaSum += row[copyX + 1];
+         if (rowAbove != nullptr            ) neighborAlphaSum += rowAbove[copyX];
+         if (rowBelow != nullptr            ) neighborAlphaSum += rowBelow[copyX];
+
+         const auto finalAlpha = static_cast<unsigned char>(std::max(selfAlpha, neighborAlphaSum / 4)); // Could be less than 4 neighbors but let's not care too much about map edges
+
+         const auto color = Color{90, 80, 50, finalAlpha};
+
+         DrawRectangleV(tilePos, {static_cast<float>(m_tileWidthPixels), static_cast<float>(m_tileHeightPixels)}, color);
+      }
+   }
+
+   EndTextureMode();
+}
+
+void DesirePathSim::updateBaseCostMap()
+{
+   // Both layers have the same chunks, so visiting the cost map chunk by chunk reads the world map chunk by chunk too
+   m_baseCostMap.forEachInRect(0, 0, m_baseCostMap.width(), m_baseCostMap.height(), [&] (const std::size_t x, const std::size_t y, std::uint8_t& baseCost)
+   {
+      CounterRNG tileRNG{m_seed, RNGSubsystem::BaseCost, y * m_worldMap.width() + x};
+
+      baseCost = getBaseCostForValue(m_worldMap.at(x, y), tileRNG);
+   });
+}
+
+void DesirePathSim::recordOccupancyChange(const std::uint32_t tileIndex)
+{
+   if (m_options.congestionCost == 0 || tileIndex == VillagerStore::m_noTile)
+      return;
+
+   if (m_occupancyChangedTiles.size() == m_occupancyChangedTiles.capacity())
+   {
+      m_occupancyChangesOverflowed = true;
+
+      return;
+   }
+
+   m_occupancyChangedTiles.emplace_back(tileIndex);
+}
+
+void DesirePathSim::updateCongestionCostMap()
+{
+   // Counts neighbouring tiles as well, so a crowd makes the whole stretch of street around it more expensive rather
+   // than single tiles that paths could squeeze around
+   static constexpr std::size_t congestionRadiusTiles = 1;
+
+   const auto& occupancy = m_villagerStore.occupancy();
+
+   auto updateCongestionCost = [&] (const std::size_t x, const std::size_t y, std::uint8_t& currentCongestionCost)
+   {
+      const auto congestionCost = std::min<std::uint64_t>(static_cast<std::uint64_t>(m_options.congestionCost) * occupancy.countAround(x, y, congestionRadiusTiles), 255);
+
+      if (currentCongestionCost != congestionCost)
+      {
+         currentCongestionCost = static_cast<std::uint8_t>(congestionCost);
+
+         m_congestionDirtyChunks.add(x, y);
+      }
+   };
+
+   if (m_occupancyChangesOverflowed)
+   {
+      m_congestionCostMap.forEachInRect(0, 0, m_congestionCostMap.width(), m_congestionCostMap.height(), updateCongestionCost);
+   }
+   else
+   {
+      const auto width = m_congestionCostMap.width();
+      const auto height = m_congestionCostMap.height();
+
+      std::sort(std::begin(m_occupancyChangedTiles), std::end(m_occupancyChangedTiles));
+
+      const auto changedTilesEnd = std::unique(std::begin(m_occupancyChangedTiles), std::end(m_occupancyChangedTiles));
+
+      // Neighbourhoods of nearby tiles overlap, updating a tile twice just finds nothing to change the second time
+      for (auto changedTile = std::begin(m_occupancyChangedTiles); changedTile != changedTilesEnd; ++changedTile)
+      {
+         const std::size_t tileX = *changedTile % width;
+         const std::size_t tileY = *changedTile / width;
+
+         for (auto y = tileY - std::min(tileY, congestionRadiusTiles); y <= std::min(tileY + congestionRadiusTiles, height - 1); ++y)
+         {
+            for (auto x = tileX - std::min(tileX, congestionRadiusTiles); x <= std::min(tileX + congestionRadiusTiles, width - 1); ++x)
+            {
+               updateCongestionCost(x, y, m_congestionCostMap.at(x, y));
+            }
+         }
+      }
+   }
+
+   m_occupancyChangedTiles.clear();
+   m_occupancyChangesOverflowed = false;
+}
+
+void DesirePathSim::updateShadowBitmap(const std::size_t beginX, const std::size_t beginY, const std::size_t endX, const std::size_t endY)
+{
+   m_worldMap.forEachInRect(beginX, beginY, endX, endY, [&] (const std::size_t x, const std::size_t y, const TileType tileType)
+   {
+      m_shadowCasterBitmap.set(x, y, (tileType == TileType::Building || tileType == TileType::Tree) ? 1 : 0);
+   });
+
+   // Closed outline of the casters, moved one tile down and right, without the casters themselves
+   auto shadowPipeline = BitmapPipeline::mask(
+      BitmapPipeline::shift(BitmapPipeline::erode(BitmapPipeline::dilate(BitmapPipeline::source(m_shadowCasterBitmap), false), false), 1, 1, 0),
+      BitmapPipeline::source(m_shadowCasterBitmap));
+
+   BitmapPipeline::evaluate(shadowPipeline, m_shadowBitmap, beginX, beginY, endX, endY);
+}
+
+void DesirePathSim::publishWorldSnapshot()
+{
+   auto worldSnapshot = std::allocate_shared<WorldSnapshot>(PoolAllocator<WorldSnapshot>{m_tickPool});
+
+   if (m_buildingEntrances == nullptr)
+   {
+      auto buildingEntrances = std::make_shared<std::vector<std::uint64_t>>();
+
+      // Collected in mapping order, sorted by row-major index afterwards
+      m_worldMap.forEachInRect(0, 0, m_worldMap.width(), m_worldMap.height(), [&] (const std::size_t x, const std::size_t y, const TileType tileType)
+      {
+         if (tileType == TileType::BuildingEntrance)
+         {
+            buildingEntrances->emplace_back(static_cast<std::uint64_t>(y) * m_worldMap.width() + x);
+         }
+      });
+
+      std::sort(std::begin(*buildingEntrances), std::end(*buildingEntrances));
+
+      m_buildingEntrances = std::move(buildingEntrances);
+   }
+
+   worldSnapshot->tickIndex = m_tickIndex;
+   worldSnapshot->buildingEntrances = m_buildingEntrances;
+
+   worldSnapshot->worldMap          = m_worldMapSnapshot         .publish(m_worldMap         , m_worldDirtyChunks     );
+   worldSnapshot->baseCostMap       = m_baseCostMapSnapshot      .publish(m_baseCostMap      , m_worldDirtyChunks     );
+   worldSnapshot->congestionCostMap = m_congestionCostMapSnapshot.publish(m_congestionCostMap, m_congestionDirtyChunks);
+
+   if (m_options.packedTileRecords)
+   {
+      m_tileRecordDirtyChunks = m_worldDirtyChunks;
+      m_tileRecordDirtyChunks.add(m_congestionDirtyChunks);
+
+      worldSnapshot->tileRecords = m_tileRecordSnapshot.publish(m_worldMap.width(), m_worldMap.height(), m_tileRecordDirtyChunks, [&] (const std::size_t x, const std::size_t y)
+      {
+         return makeTileRecord(m_worldMap.at(x, y), m_baseCostMap.at(x, y), m_congestionCostMap.at(x, y));
+      });
+   }
+
+   std::atomic_store(&m_worldSnapshot, std::shared_ptr<const WorldSnapshot>{std::move(worldSnapshot)});
+
+   m_worldDirtyChunks.reset();
+   m_congestionDirtyChunks.reset();
+}
+
+void DesirePathSim::reserveWorldSnapshots()
+{
+   const auto chunkCount = m_reservedSnapshotMapCount * m_worldDirtyChunks.widthChunks() * m_worldDirtyChunks.heightChunks();
+
+   m_worldMapSnapshot         .reserve(m_reservedSnapshotVersionCount, chunkCount);
+   m_baseCostMapSnapshot      .reserve(m_reservedSnapshotVersionCount, chunkCount);
+   m_congestionCostMapSnapshot.reserve(m_reservedSnapshotVersionCount, chunkCount);
+
+   if (m_options.packedTileRecords)
+   {
+      m_tileRecordSnapshot.reserve(m_reservedSnapshotVersionCount, chunkCount);
+   }
+
+   // Allocated and released again, like the chunks
+   std::vector<std::shared_ptr<WorldSnapshot>> worldSnapshots;
+
+   worldSnapshots.reserve(m_reservedSnapshotVersionCount);
+
+   for (std::size_t versionIndex = 0; versionIndex < m_reservedSnapshotVersionCount; ++versionIndex)
+   {
+      worldSnapshots.emplace_back(std::allocate_shared<WorldSnapshot>(PoolAllocator<WorldSnapshot>{m_tickPool}));
+   }
 }
@@ -4,6 +4,11 @@
 #include <vector>
 #include <atomic>
 #include <random>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <deque>
+#include <unordered_map>
 
 #include <raylib.h>
 
@@ -12,9 +17,18 @@
 #include "WorldMap.hpp"
 #include "DesirePaths.hpp"
 #include "Bitmap.hpp"
-#include "Villager.hpp"
+#include "BitmapPipeline.hpp"
+#include "VillagerStore.hpp"
 #include "UpdateRect.hpp"
-#include "Queue.hpp"
+#include "WorldSnapshot.hpp"
+#include "WorkerPool.hpp"
+#include "TripleBuffer.hpp"
+#include "RenderState.hpp"
+#include "CounterRNG.hpp"
+#include "TimingWheel.hpp"
+#include "ConvergenceMonitor.hpp"
+#include "PathfindingService.hpp"
+#include "BlockPool.hpp"
 
 class DesirePathSim final
 {
@@ -46,7 +60,30 @@ private:
    int m_worldWidthPixels;
    int m_worldHeightPixels;
 
-   std::mt19937_64 m_baseRNG;
+   // Every random number is drawn from a CounterRNG keyed by this seed, so the same seed gives the same results
+   std::uint64_t m_seed;
+
+   // Number of simulation ticks so far, keys the villager tick random streams
+   std::uint64_t m_tickIndex = 0;
+
+   // Simulated seconds so far
+   double m_simulationTime = 0.0;
+
+   // Number of street tiles right after world generation, everything beyond that has been paved by villagers
+   std::size_t m_generatedStreetTileCount = 0;
+
+   // Simulated seconds since desire paths were last decayed
+   float m_desirePathDecayAccu = 0.0f;
+
+   // Tiles paved by villagers so far
+   std::uint64_t m_pavedTileCount = 0;
+
+   // Real time spent moving villagers and finding the ones due for a tick, reported by headless runs
+   double m_villagerScanSec = 0.0;
+
+   // Sampled once per simulated second
+   ConvergenceMonitor m_convergenceMonitor;
+   float m_convergenceSampleAccu = 0.0f;
 
    // For each world tile, stores the index of the closest Centroid
    VoronoiMap m_voronoiMap;
@@ -59,9 +96,54 @@ private:
 
    DesirePathsMap m_desirePathsMap;
 
-   Bitmap m_shadowBitmap;
+   // Buildings and trees, the shadow bitmap is derived from it
+   PackedBitmap m_shadowCasterBitmap;
+   PackedBitmap m_shadowBitmap;
+
+   // Traversal cost added for villagers on and around a tile, only updated if the congestion cost option is set
+   CostMap m_congestionCostMap;
+
+   // The congestion cost map is only updated every few ticks, so paths are not searched on a map that changes under
+   // them with every step
+   static constexpr std::uint64_t m_congestionUpdateIntervalTicks = 30;
+
+   // Tiles whose villager count changed since the last congestion update, may contain duplicates. Only these tiles and
+   // their neighbours are updated. Reserved for two per villager, if more tiles change than that, the next update goes
+   // over the whole map instead.
+   std::vector<std::uint32_t> m_occupancyChangedTiles;
+   bool m_occupancyChangesOverflowed = false;
+
+   // Chunks of m_worldMap and m_baseCostMap changed since the last published snapshot
+   DirtyChunkMask m_worldDirtyChunks;
+
+   // Chunks of m_congestionCostMap changed since the last published snapshot
+   DirtyChunkMask m_congestionDirtyChunks;
+
+   ChunkedSnapshot<TileType> m_worldMapSnapshot;
+   ChunkedSnapshot<std::uint8_t> m_baseCostMapSnapshot;
+   ChunkedSnapshot<std::uint8_t> m_congestionCostMapSnapshot;
+
+   // Only used with packed tile records, made from the three layers above. The dirty chunk mask is the union of the
+   // masks of those layers, kept as a member to reuse its storage.
+   ChunkedSnapshot<TileRecord> m_tileRecordSnapshot;
+   DirtyChunkMask m_tileRecordDirtyChunks;
+
+   // Shared by all snapshots, collected once world generation is done
+   std::shared_ptr<const std::vector<std::uint64_t>> m_buildingEntrances;
 
-   std::vector<Villager> m_villagers;
+   // Latest published snapshot, pathfinding threads must only access it using std::atomic_load
+   std::shared_ptr<const WorldSnapshot> m_worldSnapshot;
+
+   // Path requests keep the snapshot they were made on alive until they are done. At startup, the pools of all layers
+   // are filled with the tables of this many versions besides the current one, and with the chunks of
+   // m_reservedSnapshotMapCount whole maps.
+   static constexpr std::size_t m_reservedSnapshotVersionCount = 64;
+   static constexpr std::size_t m_reservedSnapshotMapCount = 2;
+
+   // For objects the tick makes and destroys over and over, like world snapshots and the deterministic path bookkeeping
+   std::shared_ptr<BlockPool> m_tickPool = std::make_shared<BlockPool>();
+
+   VillagerStore m_villagerStore;
 
    Camera2D m_camera = {0};
 
@@ -69,27 +151,155 @@ private:
    RenderTexture2D m_shadowMapTexture = {};
    RenderTexture2D m_desirePathsMapTexture = {};
 
-   // Villagers waiting for new path are enqueued here
-   Queue<Villager*> m_pathfindingQueue;
-   std::atomic<bool> m_stopPathfindingThread;
+   WorkerPool m_tickWorkerPool;
+
+   struct TickTaskOutput final
+   {
+      std::vector<DesirePathStressDelta> stressDeltas;
+   };
+
+   // Villagers are first moved in blocks of m_tickBlockVillagerCount, then all villagers that reached a tile are
+   // ticked in spatial regions the size of a dirty chunk. Per tick, villager indices are sorted by region and every
+   // task takes a run of neighbouring regions. Each task collects its own output, which is then applied in task order,
+   // and so in region order.
+   static constexpr std::size_t m_tickBlockVillagerCount = 4096;
+
+   // Due villagers per task when ticking regions in parallel, at least
+   static constexpr std::size_t m_tickTaskMinVillagerCount = 512;
+
+   std::vector<std::size_t> m_tickRegionOffsets;
+   std::vector<std::size_t> m_tickRegionNextSlots;
+   std::vector<std::size_t> m_tickRegionVillagerIndices;
+
+   // One per thread of m_tickWorkerPool, each reserved for a stress delta from every villager
+   std::vector<TickTaskOutput> m_tickTaskOutputs;
+
+   // Number of entries each block wrote, from the start of its own range of villager indices. Blocks find their due
+   // villagers in m_tickRegionVillagerIndices before it is used for the regions, and the render state is filled the
+   // same way, so no serial pass over all villagers is left.
+   std::vector<std::size_t> m_tickBlockEntryCounts;
+
+   // Villagers to be ticked in the current tick, in index order
+   std::vector<std::size_t> m_dueVillagerIndices;
+
+   // Tile each due villager occupied before the tick, only kept while the congestion cost is tracked
+   std::vector<std::uint32_t> m_dueVillagerTiles;
+
+   // With villager LOD, only villagers within m_visibleWorldRect are moved every tick. Everyone else is caught up every
+   // m_lodTickInterval ticks, whole tiles at a time.
+   static constexpr std::size_t m_lodTickInterval = 8;
+
+   std::vector<std::uint8_t> m_villagerOnScreen;
+
+   // Set by the render thread from the camera, in world pixels. Without a camera, the whole world counts as visible.
+   std::mutex m_visibleWorldRectMutex;
+   Rectangle m_visibleWorldRect;
+
+   // With event-driven movement, every moving villager is scheduled here for the time it reaches its next tile
+   static constexpr double m_movementWheelTicksPerSec = 1000.0;
+   TimingWheel m_movementWheel;
+
+   PathfindingService m_pathfindingService;
+
+   // Paths finished since the last tick, reused to keep its capacity
+   std::vector<PathCompletion> m_pathCompletions;
+
+   // With deterministic simulation, every path is applied a fixed number of ticks after it was requested, in request
+   // order. Searches finished early are held back, for searches finished late the simulation waits.
+   static constexpr std::uint64_t m_deterministicPathLatencyTicks = 30;
+
+   struct ScheduledPathRequest final
+   {
+      std::uint64_t applyTick;
+      VillagerHandle villager;
+      PathTicket ticket;
+   };
+
+   using HeldPathCompletions = std::unordered_map<PathTicket, PathCompletion, std::hash<PathTicket>, std::equal_to<PathTicket>, PoolAllocator<std::pair<const PathTicket, PathCompletion>>>;
+
+   std::deque<ScheduledPathRequest, PoolAllocator<ScheduledPathRequest>> m_scheduledPathRequests;
+   HeldPathCompletions m_heldPathCompletions;
+
+   // Set by the render thread, makes the next tick drop all current paths and request new ones
+   std::atomic<bool> m_rerouteVillagersRequested = false;
+
+   // Villagers to spawn (positive) or despawn (negative) with the next tick, added to by the render thread
+   std::atomic<std::int64_t> m_requestedPopulationChange = 0;
+
+   static constexpr std::size_t m_populationChangeStep = 100;
+
+   // Fractional villagers to spawn from the spawn rate option
+   float m_villagerSpawnAccu = 0.0f;
+
+   std::uint64_t m_nextVillagerId = 0;
+
+   std::atomic<bool> m_stopSimulationThread;
+
+   // Handed over from the simulation thread to the render thread after every tick
+   TripleBuffer<RenderState> m_renderStates;
+
+   // Tiles changed by the simulation thread that the render thread has not redrawn yet
+   std::mutex m_changedTilesMutex;
+   std::vector<std::pair<std::size_t, std::size_t>> m_changedTiles;
 
 private:
-   void tickVillagers(UpdateRect& mapUpdateRect, const float delta);
+   // File in the layer directory to map the layer of the given name from, empty if layers are kept in memory
+   std::string getLayerFilePath(const std::string& layerName) const;
+
+   // Runs for the configured number of simulated seconds, then writes maps and stats to the output directory
+   void runHeadless();
+   void writeHeadlessOutput(const double elapsedSec, const double allocationsPerTick);
+
+   std::size_t countTiles(const TileType tileType) const;
+
+   void runSimulation(const std::vector<UpdateRect>& desirePathsUpdateRects);
+
+   // Advances the simulation by one fixed step of delta simulated seconds
+   void tickSimulation(std::vector<std::pair<std::size_t, std::size_t>>& changedTiles, const float delta);
+
+   void tickVillagers(std::vector<std::pair<std::size_t, std::size_t>>& changedTiles, const float delta);
+
+   static std::uint64_t toMovementWheelTick(const double time);
+
+   void spawnVillager();
+   void despawnVillager(const std::size_t villagerIndex);
+   void changePopulation(const float delta);
+
+   std::size_t getBytesPerVillager() const;
+
+   void requestPath(const std::size_t villagerIndex);
+   void applyPathCompletions();
+   void applyPathCompletion(PathCompletion& completion);
+   bool isPathRequestCurrent(const VillagerHandle villagerHandle, const PathTicket ticket) const;
+   void rerouteVillagers();
+
+   void publishRenderState(const UpdateRect& desirePathsUpdateRect, const int ticksPerSecond);
 
    void updateCamera(const float delta);
 
    void drawVoronoiMap();
 
-   void updateWorldMapTexture(RenderTexture2D& texture, UpdateRect& updateRect);
-   void updateWorldMapTexture(RenderTexture2D& texture);
+   void updateWorldMapTexture(RenderTexture2D& texture, const WorldMapView& worldMap, const std::vector<std::pair<std::size_t, std::size_t>>& changedTiles);
+   void updateWorldMapTexture(RenderTexture2D& texture, const WorldMapView& worldMap);
 
-   void updateShadowMapTexture(RenderTexture2D& texture, const Bitmap& shadowBitmap);
+   void drawWorldMapTile(const WorldMapView& worldMap, const std::size_t worldTileX, const std::size_t worldTileY);
 
-   void updateDesirePathsMapTexture(RenderTexture2D& texture, const UpdateRect& updateRect);
-   void updateDesirePathsMapTexture(RenderTexture2D& texture);
+   void updateShadowMapTexture(RenderTexture2D& texture, const PackedBitmap& shadowBitmap);
+
+   void updateDesirePathsMapTexture(RenderTexture2D& texture, const RenderState& renderState);
 
    void updateBaseCostMap();
-   void updateShadowBitmap();
+
+   // Remembers a tile for the next congestion update, if the congestion cost is tracked
+   void recordOccupancyChange(const std::uint32_t tileIndex);
+
+   void updateCongestionCostMap();
+
+   // Updates the shadow casters in [beginX, endX) x [beginY, endY) and every shadow tile that depends on them
+   void updateShadowBitmap(const std::size_t beginX, const std::size_t beginY, const std::size_t endX, const std::size_t endY);
+
+   void publishWorldSnapshot();
+   void reserveWorldSnapshots();
 };
 
 #endif // DESIREPATHSIM_HPP
@@ -1,32 +1,338 @@
 #include "DesirePaths.hpp"
 
 #include <algorithm>
+#include <vector>
+#include <array>
+#include <limits>
+#include <cassert>
 
-std::uint8_t adjustDesirePathStress(const std::size_t tileX, const std::size_t tileY, DesirePathsMap& desirePathsMap, CostMap& baseCostMap, const int adjustment)
+DesirePathsMap::DesirePathsMap(const std::size_t width, const std::size_t height, const std::string& filePath):
+   m_width{width},
+   m_height{height},
+   m_tiles{width, height, Tile{}, filePath, MappedDensity::Sparse} // Only tiles people walked on are ever written
 {
-   const auto valueBefore = desirePathsMap.at(tileX, tileY);
-   const auto valueAfter = static_cast<std::uint8_t>(std::clamp(valueBefore + adjustment, 0, 255));
+   assert(width * height < std::numeric_limits<std::uint32_t>::max());
+}
+
+std::pair<std::uint8_t /*before*/, std::uint8_t /*after*/> DesirePathsMap::adjust(const std::size_t x, const std::size_t y, const int adjustment)
+{
+   const auto tileIndex = y * m_width + x;
+
+   const auto stressBefore = at(x, y);
+   const auto stressAfter = static_cast<std::uint8_t>(std::clamp(stressBefore + adjustment, 0, 255));
+
+   settle(tileIndex, stressAfter);
+
+   return {stressBefore, stressAfter};
+}
+
+void DesirePathsMap::clear(const std::size_t x, const std::size_t y)
+{
+   settle(y * m_width + x, 0);
+}
+
+Map<std::uint8_t> DesirePathsMap::toMap() const
+{
+   Map<std::uint8_t> map{m_width, m_height, 0};
+
+   forEachInRect(0, 0, m_width, m_height, [&] (const std::size_t x, const std::size_t y, const std::uint8_t stress)
+   {
+      map.at(x, y) = stress;
+   });
+
+   return map;
+}
+
+void DesirePathsMap::settle(const std::size_t tileIndex, const std::uint8_t stress)
+{
+   auto& tile = m_tiles.at(tileIndex % m_width, tileIndex / m_width);
+
+   // Tiles are visited no later than the decay step their cost step changes at, so the settled stress still has the
+   // cost step the sum was last updated with
+   m_costStepSum += stress / m_stressPerCostStep - tile.stress / m_stressPerCostStep;
+
+   // The same goes for running out of stress, so a tile that had stress still has it as of its last write
+   if ((tile.stress == 0) != (stress == 0))
+   {
+      m_activeTileCount = (stress == 0) ? m_activeTileCount - 1 : m_activeTileCount + 1;
+   }
+
+   tile.stress = stress;
+   tile.settledStep = m_decayStep;
+
+   // Tiles scheduled for a later step are in that step's bucket
+   const bool isScheduled = (tile.scheduledStep > m_decayStep);
+
+   if (stress == 0)
+   {
+      if (isScheduled)
+      {
+         unlinkFromBucket(tile);
+      }
+
+      tile.scheduledStep = 0;
+
+      return;
+   }
+
+   // Decay steps until the cost step changes, or until the stress runs out if it is too low to affect the cost
+   const auto stepsUntilVisit = (stress >= m_stressPerCostStep) ? (stress % m_stressPerCostStep + 1) : stress;
+
+   const auto visitStep = m_decayStep + static_cast<std::uint32_t>(stepsUntilVisit);
+
+   // Visiting earlier than needed is fine, the tile is simply rescheduled then
+   if (isScheduled && tile.scheduledStep <= visitStep)
+      return;
+
+   if (isScheduled)
+   {
+      unlinkFromBucket(tile);
+   }
+
+   tile.scheduledStep = visitStep;
+
+   linkIntoBucket(static_cast<std::uint32_t>(tileIndex + 1), tile);
+}
 
-   if (valueBefore != valueAfter)
+void DesirePathsMap::linkIntoBucket(const std::uint32_t link, Tile& tile)
+{
+   auto& head = m_bucketHeads[tile.scheduledStep & m_bucketMask];
+
+   tile.previousLink = m_noLink;
+   tile.nextLink = head;
+
+   if (head != m_noLink)
    {
-      desirePathsMap.at(tileX, tileY) = valueAfter;
+      tileAt(head).previousLink = link;
+   }
 
-      const auto baseCostAdjustmentBefore = -(valueBefore / 64);
-      const auto baseCostAdjustmentAfter  = -(valueAfter  / 64);
+   head = link;
+}
 
+void DesirePathsMap::unlinkFromBucket(Tile& tile)
+{
+   if (tile.previousLink != m_noLink)
+   {
+      tileAt(tile.previousLink).nextLink = tile.nextLink;
+   }
+   else
+   {
+      m_bucketHeads[tile.scheduledStep & m_bucketMask] = tile.nextLink;
+   }
+
+   if (tile.nextLink != m_noLink)
+   {
+      tileAt(tile.nextLink).previousLink = tile.previousLink;
+   }
+
+   tile.previousLink = m_noLink;
+   tile.nextLink = m_noLink;
+}
+
+std::uint32_t DesirePathsMap::sortByOffset(const std::uint32_t head)
+{
+   // Merge sort, which only needs the links already in the tiles. Previous links are left as they are, the list is
+   // taken apart tile by tile right after.
+   if (head == m_noLink || tileAt(head).nextLink == m_noLink)
+      return head;
+
+   // Split in halves
+   auto middle = head;
+
+   for (auto link = tileAt(head).nextLink; link != m_noLink && tileAt(link).nextLink != m_noLink; link = tileAt(tileAt(link).nextLink).nextLink)
+   {
+      middle = tileAt(middle).nextLink;
+   }
+
+   auto secondHead = tileAt(middle).nextLink;
+
+   tileAt(middle).nextLink = m_noLink;
+
+   auto firstLink = sortByOffset(head);
+   auto secondLink = sortByOffset(secondHead);
+
+   const auto& tileStorage = m_tiles.storage();
+
+   auto offsetOf = [&] (const std::uint32_t link)
+   {
+      return tileStorage.offsetOf((link - 1) % m_width, (link - 1) / m_width);
+   };
+
+   std::uint32_t sortedHead = m_noLink;
+   std::uint32_t* sortedTail = &sortedHead;
+
+   while (firstLink != m_noLink && secondLink != m_noLink)
+   {
+      auto& nextLink = (offsetOf(firstLink) < offsetOf(secondLink)) ? firstLink : secondLink;
+
+      *sortedTail = nextLink;
+      sortedTail = &tileAt(nextLink).nextLink;
+
+      nextLink = *sortedTail;
+   }
+
+   *sortedTail = (firstLink != m_noLink) ? firstLink : secondLink;
+
+   return sortedHead;
+}
+
+static void adjustBaseCost(const std::size_t tileX, const std::size_t tileY, const std::uint8_t stressBefore, const std::uint8_t stressAfter, CostMap& baseCostMap, DirtyChunkMask& baseCostDirtyChunks)
+{
+   const auto baseCostAdjustmentBefore = -(stressBefore / DesirePathsMap::m_stressPerCostStep);
+   const auto baseCostAdjustmentAfter  = -(stressAfter  / DesirePathsMap::m_stressPerCostStep);
+
+   if (baseCostAdjustmentBefore != baseCostAdjustmentAfter)
+   {
       baseCostMap.at(tileX, tileY) = baseCostMap.at(tileX, tileY) - baseCostAdjustmentBefore + baseCostAdjustmentAfter;
+
+      baseCostDirtyChunks.add(tileX, tileY);
    }
+}
+
+std::uint8_t adjustDesirePathStress(const std::size_t tileX, const std::size_t tileY, DesirePathsMap& desirePathsMap, CostMap& baseCostMap, DirtyChunkMask& baseCostDirtyChunks, const int adjustment)
+{
+   const auto [stressBefore, stressAfter] = desirePathsMap.adjust(tileX, tileY, adjustment);
 
-   return valueAfter;
+   adjustBaseCost(tileX, tileY, stressBefore, stressAfter, baseCostMap, baseCostDirtyChunks);
+
+   return stressAfter;
 }
 
-void decayDesirePaths(DesirePathsMap& desirePathsMap, CostMap& baseCostMap)
+static void paveTile(
+   const std::size_t tileX,
+   const std::size_t tileY,
+   WorldMap& worldMap,
+   std::vector<std::pair<std::size_t, std::size_t>>& changedTiles,
+   DirtyChunkMask& worldDirtyChunks,
+   CostMap& baseCostMap,
+   DesirePathsMap& desirePathsMap,
+   const std::uint64_t seed
+)
 {
-   for (std::size_t worldTileY = 0; worldTileY < desirePathsMap.height(); ++worldTileY)
+   if (worldMap.at(tileX, tileY) != TileType::Street)
    {
-      for (std::size_t worldTileX = 0; worldTileX < desirePathsMap.width(); ++worldTileX)
+      worldMap.at(tileX, tileY) = TileType::Street;
+
+      CounterRNG rng{seed, RNGSubsystem::BaseCost, tileY * worldMap.width() + tileX};
+
+      baseCostMap.at(tileX, tileY) = getBaseCostForValue(TileType::Street, rng);
+
+      desirePathsMap.clear(tileX, tileY);
+
+      changedTiles.emplace_back(tileX, tileY);
+      worldDirtyChunks.add(tileX, tileY);
+   }
+}
+
+void applyDesirePathStressDelta(
+   const DesirePathStressDelta& stressDelta,
+   WorldMap& worldMap,
+   std::vector<std::pair<std::size_t, std::size_t>>& changedTiles,
+   DirtyChunkMask& worldDirtyChunks,
+   CostMap& baseCostMap,
+   DesirePathsMap& desirePathsMap,
+   const bool pavePaths,
+   const std::uint64_t seed
+)
+{
+   const auto tileX = stressDelta.tileX;
+   const auto tileY = stressDelta.tileY;
+
+   // Might have been paved since the delta was collected
+   if (worldMap.at(tileX, tileY) != TileType::Grass)
+      return;
+
+   const auto currentDesirePathTileStress = adjustDesirePathStress(tileX, tileY, desirePathsMap, baseCostMap, worldDirtyChunks, stressDelta.adjustment);
+
+   const auto shouldBePaved = pavePaths && (currentDesirePathTileStress == 255);
+
+   if (shouldBePaved == false)
+      return;
+
+   std::array<std::pair<std::size_t, std::size_t>, 8> neighbors;
+   std::size_t neighborCount = 0;
+
+   auto addNeighbor = [&] (const std::size_t x, const std::size_t y)
+   {
+      neighbors[neighborCount++] = std::make_pair(x, y);
+   };
+
+   if (tileY > 0)
+   {
+      addNeighbor(tileX, tileY - 1);
+
+      if (tileX > 0)
       {
-         adjustDesirePathStress(worldTileX, worldTileY, desirePathsMap, baseCostMap, -1);
+         addNeighbor(tileX - 1, tileY - 1);
+      }
+
+      if (tileX < worldMap.width() - 1)
+      {
+         addNeighbor(tileX + 1, tileY - 1);
+      }
+   }
+
+   if (tileX > 0)
+   {
+      addNeighbor(tileX - 1, tileY);
+   }
+
+   if (tileX < worldMap.width() - 1)
+   {
+      addNeighbor(tileX + 1, tileY);
+   }
+
+   if (tileY < worldMap.height() - 1)
+   {
+      addNeighbor(tileX, tileY + 1);
+
+      if (tileX > 0)
+      {
+         addNeighbor(tileX - 1, tileY + 1);
+      }
+
+      if (tileX < worldMap.width() - 1)
+      {
+         addNeighbor(tileX + 1, tileY + 1);
+      }
+   }
+
+   bool paved = false;
+
+   // Only pave if an adjacent tile is paved
+   for (std::size_t neighborIndex = 0; neighborIndex < neighborCount; ++neighborIndex)
+   {
+      const auto& neighbor = neighbors[neighborIndex];
+
+      const auto neighborValue = worldMap.at(neighbor.first, neighbor.second);
+
+      if (neighborValue == TileType::Street || neighborValue == TileType::BuildingEntrance)
+      {
+         paveTile(tileX, tileY, worldMap, changedTiles, worldDirtyChunks, baseCostMap, desirePathsMap, seed);
+         paved = true;
+         break;
       }
    }
+
+   // Pave neighboring grass
+   if (paved)
+   {
+      for (std::size_t neighborIndex = 0; neighborIndex < neighborCount; ++neighborIndex)
+      {
+         const auto& neighbor = neighbors[neighborIndex];
+
+         if (worldMap.at(neighbor.first, neighbor.second) == TileType::Grass)
+         {
+            paveTile(neighbor.first, neighbor.second, worldMap, changedTiles, worldDirtyChunks, baseCostMap, desirePathsMap, seed);
+         }
+      }
+   }
+}
+
+void decayDesirePaths(DesirePathsMap& desirePathsMap, CostMap& baseCostMap, DirtyChunkMask& baseCostDirtyChunks)
+{
+   desirePathsMap.decay([&] (const std::size_t tileX, const std::size_t tileY, const std::uint8_t stressBefore, const std::uint8_t stressAfter)
+   {
+      adjustBaseCost(tileX, tileY, stressBefore, stressAfter, baseCostMap, baseCostDirtyChunks);
+   });
 }
@@ -2,14 +2,231 @@
 #define DESIREPATHS_HPP
 
 #include <cstdint>
+#include <vector>
+#include <array>
+#include <utility>
+#include <string>
+#include <algorithm>
+#include <cassert>
 
 #include "Map.hpp"
+#include "MappedStorage.hpp"
 #include "CostMap.hpp"
+#include "WorldMap.hpp"
+#include "ChunkedSnapshot.hpp"
+#include "CounterRNG.hpp"
 
-using DesirePathsMap = Map<std::uint8_t>;
+// Stress per tile. Decay is applied lazily: every tile remembers the decay step its stress was last written at, reading
+// a tile subtracts all decay steps since then. Only tiles whose stress crosses a multiple of m_stressPerCostStep or
+// drops to 0 need to be visited when decaying, they are kept in buckets by the decay step that happens at. A bucket is
+// a list linked through the tiles themselves, so scheduling a tile never allocates and every tile is in at most one
+// bucket. Tiles are kept in a MappedStorage and an untouched tile is all zero bytes, so only pages with tiles that ever
+// had stress take up memory, which grows with the area villagers have walked on rather than with the size of the world.
+class DesirePathsMap final
+{
+public:
+   // Every this much stress lowers the base cost of a tile by 1
+   static constexpr int m_stressPerCostStep = 64;
 
-std::uint8_t adjustDesirePathStress(const std::size_t tileX, const std::size_t tileY, DesirePathsMap& desirePathsMap, CostMap& baseCostMap, const int adjustment);
+   // Tiles are mapped from filePath if given, see MappedStorage
+   DesirePathsMap(const std::size_t width, const std::size_t height, const std::string& filePath = {});
 
-void decayDesirePaths(DesirePathsMap& desirePathsMap, CostMap& baseCostMap);
+   DesirePathsMap(const DesirePathsMap&) = default;
+   DesirePathsMap(DesirePathsMap&&) noexcept = default;
+
+   ~DesirePathsMap() = default;
+
+   DesirePathsMap& operator=(const DesirePathsMap&) = default;
+   DesirePathsMap& operator=(DesirePathsMap&&) noexcept = default;
+
+   std::size_t width() const;
+   std::size_t height() const;
+
+   // Current stress of a tile, with all decay applied
+   std::uint8_t at(const std::size_t x, const std::size_t y) const;
+
+   // Adds adjustment to the current stress of a tile, returns the stress before and after
+   std::pair<std::uint8_t /*before*/, std::uint8_t /*after*/> adjust(const std::size_t x, const std::size_t y, const int adjustment);
+
+   void clear(const std::size_t x, const std::size_t y);
+
+   // Lowers the stress of every tile by 1. onCostStepChanged(x, y, stressBefore, stressAfter) is called for every tile
+   // whose stress crossed a multiple of m_stressPerCostStep.
+   template<typename OnCostStepChanged>
+   void decay(OnCostStepChanged&& onCostStepChanged);
+
+   // Number of tiles with a stress above 0
+   std::size_t activeTileCount() const;
+
+   // Sum of stress / m_stressPerCostStep over all tiles, i.e. by how much desire paths lower the base costs in total
+   std::int64_t costStepSum() const;
+
+   // Calls f(x, y, stress) for every tile in [beginX, endX) x [beginY, endY), chunk by chunk
+   template<typename F>
+   void forEachInRect(const std::size_t beginX, const std::size_t beginY, const std::size_t endX, const std::size_t endY, F&& f) const;
+
+   // Materializes the current stress of all tiles
+   Map<std::uint8_t> toMap() const;
+
+private:
+   // Tiles are linked by their index plus 1, zero so that tiles that never had stress are all zero bytes
+   static constexpr std::uint32_t m_noLink = 0;
+
+   // Decay steps are scheduled at most m_stressPerCostStep steps ahead
+   static constexpr std::size_t m_bucketCount = 128;
+   static constexpr std::size_t m_bucketMask = m_bucketCount - 1;
+
+   static_assert(m_bucketCount > m_stressPerCostStep);
+
+   struct Tile final
+   {
+      std::uint8_t stress = 0; // As of settledStep
+      std::uint32_t settledStep = 0;
+      std::uint32_t scheduledStep = 0; // Next decay step the tile has to be visited at, 0 if none
+
+      // Neighbours in the bucket of scheduledStep
+      std::uint32_t previousLink = m_noLink;
+      std::uint32_t nextLink = m_noLink;
+   };
+
+   std::size_t m_width;
+   std::size_t m_height;
+
+   Map<Tile, MappedStorage<Tile, DirtyChunkMask::m_chunkEdgeTiles>> m_tiles;
+
+   std::uint32_t m_decayStep = 1;
+
+   // First tile of the list of tiles scheduled for each decay step
+   std::array<std::uint32_t, m_bucketCount> m_bucketHeads{};
+
+   std::size_t m_activeTileCount = 0;
+
+   // Kept up to date by settle, cost steps only change when a tile is visited
+   std::int64_t m_costStepSum = 0;
+
+   std::uint8_t currentStress(const Tile& tile) const;
+
+   Tile& tileAt(const std::uint32_t link);
+
+   // Writes stress as of the current decay step and updates the schedule and the active count accordingly
+   void settle(const std::size_t tileIndex, const std::uint8_t stress);
+
+   void linkIntoBucket(const std::uint32_t link, Tile& tile);
+   void unlinkFromBucket(Tile& tile);
+
+   // Sorts the list starting at head by the offset of its tiles in the mapping, returns the new head
+   std::uint32_t sortByOffset(const std::uint32_t head);
+};
+
+inline std::size_t DesirePathsMap::width() const
+{
+   return m_width;
+}
+
+inline std::size_t DesirePathsMap::height() const
+{
+   return m_height;
+}
+
+inline std::uint8_t DesirePathsMap::at(const std::size_t x, const std::size_t y) const
+{
+   return currentStress(m_tiles.at(x, y));
+}
+
+inline std::size_t DesirePathsMap::activeTileCount() const
+{
+   return m_activeTileCount;
+}
+
+inline std::int64_t DesirePathsMap::costStepSum() const
+{
+   return m_costStepSum;
+}
+
+inline std::uint8_t DesirePathsMap::currentStress(const Tile& tile) const
+{
+   const auto decayedBy = m_decayStep - tile.settledStep;
+
+   return (tile.stress > decayedBy) ? static_cast<std::uint8_t>(tile.stress - decayedBy) : 0;
+}
+
+inline DesirePathsMap::Tile& DesirePathsMap::tileAt(const std::uint32_t link)
+{
+   return m_tiles.at((link - 1) % m_width, (link - 1) / m_width);
+}
+
+template<typename OnCostStepChanged>
+void DesirePathsMap::decay(OnCostStepChanged&& onCostStepChanged)
+{
+   m_decayStep += 1;
+
+   // In the order of the mapping, so every page is faulted in once per step rather than once per tile on it. Which tile
+   // is visited first makes no difference to the outcome.
+   auto link = sortByOffset(m_bucketHeads[m_decayStep & m_bucketMask]);
+
+   // Rescheduling never hits the bucket being processed, see settle
+   m_bucketHeads[m_decayStep & m_bucketMask] = m_noLink;
+
+   while (link != m_noLink)
+   {
+      auto& tile = tileAt(link);
+
+      assert(tile.scheduledStep == m_decayStep);
+
+      const std::size_t tileIndex = link - 1;
+
+      link = tile.nextLink;
+
+      tile.previousLink = m_noLink;
+      tile.nextLink = m_noLink;
+
+      const auto stressAfter = currentStress(tile);
+      const auto stressBefore = static_cast<std::uint8_t>(stressAfter + 1);
+
+      if (stressBefore / m_stressPerCostStep != stressAfter / m_stressPerCostStep)
+      {
+         onCostStepChanged(tileIndex % m_width, tileIndex / m_width, stressBefore, stressAfter);
+      }
+
+      settle(tileIndex, stressAfter);
+   }
+}
+
+template<typename F>
+void DesirePathsMap::forEachInRect(const std::size_t beginX, const std::size_t beginY, const std::size_t endX, const std::size_t endY, F&& f) const
+{
+   m_tiles.forEachInRect(beginX, beginY, endX, endY, [&] (const std::size_t x, const std::size_t y, const Tile& tile)
+   {
+      f(x, y, currentStress(tile));
+   });
+}
+
+// A villager stepped onto a tile and wants to add stress to it. Collected while ticking and applied afterwards.
+struct DesirePathStressDelta final
+{
+   std::size_t tileX;
+   std::size_t tileY;
+
+   int adjustment;
+};
+
+// Adds adjustment to the stress of the tile and lowers its base cost accordingly
+std::uint8_t adjustDesirePathStress(const std::size_t tileX, const std::size_t tileY, DesirePathsMap& desirePathsMap, CostMap& baseCostMap, DirtyChunkMask& baseCostDirtyChunks, const int adjustment);
+
+// Adds the stress to the tile if it is still grass and paves it if it reached full stress next to a paved tile.
+// Paved tiles are appended to changedTiles.
+void applyDesirePathStressDelta(
+   const DesirePathStressDelta& stressDelta,
+   WorldMap& worldMap,
+   std::vector<std::pair<std::size_t, std::size_t>>& changedTiles,
+   DirtyChunkMask& worldDirtyChunks,
+   CostMap& baseCostMap,
+   DesirePathsMap& desirePathsMap,
+   const bool pavePaths,
+   const std::uint64_t seed
+);
+
+// Lowers the stress of every tile by 1, only visits tiles whose base cost changes or whose stress runs out
+void decayDesirePaths(DesirePathsMap& desirePathsMap, CostMap& baseCostMap, DirtyChunkMask& baseCostDirtyChunks);
 
 #endif // DESIREPATHS_HPP
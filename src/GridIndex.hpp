@@ -0,0 +1,219 @@
+#ifndef GRIDINDEX_HPP
+#define GRIDINDEX_HPP
+
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+
+// Layouts of 2D grids in a flat array. Each maps (x, y) to an index with operator() and back with coordinates, and
+// steps from the index of (x, y) to the index of (x + dx, y + dy) with neighbor, which is cheaper than computing the
+// index from scratch.
+
+// Rows one after the other
+class RowMajorIndex final
+{
+public:
+   RowMajorIndex(const std::size_t width, const std::size_t height);
+
+   RowMajorIndex(const RowMajorIndex&) = default;
+   RowMajorIndex(RowMajorIndex&&) noexcept = default;
+
+   ~RowMajorIndex() = default;
+
+   RowMajorIndex& operator=(const RowMajorIndex&) = default;
+   RowMajorIndex& operator=(RowMajorIndex&&) noexcept = default;
+
+   std::size_t size() const;
+
+   std::size_t operator()(const std::size_t x, const std::size_t y) const;
+
+   std::pair<std::size_t, std::size_t> coordinates(const std::size_t index) const;
+
+   std::size_t neighbor(const std::size_t index, const std::size_t x, const std::size_t y, const int dx, const int dy) const;
+
+private:
+   std::size_t m_width;
+   std::size_t m_height;
+};
+
+// Z-order (Morton order) within square blocks of m_blockEdgeTiles, blocks one after the other row by row. Tiles that
+// are close in 2D are close in memory no matter how wide the grid is: all 8 neighbours of a tile are at most a few
+// cache lines away, instead of spanning three rows. Blocks keep the padding small for grids that are not square.
+//
+// Within a block, x is stored in the even bits of the index and y in the odd bits. Stepping to a neighbour only
+// carries through the bits of one axis, which is done by filling the bits of the other axis with ones (to propagate
+// the carry) or zeros (to propagate the borrow) before adding or subtracting 1.
+class MortonIndex final
+{
+public:
+   static constexpr std::size_t m_blockEdgeBits = 6;
+   static constexpr std::size_t m_blockEdgeTiles = std::size_t{1} << m_blockEdgeBits;
+   static constexpr std::size_t m_blockTileCount = m_blockEdgeTiles * m_blockEdgeTiles;
+
+   MortonIndex(const std::size_t width, const std::size_t height);
+
+   MortonIndex(const MortonIndex&) = default;
+   MortonIndex(MortonIndex&&) noexcept = default;
+
+   ~MortonIndex() = default;
+
+   MortonIndex& operator=(const MortonIndex&) = default;
+   MortonIndex& operator=(MortonIndex&&) noexcept = default;
+
+   // Including the padding of the last block row and column
+   std::size_t size() const;
+
+   std::size_t operator()(const std::size_t x, const std::size_t y) const;
+
+   std::pair<std::size_t, std::size_t> coordinates(const std::size_t index) const;
+
+   std::size_t neighbor(const std::size_t index, const std::size_t x, const std::size_t y, const int dx, const int dy) const;
+
+   static std::uint32_t encode(const std::uint32_t x, const std::uint32_t y);
+
+   static std::uint32_t incrementX(const std::uint32_t code);
+   static std::uint32_t decrementX(const std::uint32_t code);
+   static std::uint32_t incrementY(const std::uint32_t code);
+   static std::uint32_t decrementY(const std::uint32_t code);
+
+private:
+   static constexpr std::uint32_t m_xBits = 0x55555555;
+   static constexpr std::uint32_t m_yBits = 0xAAAAAAAA;
+
+   std::size_t m_widthBlocks;
+   std::size_t m_heightBlocks;
+
+   // Spreads the lower 16 bits of v to the even bits of the result
+   static std::uint32_t spreadBits(std::uint32_t v);
+
+   // Inverse of spreadBits, gathers the even bits of v into the lower 16 bits of the result
+   static std::uint32_t compactBits(std::uint32_t v);
+};
+
+inline RowMajorIndex::RowMajorIndex(const std::size_t width, const std::size_t height):
+   m_width{width},
+   m_height{height}
+{
+   // NOP
+}
+
+inline std::size_t RowMajorIndex::size() const
+{
+   return m_width * m_height;
+}
+
+inline std::size_t RowMajorIndex::operator()(const std::size_t x, const std::size_t y) const
+{
+   return y * m_width + x;
+}
+
+inline std::pair<std::size_t, std::size_t> RowMajorIndex::coordinates(const std::size_t index) const
+{
+   return {index % m_width, index / m_width};
+}
+
+inline std::size_t RowMajorIndex::neighbor(const std::size_t index, const std::size_t /*x*/, const std::size_t /*y*/, const int dx, const int dy) const
+{
+   return index + static_cast<std::ptrdiff_t>(dy) * static_cast<std::ptrdiff_t>(m_width) + static_cast<std::ptrdiff_t>(dx);
+}
+
+inline MortonIndex::MortonIndex(const std::size_t width, const std::size_t height):
+   m_widthBlocks {(width  + m_blockEdgeTiles - 1) / m_blockEdgeTiles},
+   m_heightBlocks{(height + m_blockEdgeTiles - 1) / m_blockEdgeTiles}
+{
+   // NOP
+}
+
+inline std::size_t MortonIndex::size() const
+{
+   return m_widthBlocks * m_heightBlocks * m_blockTileCount;
+}
+
+inline std::size_t MortonIndex::operator()(const std::size_t x, const std::size_t y) const
+{
+   const auto blockIndex = (y >> m_blockEdgeBits) * m_widthBlocks + (x >> m_blockEdgeBits);
+
+   return blockIndex * m_blockTileCount + encode(static_cast<std::uint32_t>(x & (m_blockEdgeTiles - 1)), static_cast<std::uint32_t>(y & (m_blockEdgeTiles - 1)));
+}
+
+inline std::pair<std::size_t, std::size_t> MortonIndex::coordinates(const std::size_t index) const
+{
+   const auto blockIndex = index / m_blockTileCount;
+   const auto code = static_cast<std::uint32_t>(index & (m_blockTileCount - 1));
+
+   const auto x = (blockIndex % m_widthBlocks) * m_blockEdgeTiles + compactBits(code);
+   const auto y = (blockIndex / m_widthBlocks) * m_blockEdgeTiles + compactBits(code >> 1);
+
+   return {x, y};
+}
+
+inline std::size_t MortonIndex::neighbor(const std::size_t index, const std::size_t x, const std::size_t y, const int dx, const int dy) const
+{
+   const auto neighborX = x + static_cast<std::ptrdiff_t>(dx);
+   const auto neighborY = y + static_cast<std::ptrdiff_t>(dy);
+
+   if (((neighborX ^ x) | (neighborY ^ y)) >> m_blockEdgeBits != 0)
+      return (*this)(neighborX, neighborY); // Different block
+
+   auto code = static_cast<std::uint32_t>(index & (m_blockTileCount - 1));
+
+   const auto blockStart = index - code;
+
+   if (dx > 0) code = incrementX(code);
+   if (dx < 0) code = decrementX(code);
+   if (dy > 0) code = incrementY(code);
+   if (dy < 0) code = decrementY(code);
+
+   return blockStart + code;
+}
+
+inline std::uint32_t MortonIndex::encode(const std::uint32_t x, const std::uint32_t y)
+{
+   return spreadBits(x) | (spreadBits(y) << 1);
+}
+
+inline std::uint32_t MortonIndex::incrementX(const std::uint32_t code)
+{
+   return (((code | m_yBits) + 1) & m_xBits) | (code & m_yBits);
+}
+
+inline std::uint32_t MortonIndex::decrementX(const std::uint32_t code)
+{
+   return (((code & m_xBits) - 1) & m_xBits) | (code & m_yBits);
+}
+
+inline std::uint32_t MortonIndex::incrementY(const std::uint32_t code)
+{
+   return (((code | m_xBits) + 1) & m_yBits) | (code & m_xBits);
+}
+
+inline std::uint32_t MortonIndex::decrementY(const std::uint32_t code)
+{
+   return (((code & m_yBits) - 1) & m_yBits) | (code & m_xBits);
+}
+
+inline std::uint32_t MortonIndex::spreadBits(std::uint32_t v)
+{
+   v &= 0x0000FFFF;
+
+   v = (v | (v << 8)) & 0x00FF00FF;
+   v = (v | (v << 4)) & 0x0F0F0F0F;
+   v = (v | (v << 2)) & 0x33333333;
+   v = (v | (v << 1)) & 0x55555555;
+
+   return v;
+}
+
+inline std::uint32_t MortonIndex::compactBits(std::uint32_t v)
+{
+   v &= 0x55555555;
+
+   v = (v | (v >> 1)) & 0x33333333;
+   v = (v | (v >> 2)) & 0x0F0F0F0F;
+   v = (v | (v >> 4)) & 0x00FF00FF;
+   v = (v | (v >> 8)) & 0x0000FFFF;
+
+   return v;
+}
+
+#endif // GRIDINDEX_HPP
@@ -0,0 +1,107 @@
+#ifndef HUGEPAGEALLOCATOR_HPP
+#define HUGEPAGEALLOCATOR_HPP
+
+#include <new>
+#include <cstdlib>
+#include <cstddef>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+// Allocator for the per-tile search state every pathfinding thread keeps for as long as it runs, see BasicPathfinder.
+// Allocations of at least a huge page are aligned to huge pages and, on Linux, marked for transparent huge pages, so
+// the random accesses of a search miss the TLB far less often. Smaller allocations and other platforms get plain
+// memory. The kernel is free to ignore the hint, nothing depends on it.
+template<typename T>
+class HugePageAllocator
+{
+public:
+   using value_type = T;
+
+   static constexpr std::size_t m_hugePageBytes = std::size_t{2} << 20;
+
+   HugePageAllocator() = default;
+
+   template<typename U>
+   HugePageAllocator(const HugePageAllocator<U>& /*other*/);
+
+   HugePageAllocator(const HugePageAllocator&) = default;
+   HugePageAllocator(HugePageAllocator&&) noexcept = default;
+
+   ~HugePageAllocator() = default;
+
+   HugePageAllocator& operator=(const HugePageAllocator&) = default;
+   HugePageAllocator& operator=(HugePageAllocator&&) noexcept = default;
+
+   T* allocate(const std::size_t count);
+   void deallocate(T* pointer, const std::size_t count);
+
+   template<typename U>
+   bool operator==(const HugePageAllocator<U>& /*other*/) const;
+
+   template<typename U>
+   bool operator!=(const HugePageAllocator<U>& /*other*/) const;
+};
+
+template<typename T>
+template<typename U>
+HugePageAllocator<T>::HugePageAllocator(const HugePageAllocator<U>& /*other*/)
+{
+   // NOP
+}
+
+template<typename T>
+T* HugePageAllocator<T>::allocate(const std::size_t count)
+{
+   const auto bytes = count * sizeof(T);
+
+   void* pointer = nullptr;
+
+#ifdef __linux__
+   if (bytes >= m_hugePageBytes)
+   {
+      // aligned_alloc wants a multiple of the alignment
+      const auto alignedBytes = (bytes + m_hugePageBytes - 1) / m_hugePageBytes * m_hugePageBytes;
+
+      pointer = std::aligned_alloc(m_hugePageBytes, alignedBytes);
+
+      if (pointer != nullptr)
+      {
+         madvise(pointer, alignedBytes, MADV_HUGEPAGE);
+      }
+   }
+   else
+#endif
+   {
+      pointer = std::malloc(bytes);
+   }
+
+   if (pointer == nullptr && bytes > 0)
+      throw std::bad_alloc{};
+
+   return static_cast<T*>(pointer);
+}
+
+template<typename T>
+void HugePageAllocator<T>::deallocate(T* pointer, const std::size_t /*count*/)
+{
+   // Both kinds of allocation are freed the same way
+   std::free(pointer);
+}
+
+template<typename T>
+template<typename U>
+bool HugePageAllocator<T>::operator==(const HugePageAllocator<U>& /*other*/) const
+{
+   return true;
+}
+
+template<typename T>
+template<typename U>
+bool HugePageAllocator<T>::operator!=(const HugePageAllocator<U>& /*other*/) const
+{
+   return false;
+}
+
+#endif // HUGEPAGEALLOCATOR_HPP
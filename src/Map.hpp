@@ -2,15 +2,25 @@
 #define MAP_HPP
 
 #include <limits>
+#include <utility>
 #include <vector>
 #include <cassert>
 #include <optional>
+#include <algorithm>
 
-template<typename T>
+#include "MapStorage.hpp"
+
+// 2D grid of T. How the tiles are laid out in memory is up to Storage, see MapStorage.hpp.
+template<typename T, typename Storage = RowMajorStorage<T>>
 class Map
 {
 public:
    Map(const std::size_t width, const std::size_t height, const T& fill = T{});
+
+   // Passes storageArgs on to the Storage constructor after the fill value, like the allocator of RowMajorStorage
+   template<typename... StorageArgs>
+   Map(const std::size_t width, const std::size_t height, const T& fill, StorageArgs&&... storageArgs);
+
    Map(std::initializer_list<std::initializer_list<T>> values);
 
    Map(const Map&) = default;
@@ -27,9 +37,19 @@ public:
    std::size_t width() const;
    std::size_t height() const;
 
-   Map<T> rotated90CW() const;
-   Map<T> rotated90CCW() const;
-   Map<T> rotated180() const;
+   // Calls f(x, y, value) for every tile in [beginX, endX) x [beginY, endY), in the order that is fastest for Storage
+   template<typename F>
+   void forEachInRect(const std::size_t beginX, const std::size_t beginY, const std::size_t endX, const std::size_t endY, F&& f) const;
+
+   template<typename F>
+   void forEachInRect(const std::size_t beginX, const std::size_t beginY, const std::size_t endX, const std::size_t endY, F&& f);
+
+   const Storage& storage() const;
+   Storage& storage();
+
+   Map rotated90CW() const;
+   Map rotated90CCW() const;
+   Map rotated180() const;
 
    std::optional<std::pair<std::size_t /*foundAtX*/, std::size_t /*foundAtY*/>>
    find(const T value, const std::size_t startX = 0, const std::size_t startY = 0, const bool wrap = false) const;
@@ -38,22 +58,33 @@ protected:
    std::size_t m_width;
    std::size_t m_height;
 
-   std::vector<T> m_values;
+   Storage m_storage;
 };
 
-template<typename T>
-Map<T>::Map(const std::size_t width, const std::size_t height, const T& fill) :
+template<typename T, typename Storage>
+Map<T, Storage>::Map(const std::size_t width, const std::size_t height, const T& fill) :
+   m_width{width},
+   m_height{height},
+   m_storage{m_width, m_height, fill}
+{
+   // NOP
+}
+
+template<typename T, typename Storage>
+template<typename... StorageArgs>
+Map<T, Storage>::Map(const std::size_t width, const std::size_t height, const T& fill, StorageArgs&&... storageArgs) :
    m_width{width},
    m_height{height},
-   m_values(m_width * m_height, fill)
+   m_storage{m_width, m_height, fill, std::forward<StorageArgs>(storageArgs)...}
 {
    // NOP
 }
 
-template<typename T>
-Map<T>::Map(std::initializer_list<std::initializer_list<T>> values) :
+template<typename T, typename Storage>
+Map<T, Storage>::Map(std::initializer_list<std::initializer_list<T>> values) :
    m_width{0},
-   m_height{values.size()}
+   m_height{values.size()},
+   m_storage{0, 0, T{}}
 {
    auto minWidth = std::numeric_limits<std::size_t>::max();
 
@@ -72,45 +103,77 @@ Map<T>::Map(std::initializer_list<std::initializer_list<T>> values) :
 
    assert(minWidth == m_width);
 
-   m_values.reserve(m_width * m_height);
+   m_storage = Storage{m_width, m_height, T{}};
+
+   std::size_t y = 0;
 
    for (const auto& row : values)
    {
+      std::size_t x = 0;
+
       for (const auto& column : row)
       {
-         m_values.emplace_back(column);
+         at(x++, y) = column;
       }
+
+      y += 1;
    }
 }
 
-template<typename T>
-const T& Map<T>::at(const std::size_t x, const std::size_t y) const
+template<typename T, typename Storage>
+const T& Map<T, Storage>::at(const std::size_t x, const std::size_t y) const
 {
-   return m_values[y * m_width + x];
+   return m_storage.at(x, y);
 }
 
-template<typename T>
-T& Map<T>::at(const std::size_t x, const std::size_t y)
+template<typename T, typename Storage>
+T& Map<T, Storage>::at(const std::size_t x, const std::size_t y)
 {
-   return m_values[y * m_width + x];
+   return m_storage.at(x, y);
 }
 
-template<typename T>
-std::size_t Map<T>::width() const
+template<typename T, typename Storage>
+std::size_t Map<T, Storage>::width() const
 {
    return m_width;
 }
 
-template<typename T>
-std::size_t Map<T>::height() const
+template<typename T, typename Storage>
+std::size_t Map<T, Storage>::height() const
 {
    return m_height;
 }
 
-template<typename T>
-Map<T> Map<T>::rotated90CW() const
+template<typename T, typename Storage>
+template<typename F>
+void Map<T, Storage>::forEachInRect(const std::size_t beginX, const std::size_t beginY, const std::size_t endX, const std::size_t endY, F&& f) const
+{
+   m_storage.forEachInRect(beginX, beginY, std::min(endX, m_width), std::min(endY, m_height), f);
+}
+
+template<typename T, typename Storage>
+template<typename F>
+void Map<T, Storage>::forEachInRect(const std::size_t beginX, const std::size_t beginY, const std::size_t endX, const std::size_t endY, F&& f)
+{
+   m_storage.forEachInRect(beginX, beginY, std::min(endX, m_width), std::min(endY, m_height), f);
+}
+
+template<typename T, typename Storage>
+const Storage& Map<T, Storage>::storage() const
+{
+   return m_storage;
+}
+
+template<typename T, typename Storage>
+Storage& Map<T, Storage>::storage()
+{
+   return m_storage;
+}
+
+template<typename T, typename Storage>
+Map<T, Storage> Map<T, Storage>::rotated90CW() const
 {
-   Map<T> newMap{m_height, m_width};
+   Map newMap{m_height, m_width};
 
    for (std::size_t y = 0; y < m_height; ++y)
    {
@@ -123,10 +186,10 @@ Map<T> Map<T>::rotated90CW() const
    return newMap;
 }
 
-template<typename T>
-Map<T> Map<T>::rotated90CCW() const
+template<typename T, typename Storage>
+Map<T, Storage> Map<T, Storage>::rotated90CCW() const
 {
-   Map<T> newMap{m_height, m_width};
+   Map newMap{m_height, m_width};
 
    for (std::size_t y = 0; y < m_height; ++y)
    {
@@ -139,10 +202,10 @@ Map<T> Map<T>::rotated90CCW() const
    return newMap;
 }
 
-template<typename T>
-Map<T> Map<T>::rotated180() const
+template<typename T, typename Storage>
+Map<T, Storage> Map<T, Storage>::rotated180() const
 {
-   Map<T> newMap{m_height, m_width};
+   Map newMap{m_height, m_width};
 
    for (std::size_t y = 0; y < m_height; ++y)
    {
@@ -155,9 +218,9 @@ Map<T> Map<T>::rotated180() const
    return newMap;
 }
 
-template<typename T>
+template<typename T, typename Storage>
 std::optional<std::pair<std::size_t /*foundAtX*/, std::size_t /*foundAtY*/>>
-Map<T>::find(const T value, const std::size_t startX, const std::size_t startY, const bool wrap) const
+Map<T, Storage>::find(const T value, const std::size_t startX, const std::size_t startY, const bool wrap) const
 {
    // First row
    if (startY >= m_height || startX >= m_width)
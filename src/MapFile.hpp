@@ -0,0 +1,36 @@
+#ifndef MAPFILE_HPP
+#define MAPFILE_HPP
+
+#include <string>
+#include <fstream>
+#include <stdexcept>
+#include <cstdint>
+
+#include "Map.hpp"
+
+// Writes a map with one byte per tile as binary PGM (P5), the raw tile values become the gray values
+template<typename T, typename Storage>
+void writeMapPGM(const Map<T, Storage>& map, const std::string& filePath)
+{
+   static_assert(sizeof(T) == 1, "PGM output needs one byte per tile");
+
+   std::ofstream file{filePath, std::ios::binary};
+
+   if (file.is_open() == false)
+      throw std::runtime_error{"Could not open \"" + filePath + "\" for writing"};
+
+   file << "P5\n" << map.width() << ' ' << map.height() << "\n255\n";
+
+   for (std::size_t y = 0; y < map.height(); ++y)
+   {
+      for (std::size_t x = 0; x < map.width(); ++x)
+      {
+         file.put(static_cast<char>(map.at(x, y)));
+      }
+   }
+
+   if (file.good() == false)
+      throw std::runtime_error{"Could not write \"" + filePath + "\""};
+}
+
+#endif // MAPFILE_HPP
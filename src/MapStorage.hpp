@@ -0,0 +1,421 @@
+#ifndef MAPSTORAGE_HPP
+#define MAPSTORAGE_HPP
+
+#include <vector>
+#include <array>
+#include <memory>
+#include <algorithm>
+#include <type_traits>
+
+#include "GridIndex.hpp"
+
+// Storage backends for Map. Every backend provides at(x, y) and forEachInRect, which visits the tiles of
+// [beginX, endX) x [beginY, endY) in an order that suits the backend, calling f(x, y, value) for each.
+
+// All tiles in one row-major array, allocated through Allocator
+template<typename T, typename Allocator = std::allocator<T>>
+class RowMajorStorage final
+{
+public:
+   RowMajorStorage(const std::size_t width, const std::size_t height, const T& fill, const Allocator& allocator = Allocator{});
+
+   RowMajorStorage(const RowMajorStorage&) = default;
+   RowMajorStorage(RowMajorStorage&&) noexcept = default;
+
+   ~RowMajorStorage() = default;
+
+   RowMajorStorage& operator=(const RowMajorStorage&) = default;
+   RowMajorStorage& operator=(RowMajorStorage&&) noexcept = default;
+
+   const T& at(const std::size_t x, const std::size_t y) const;
+   T& at(const std::size_t x, const std::size_t y);
+
+   template<typename F>
+   void forEachInRect(const std::size_t beginX, const std::size_t beginY, const std::size_t endX, const std::size_t endY, F&& f) const;
+
+   template<typename F>
+   void forEachInRect(const std::size_t beginX, const std::size_t beginY, const std::size_t endX, const std::size_t endY, F&& f);
+
+   // Row y starts at data() + y * width
+   const T* data() const;
+   T* data();
+
+private:
+   std::size_t m_width;
+
+   std::vector<T, Allocator> m_values;
+};
+
+// Tiles in square chunks of ChunkEdgeTiles squared tiles, each chunk row-major. Neighbourhoods and rectangles up to
+// the chunk size touch at most four allocations instead of one row each, and no single allocation grows with the map.
+// Chunks are only allocated once a tile in them is written to, reading a tile of an unallocated chunk gives the fill
+// value. For sparse layers, only accessing tiles through the const overloads keeps untouched chunks unallocated.
+template<typename T, std::size_t ChunkEdgeTiles = 64>
+class ChunkedStorage final
+{
+public:
+   static constexpr std::size_t m_chunkEdgeTiles = ChunkEdgeTiles;
+
+   static_assert((ChunkEdgeTiles & (ChunkEdgeTiles - 1)) == 0, "Chunk edge must be a power of two");
+
+   ChunkedStorage(const std::size_t width, const std::size_t height, const T& fill);
+
+   ChunkedStorage(const ChunkedStorage& other);
+   ChunkedStorage(ChunkedStorage&&) noexcept = default;
+
+   ~ChunkedStorage() = default;
+
+   ChunkedStorage& operator=(const ChunkedStorage& other);
+   ChunkedStorage& operator=(ChunkedStorage&&) noexcept = default;
+
+   const T& at(const std::size_t x, const std::size_t y) const;
+   T& at(const std::size_t x, const std::size_t y);
+
+   // Visits chunk by chunk, tiles of unallocated chunks are visited with the fill value
+   template<typename F>
+   void forEachInRect(const std::size_t beginX, const std::size_t beginY, const std::size_t endX, const std::size_t endY, F&& f) const;
+
+   // Visits chunk by chunk, allocating every chunk the rect overlaps
+   template<typename F>
+   void forEachInRect(const std::size_t beginX, const std::size_t beginY, const std::size_t endX, const std::size_t endY, F&& f);
+
+   std::size_t widthChunks() const;
+   std::size_t heightChunks() const;
+
+   bool isChunkAllocated(const std::size_t chunkX, const std::size_t chunkY) const;
+   std::size_t allocatedChunkCount() const;
+
+private:
+   using Chunk = std::array<T, ChunkEdgeTiles * ChunkEdgeTiles>;
+
+   std::size_t m_widthChunks;
+   std::size_t m_heightChunks;
+
+   T m_fill;
+
+   std::vector<std::unique_ptr<Chunk>> m_chunks;
+
+   static std::size_t indexInChunk(const std::size_t x, const std::size_t y);
+
+   Chunk& allocatedChunk(const std::size_t chunkX, const std::size_t chunkY);
+
+   template<typename Self, typename F>
+   static void forEachInRectOf(Self& self, const std::size_t beginX, const std::size_t beginY, const std::size_t endX, const std::size_t endY, F& f);
+};
+
+// Tiles in Z-order within 64x64 blocks, see MortonIndex. Meant for grids that are mostly read in small 2D
+// neighbourhoods, like pathfinding does.
+template<typename T>
+class MortonStorage final
+{
+public:
+   MortonStorage(const std::size_t width, const std::size_t height, const T& fill);
+
+   MortonStorage(const MortonStorage&) = default;
+   MortonStorage(MortonStorage&&) noexcept = default;
+
+   ~MortonStorage() = default;
+
+   MortonStorage& operator=(const MortonStorage&) = default;
+   MortonStorage& operator=(MortonStorage&&) noexcept = default;
+
+   const T& at(const std::size_t x, const std::size_t y) const;
+   T& at(const std::size_t x, const std::size_t y);
+
+   template<typename F>
+   void forEachInRect(const std::size_t beginX, const std::size_t beginY, const std::size_t endX, const std::size_t endY, F&& f) const;
+
+   template<typename F>
+   void forEachInRect(const std::size_t beginX, const std::size_t beginY, const std::size_t endX, const std::size_t endY, F&& f);
+
+   const MortonIndex& index() const;
+
+private:
+   MortonIndex m_index;
+
+   std::vector<T> m_values;
+};
+
+template<typename T, typename Allocator>
+RowMajorStorage<T, Allocator>::RowMajorStorage(const std::size_t width, const std::size_t height, const T& fill, const Allocator& allocator):
+   m_width{width},
+   m_values(width * height, fill, allocator)
+{
+   // NOP
+}
+
+template<typename T, typename Allocator>
+const T& RowMajorStorage<T, Allocator>::at(const std::size_t x, const std::size_t y) const
+{
+   return m_values[y * m_width + x];
+}
+
+template<typename T, typename Allocator>
+T& RowMajorStorage<T, Allocator>::at(const std::size_t x, const std::size_t y)
+{
+   return m_values[y * m_width + x];
+}
+
+template<typename T, typename Allocator>
+template<typename F>
+void RowMajorStorage<T, Allocator>::forEachInRect(const std::size_t beginX, const std::size_t beginY, const std::size_t endX, const std::size_t endY, F&& f) const
+{
+   for (auto y = beginY; y < endY; ++y)
+   {
+      const T* row = m_values.data() + y * m_width;
+
+      for (auto x = beginX; x < endX; ++x)
+      {
+         f(x, y, row[x]);
+      }
+   }
+}
+
+template<typename T, typename Allocator>
+template<typename F>
+void RowMajorStorage<T, Allocator>::forEachInRect(const std::size_t beginX, const std::size_t beginY, const std::size_t endX, const std::size_t endY, F&& f)
+{
+   for (auto y = beginY; y < endY; ++y)
+   {
+      T* row = m_values.data() + y * m_width;
+
+      for (auto x = beginX; x < endX; ++x)
+      {
+         f(x, y, row[x]);
+      }
+   }
+}
+
+template<typename T, typename Allocator>
+const T* RowMajorStorage<T, Allocator>::data() const
+{
+   return m_values.data();
+}
+
+template<typename T, typename Allocator>
+T* RowMajorStorage<T, Allocator>::data()
+{
+   return m_values.data();
+}
+
+template<typename T, std::size_t ChunkEdgeTiles>
+ChunkedStorage<T, ChunkEdgeTiles>::ChunkedStorage(const std::size_t width, const std::size_t height, const T& fill):
+   m_widthChunks {(width  + ChunkEdgeTiles - 1) / ChunkEdgeTiles},
+   m_heightChunks{(height + ChunkEdgeTiles - 1) / ChunkEdgeTiles},
+   m_fill{fill},
+   m_chunks(m_widthChunks * m_heightChunks)
+{
+   // NOP
+}
+
+template<typename T, std::size_t ChunkEdgeTiles>
+ChunkedStorage<T, ChunkEdgeTiles>::ChunkedStorage(const ChunkedStorage& other):
+   m_widthChunks{other.m_widthChunks},
+   m_heightChunks{other.m_heightChunks},
+   m_fill{other.m_fill},
+   m_chunks(other.m_chunks.size())
+{
+   for (std::size_t chunkIndex = 0; chunkIndex < m_chunks.size(); ++chunkIndex)
+   {
+      if (other.m_chunks[chunkIndex] != nullptr)
+      {
+         m_chunks[chunkIndex] = std::make_unique<Chunk>(*other.m_chunks[chunkIndex]);
+      }
+   }
+}
+
+template<typename T, std::size_t ChunkEdgeTiles>
+ChunkedStorage<T, ChunkEdgeTiles>& ChunkedStorage<T, ChunkEdgeTiles>::operator=(const ChunkedStorage& other)
+{
+   if (this != &other)
+   {
+      *this = ChunkedStorage{other};
+   }
+
+   return *this;
+}
+
+template<typename T, std::size_t ChunkEdgeTiles>
+const T& ChunkedStorage<T, ChunkEdgeTiles>::at(const std::size_t x, const std::size_t y) const
+{
+   const auto& chunk = m_chunks[(y / ChunkEdgeTiles) * m_widthChunks + (x / ChunkEdgeTiles)];
+
+   if (chunk == nullptr)
+      return m_fill;
+
+   return (*chunk)[indexInChunk(x, y)];
+}
+
+template<typename T, std::size_t ChunkEdgeTiles>
+T& ChunkedStorage<T, ChunkEdgeTiles>::at(const std::size_t x, const std::size_t y)
+{
+   return allocatedChunk(x / ChunkEdgeTiles, y / ChunkEdgeTiles)[indexInChunk(x, y)];
+}
+
+template<typename T, std::size_t ChunkEdgeTiles>
+template<typename F>
+void ChunkedStorage<T, ChunkEdgeTiles>::forEachInRect(const std::size_t beginX, const std::size_t beginY, const std::size_t endX, const std::size_t endY, F&& f) const
+{
+   forEachInRectOf(*this, beginX, beginY, endX, endY, f);
+}
+
+template<typename T, std::size_t ChunkEdgeTiles>
+template<typename F>
+void ChunkedStorage<T, ChunkEdgeTiles>::forEachInRect(const std::size_t beginX, const std::size_t beginY, const std::size_t endX, const std::size_t endY, F&& f)
+{
+   forEachInRectOf(*this, beginX, beginY, endX, endY, f);
+}
+
+template<typename T, std::size_t ChunkEdgeTiles>
+std::size_t ChunkedStorage<T, ChunkEdgeTiles>::widthChunks() const
+{
+   return m_widthChunks;
+}
+
+template<typename T, std::size_t ChunkEdgeTiles>
+std::size_t ChunkedStorage<T, ChunkEdgeTiles>::heightChunks() const
+{
+   return m_heightChunks;
+}
+
+template<typename T, std::size_t ChunkEdgeTiles>
+bool ChunkedStorage<T, ChunkEdgeTiles>::isChunkAllocated(const std::size_t chunkX, const std::size_t chunkY) const
+{
+   return (m_chunks[chunkY * m_widthChunks + chunkX] != nullptr);
+}
+
+template<typename T, std::size_t ChunkEdgeTiles>
+std::size_t ChunkedStorage<T, ChunkEdgeTiles>::allocatedChunkCount() const
+{
+   return static_cast<std::size_t>(std::count_if(std::begin(m_chunks), std::end(m_chunks), [] (const auto& chunk) { return (chunk != nullptr); }));
+}
+
+template<typename T, std::size_t ChunkEdgeTiles>
+std::size_t ChunkedStorage<T, ChunkEdgeTiles>::indexInChunk(const std::size_t x, const std::size_t y)
+{
+   return (y % ChunkEdgeTiles) * ChunkEdgeTiles + (x % ChunkEdgeTiles);
+}
+
+template<typename T, std::size_t ChunkEdgeTiles>
+typename ChunkedStorage<T, ChunkEdgeTiles>::Chunk& ChunkedStorage<T, ChunkEdgeTiles>::allocatedChunk(const std::size_t chunkX, const std::size_t chunkY)
+{
+   auto& chunk = m_chunks[chunkY * m_widthChunks + chunkX];
+
+   if (chunk == nullptr)
+   {
+      chunk = std::make_unique<Chunk>();
+
+      chunk->fill(m_fill);
+   }
+
+   return *chunk;
+}
+
+template<typename T, std::size_t ChunkEdgeTiles>
+template<typename Self, typename F>
+void ChunkedStorage<T, ChunkEdgeTiles>::forEachInRectOf(Self& self, const std::size_t beginX, const std::size_t beginY, const std::size_t endX, const std::size_t endY, F& f)
+{
+   if (beginX >= endX || beginY >= endY)
+      return;
+
+   for (auto chunkY = beginY / ChunkEdgeTiles; chunkY <= (endY - 1) / ChunkEdgeTiles; ++chunkY)
+   {
+      const auto chunkBeginY = std::max(beginY, chunkY * ChunkEdgeTiles);
+      const auto chunkEndY   = std::min(endY, (chunkY + 1) * ChunkEdgeTiles);
+
+      for (auto chunkX = beginX / ChunkEdgeTiles; chunkX <= (endX - 1) / ChunkEdgeTiles; ++chunkX)
+      {
+         const auto chunkBeginX = std::max(beginX, chunkX * ChunkEdgeTiles);
+         const auto chunkEndX   = std::min(endX, (chunkX + 1) * ChunkEdgeTiles);
+
+         if constexpr (std::is_const_v<Self>)
+         {
+            const auto& chunk = self.m_chunks[chunkY * self.m_widthChunks + chunkX];
+
+            for (auto y = chunkBeginY; y < chunkEndY; ++y)
+            {
+               for (auto x = chunkBeginX; x < chunkEndX; ++x)
+               {
+                  f(x, y, (chunk != nullptr) ? (*chunk)[indexInChunk(x, y)] : self.m_fill);
+               }
+            }
+         }
+         else
+         {
+            auto& chunk = self.allocatedChunk(chunkX, chunkY);
+
+            for (auto y = chunkBeginY; y < chunkEndY; ++y)
+            {
+               T* row = chunk.data() + (y % ChunkEdgeTiles) * ChunkEdgeTiles;
+
+               for (auto x = chunkBeginX; x < chunkEndX; ++x)
+               {
+                  f(x, y, row[x % ChunkEdgeTiles]);
+               }
+            }
+         }
+      }
+   }
+}
+
+template<typename T>
+MortonStorage<T>::MortonStorage(const std::size_t width, const std::size_t height, const T& fill):
+   m_index{width, height},
+   m_values(m_index.size(), fill)
+{
+   // NOP
+}
+
+template<typename T>
+const T& MortonStorage<T>::at(const std::size_t x, const std::size_t y) const
+{
+   return m_values[m_index(x, y)];
+}
+
+template<typename T>
+T& MortonStorage<T>::at(const std::size_t x, const std::size_t y)
+{
+   return m_values[m_index(x, y)];
+}
+
+template<typename T>
+template<typename F>
+void MortonStorage<T>::forEachInRect(const std::size_t beginX, const std::size_t beginY, const std::size_t endX, const std::size_t endY, F&& f) const
+{
+   for (auto y = beginY; y < endY; ++y)
+   {
+      auto index = m_index(beginX, y);
+
+      for (auto x = beginX; x < endX; ++x)
+      {
+         f(x, y, m_values[index]);
+
+         index = m_index.neighbor(index, x, y, 1, 0);
+      }
+   }
+}
+
+template<typename T>
+template<typename F>
+void MortonStorage<T>::forEachInRect(const std::size_t beginX, const std::size_t beginY, const std::size_t endX, const std::size_t endY, F&& f)
+{
+   for (auto y = beginY; y < endY; ++y)
+   {
+      auto index = m_index(beginX, y);
+
+      for (auto x = beginX; x < endX; ++x)
+      {
+         f(x, y, m_values[index]);
+
+         index = m_index.neighbor(index, x, y, 1, 0);
+      }
+   }
+}
+
+template<typename T>
+const MortonIndex& MortonStorage<T>::index() const
+{
+   return m_index;
+}
+
+#endif // MAPSTORAGE_HPP
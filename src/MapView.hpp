@@ -0,0 +1,205 @@
+#ifndef MAPVIEW_HPP
+#define MAPVIEW_HPP
+
+#include <cassert>
+#include <cstddef>
+#include <type_traits>
+
+#include "Map.hpp"
+
+// Non-owning 2D view of tiles somewhere in memory, usually of a row-major Map. Tile (x, y) of the span is at
+// origin[x * stepX + y * stepY], so a span can be a rectangle inside a larger map (stepY being the row stride of the
+// map) or a rotation of one (swapped or negative steps) without copying anything. row() gives direct access to the
+// tiles of a row as long as they are next to each other in memory, which is the case for any unrotated span.
+//
+// T may be const, MapView<T> is the read-only span.
+template<typename T>
+class MapSpan final
+{
+public:
+   using ValueType = std::remove_const_t<T>;
+
+   MapSpan(T* origin, const std::size_t width, const std::size_t height, const std::ptrdiff_t stepX, const std::ptrdiff_t stepY);
+
+   // Whole map, for any storage with row-major data()
+   template<typename Storage>
+   MapSpan(Map<ValueType, Storage>& map);
+
+   template<typename Storage, typename U = T, typename = std::enable_if_t<std::is_const_v<U>>>
+   MapSpan(const Map<ValueType, Storage>& map);
+
+   // Writable span to read-only view
+   template<typename U, typename = std::enable_if_t<std::is_same_v<const U, T>>>
+   MapSpan(const MapSpan<U>& span);
+
+   MapSpan(const MapSpan&) = default;
+   MapSpan(MapSpan&&) noexcept = default;
+
+   ~MapSpan() = default;
+
+   MapSpan& operator=(const MapSpan&) = default;
+   MapSpan& operator=(MapSpan&&) noexcept = default;
+
+   T& at(const std::size_t x, const std::size_t y) const;
+
+   std::size_t width() const;
+   std::size_t height() const;
+
+   bool rowsContiguous() const;
+
+   // Tiles [0, width()) of row y, only if rowsContiguous()
+   T* row(const std::size_t y) const;
+
+   MapSpan subSpan(const std::size_t beginX, const std::size_t beginY, const std::size_t width, const std::size_t height) const;
+
+   // Same orientation as the Map functions of the same name
+   MapSpan rotated90CW() const;
+   MapSpan rotated90CCW() const;
+   MapSpan rotated180() const;
+
+   MapSpan rotatedCW(const std::size_t quarterTurns) const;
+
+private:
+   template<typename> friend class MapSpan;
+
+   T* m_origin;
+
+   std::size_t m_width;
+   std::size_t m_height;
+
+   std::ptrdiff_t m_stepX;
+   std::ptrdiff_t m_stepY;
+
+   T* tileAddress(const std::size_t x, const std::size_t y) const;
+};
+
+template<typename T>
+using MapView = MapSpan<const T>;
+
+template<typename T>
+MapSpan<T>::MapSpan(T* origin, const std::size_t width, const std::size_t height, const std::ptrdiff_t stepX, const std::ptrdiff_t stepY):
+   m_origin{origin},
+   m_width{width},
+   m_height{height},
+   m_stepX{stepX},
+   m_stepY{stepY}
+{
+   // NOP
+}
+
+template<typename T>
+template<typename Storage>
+MapSpan<T>::MapSpan(Map<ValueType, Storage>& map):
+   MapSpan{map.storage().data(), map.width(), map.height(), 1, static_cast<std::ptrdiff_t>(map.width())}
+{
+   // NOP
+}
+
+template<typename T>
+template<typename Storage, typename U, typename>
+MapSpan<T>::MapSpan(const Map<ValueType, Storage>& map):
+   MapSpan{map.storage().data(), map.width(), map.height(), 1, static_cast<std::ptrdiff_t>(map.width())}
+{
+   // NOP
+}
+
+template<typename T>
+template<typename U, typename>
+MapSpan<T>::MapSpan(const MapSpan<U>& span):
+   MapSpan{span.m_origin, span.m_width, span.m_height, span.m_stepX, span.m_stepY}
+{
+   // NOP
+}
+
+template<typename T>
+T& MapSpan<T>::at(const std::size_t x, const std::size_t y) const
+{
+   return *tileAddress(x, y);
+}
+
+template<typename T>
+std::size_t MapSpan<T>::width() const
+{
+   return m_width;
+}
+
+template<typename T>
+std::size_t MapSpan<T>::height() const
+{
+   return m_height;
+}
+
+template<typename T>
+bool MapSpan<T>::rowsContiguous() const
+{
+   return (m_stepX == 1);
+}
+
+template<typename T>
+T* MapSpan<T>::row(const std::size_t y) const
+{
+   assert(rowsContiguous());
+
+   return tileAddress(0, y);
+}
+
+template<typename T>
+MapSpan<T> MapSpan<T>::subSpan(const std::size_t beginX, const std::size_t beginY, const std::size_t width, const std::size_t height) const
+{
+   assert(beginX + width <= m_width && beginY + height <= m_height);
+
+   return MapSpan{tileAddress(beginX, beginY), width, height, m_stepX, m_stepY};
+}
+
+template<typename T>
+MapSpan<T> MapSpan<T>::rotated90CW() const
+{
+   // (x, y) of the result is (y, height - 1 - x) of this
+   if (m_width == 0 || m_height == 0)
+      return MapSpan{m_origin, m_height, m_width, -m_stepY, m_stepX};
+
+   return MapSpan{tileAddress(0, m_height - 1), m_height, m_width, -m_stepY, m_stepX};
+}
+
+template<typename T>
+MapSpan<T> MapSpan<T>::rotated90CCW() const
+{
+   // (x, y) of the result is (width - 1 - y, x) of this
+   if (m_width == 0 || m_height == 0)
+      return MapSpan{m_origin, m_height, m_width, m_stepY, -m_stepX};
+
+   return MapSpan{tileAddress(m_width - 1, 0), m_height, m_width, m_stepY, -m_stepX};
+}
+
+template<typename T>
+MapSpan<T> MapSpan<T>::rotated180() const
+{
+   if (m_width == 0 || m_height == 0)
+      return MapSpan{m_origin, m_width, m_height, -m_stepX, -m_stepY};
+
+   return MapSpan{tileAddress(m_width - 1, m_height - 1), m_width, m_height, -m_stepX, -m_stepY};
+}
+
+template<typename T>
+MapSpan<T> MapSpan<T>::rotatedCW(const std::size_t quarterTurns) const
+{
+   switch (quarterTurns % 4)
+   {
+   case 1:
+      return rotated90CW();
+   case 2:
+      return rotated180();
+   case 3:
+      return rotated90CCW();
+   default:
+      return *this;
+   }
+}
+
+template<typename T>
+T* MapSpan<T>::tileAddress(const std::size_t x, const std::size_t y) const
+{
+   return m_origin + static_cast<std::ptrdiff_t>(x) * m_stepX + static_cast<std::ptrdiff_t>(y) * m_stepY;
+}
+
+#endif // MAPVIEW_HPP
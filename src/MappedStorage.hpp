@@ -0,0 +1,371 @@
+#ifndef MAPPEDSTORAGE_HPP
+#define MAPPEDSTORAGE_HPP
+
+#include <new>
+#include <string>
+#include <cstdlib>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <algorithm>
+#include <stdexcept>
+#include <type_traits>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define MAPPEDSTORAGE_MMAP 1
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+// How much of a layer is going to be written. Anonymous mappings of dense layers ask for transparent huge pages, those
+// of sparse layers stay on 4 KiB pages, as a single written tile would otherwise back a whole 2 MiB page.
+enum class MappedDensity : std::uint8_t
+{
+   Dense,
+   Sparse
+};
+
+// Storage backend for the layers of large worlds. All tiles are in one memory mapping, either of a file or, if no file
+// is given, of anonymous memory the kernel only backs once it is written to. Either way, pages nobody touches cost
+// nothing, and with a file the kernel can write pages back and drop them when memory gets tight instead of failing.
+// Only the layers themselves live here: the snapshots published to the pathfinding threads and the search state of
+// each of those threads are still plain memory of a size proportional to the world.
+//
+// The tiles are laid out like ChunkedStorage: square chunks of ChunkEdgeTiles squared tiles, row-major within a chunk,
+// and the chunks row by row. A 64x64 chunk is a whole number of 4 KiB pages for any tile size, so a neighbourhood
+// faults in a few pages instead of one per row, and chunks match the chunks of DirtyChunkMask and ChunkedSnapshot.
+// Sweeps should go through forEachInRect, or visit tiles by offsetOf, to fault in every page only once.
+//
+// A file is only scratch space: it is created or truncated, and removed again as soon as it is mapped. Fill values
+// whose bytes are all zero are not written, so layers filled with T{} start out without a single page in memory.
+// Copies are always anonymous. Platforms without mmap get heap memory in place of anonymous mappings and cannot map
+// files at all, asking for a file there throws.
+template<typename T, std::size_t ChunkEdgeTiles = 64>
+class MappedStorage final
+{
+public:
+   static constexpr std::size_t m_chunkEdgeTiles = ChunkEdgeTiles;
+   static constexpr std::size_t m_chunkTiles = ChunkEdgeTiles * ChunkEdgeTiles;
+
+   static_assert((ChunkEdgeTiles & (ChunkEdgeTiles - 1)) == 0, "Chunk edge must be a power of two");
+   static_assert(std::is_trivially_copyable_v<T>, "Tiles live in the mapping as plain bytes");
+
+   MappedStorage(const std::size_t width, const std::size_t height, const T& fill, const std::string& filePath = {}, const MappedDensity density = MappedDensity::Dense);
+
+   MappedStorage(const MappedStorage& other);
+   MappedStorage(MappedStorage&& other) noexcept;
+
+   ~MappedStorage();
+
+   MappedStorage& operator=(const MappedStorage& other);
+   MappedStorage& operator=(MappedStorage&& other) noexcept;
+
+   const T& at(const std::size_t x, const std::size_t y) const;
+   T& at(const std::size_t x, const std::size_t y);
+
+   // Visits chunk by chunk, asking the kernel to read ahead the next row of chunks of the rect while visiting one
+   template<typename F>
+   void forEachInRect(const std::size_t beginX, const std::size_t beginY, const std::size_t endX, const std::size_t endY, F&& f) const;
+
+   template<typename F>
+   void forEachInRect(const std::size_t beginX, const std::size_t beginY, const std::size_t endX, const std::size_t endY, F&& f);
+
+   // Position of a tile in the mapping, visiting tiles in ascending order touches every page once
+   std::size_t offsetOf(const std::size_t x, const std::size_t y) const;
+
+   std::size_t widthChunks() const;
+   std::size_t heightChunks() const;
+
+   bool isFileBacked() const;
+
+private:
+   std::size_t m_widthChunks;
+   std::size_t m_heightChunks;
+
+   T* m_tiles = nullptr;
+   std::size_t m_mappedBytes = 0;
+
+   bool m_fileBacked = false;
+
+   MappedDensity m_density;
+
+   void map(const std::string& filePath);
+   void unmap();
+
+   // Hint that the tiles of chunks [beginChunkIndex, endChunkIndex) are needed soon
+   void willNeed(const std::size_t beginChunkIndex, const std::size_t endChunkIndex) const;
+
+   template<typename Self, typename F>
+   static void forEachInRectOf(Self& self, const std::size_t beginX, const std::size_t beginY, const std::size_t endX, const std::size_t endY, F& f);
+};
+
+template<typename T, std::size_t ChunkEdgeTiles>
+MappedStorage<T, ChunkEdgeTiles>::MappedStorage(const std::size_t width, const std::size_t height, const T& fill, const std::string& filePath, const MappedDensity density):
+   m_widthChunks {(width  + ChunkEdgeTiles - 1) / ChunkEdgeTiles},
+   m_heightChunks{(height + ChunkEdgeTiles - 1) / ChunkEdgeTiles},
+   m_density{density}
+{
+   map(filePath);
+
+   const auto tileCount = m_mappedBytes / sizeof(T);
+
+   static const T zero{};
+
+   if (std::memcmp(&fill, &zero, sizeof(T)) != 0)
+   {
+      std::fill(m_tiles, m_tiles + tileCount, fill);
+   }
+}
+
+template<typename T, std::size_t ChunkEdgeTiles>
+MappedStorage<T, ChunkEdgeTiles>::MappedStorage(const MappedStorage& other):
+   m_widthChunks{other.m_widthChunks},
+   m_heightChunks{other.m_heightChunks},
+   m_density{other.m_density}
+{
+   map({});
+
+   if (m_mappedBytes > 0)
+   {
+      std::memcpy(m_tiles, other.m_tiles, m_mappedBytes);
+   }
+}
+
+template<typename T, std::size_t ChunkEdgeTiles>
+MappedStorage<T, ChunkEdgeTiles>::MappedStorage(MappedStorage&& other) noexcept:
+   m_widthChunks{other.m_widthChunks},
+   m_heightChunks{other.m_heightChunks},
+   m_tiles{std::exchange(other.m_tiles, nullptr)},
+   m_mappedBytes{std::exchange(other.m_mappedBytes, 0)},
+   m_fileBacked{std::exchange(other.m_fileBacked, false)},
+   m_density{other.m_density}
+{
+   // NOP
+}
+
+template<typename T, std::size_t ChunkEdgeTiles>
+MappedStorage<T, ChunkEdgeTiles>::~MappedStorage()
+{
+   unmap();
+}
+
+template<typename T, std::size_t ChunkEdgeTiles>
+MappedStorage<T, ChunkEdgeTiles>& MappedStorage<T, ChunkEdgeTiles>::operator=(const MappedStorage& other)
+{
+   if (this != &other)
+   {
+      *this = MappedStorage{other};
+   }
+
+   return *this;
+}
+
+template<typename T, std::size_t ChunkEdgeTiles>
+MappedStorage<T, ChunkEdgeTiles>& MappedStorage<T, ChunkEdgeTiles>::operator=(MappedStorage&& other) noexcept
+{
+   if (this != &other)
+   {
+      unmap();
+
+      m_widthChunks = other.m_widthChunks;
+      m_heightChunks = other.m_heightChunks;
+      m_tiles = std::exchange(other.m_tiles, nullptr);
+      m_mappedBytes = std::exchange(other.m_mappedBytes, 0);
+      m_fileBacked = std::exchange(other.m_fileBacked, false);
+      m_density = other.m_density;
+   }
+
+   return *this;
+}
+
+template<typename T, std::size_t ChunkEdgeTiles>
+const T& MappedStorage<T, ChunkEdgeTiles>::at(const std::size_t x, const std::size_t y) const
+{
+   return m_tiles[offsetOf(x, y)];
+}
+
+template<typename T, std::size_t ChunkEdgeTiles>
+T& MappedStorage<T, ChunkEdgeTiles>::at(const std::size_t x, const std::size_t y)
+{
+   return m_tiles[offsetOf(x, y)];
+}
+
+template<typename T, std::size_t ChunkEdgeTiles>
+template<typename F>
+void MappedStorage<T, ChunkEdgeTiles>::forEachInRect(const std::size_t beginX, const std::size_t beginY, const std::size_t endX, const std::size_t endY, F&& f) const
+{
+   forEachInRectOf(*this, beginX, beginY, endX, endY, f);
+}
+
+template<typename T, std::size_t ChunkEdgeTiles>
+template<typename F>
+void MappedStorage<T, ChunkEdgeTiles>::forEachInRect(const std::size_t beginX, const std::size_t beginY, const std::size_t endX, const std::size_t endY, F&& f)
+{
+   forEachInRectOf(*this, beginX, beginY, endX, endY, f);
+}
+
+template<typename T, std::size_t ChunkEdgeTiles>
+std::size_t MappedStorage<T, ChunkEdgeTiles>::offsetOf(const std::size_t x, const std::size_t y) const
+{
+   const auto chunkIndex = (y / ChunkEdgeTiles) * m_widthChunks + (x / ChunkEdgeTiles);
+
+   return chunkIndex * m_chunkTiles + (y % ChunkEdgeTiles) * ChunkEdgeTiles + (x % ChunkEdgeTiles);
+}
+
+template<typename T, std::size_t ChunkEdgeTiles>
+std::size_t MappedStorage<T, ChunkEdgeTiles>::widthChunks() const
+{
+   return m_widthChunks;
+}
+
+template<typename T, std::size_t ChunkEdgeTiles>
+std::size_t MappedStorage<T, ChunkEdgeTiles>::heightChunks() const
+{
+   return m_heightChunks;
+}
+
+template<typename T, std::size_t ChunkEdgeTiles>
+bool MappedStorage<T, ChunkEdgeTiles>::isFileBacked() const
+{
+   return m_fileBacked;
+}
+
+template<typename T, std::size_t ChunkEdgeTiles>
+void MappedStorage<T, ChunkEdgeTiles>::map(const std::string& filePath)
+{
+   const auto bytes = m_widthChunks * m_heightChunks * m_chunkTiles * sizeof(T);
+
+   if (bytes == 0)
+      return;
+
+#ifdef MAPPEDSTORAGE_MMAP
+   void* mapping = MAP_FAILED;
+
+   if (filePath.empty())
+   {
+      // Nothing is reserved up front, only written pages count against memory
+      mapping = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+
+      if (mapping == MAP_FAILED)
+         throw std::bad_alloc{};
+
+#ifdef MADV_HUGEPAGE
+      if (m_density == MappedDensity::Dense)
+      {
+         madvise(mapping, bytes, MADV_HUGEPAGE);
+      }
+#endif
+   }
+   else
+   {
+      const auto fileDescriptor = open(filePath.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+
+      if (fileDescriptor < 0)
+         throw std::runtime_error{"Could not open \"" + filePath + "\" for mapping"};
+
+      // Sparse, blocks are only allocated on disk once pages are written back
+      if (ftruncate(fileDescriptor, static_cast<off_t>(bytes)) == 0)
+      {
+         mapping = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fileDescriptor, 0);
+      }
+
+      close(fileDescriptor);
+      unlink(filePath.c_str());
+
+      if (mapping == MAP_FAILED)
+         throw std::runtime_error{"Could not map \"" + filePath + "\""};
+
+      // Most accesses are pathfinding and villagers reading single tiles, sweeps ask for read ahead themselves
+      madvise(mapping, bytes, MADV_RANDOM);
+
+      m_fileBacked = true;
+   }
+
+   m_tiles = static_cast<T*>(mapping);
+#else
+   if (filePath.empty() == false)
+      throw std::runtime_error{"Could not map \"" + filePath + "\", layer files are not supported on this platform"};
+
+   m_tiles = static_cast<T*>(std::calloc(bytes, 1));
+
+   if (m_tiles == nullptr)
+      throw std::bad_alloc{};
+#endif
+
+   m_mappedBytes = bytes;
+}
+
+template<typename T, std::size_t ChunkEdgeTiles>
+void MappedStorage<T, ChunkEdgeTiles>::unmap()
+{
+   if (m_tiles == nullptr)
+      return;
+
+#ifdef MAPPEDSTORAGE_MMAP
+   munmap(m_tiles, m_mappedBytes);
+#else
+   std::free(m_tiles);
+#endif
+
+   m_tiles = nullptr;
+   m_mappedBytes = 0;
+   m_fileBacked = false;
+}
+
+template<typename T, std::size_t ChunkEdgeTiles>
+void MappedStorage<T, ChunkEdgeTiles>::willNeed(const std::size_t beginChunkIndex, const std::size_t endChunkIndex) const
+{
+#ifdef MAPPEDSTORAGE_MMAP
+   // Anonymous pages are not read from anywhere, there is nothing to read ahead
+   if (m_fileBacked == false || beginChunkIndex >= endChunkIndex)
+      return;
+
+   madvise(m_tiles + beginChunkIndex * m_chunkTiles, (endChunkIndex - beginChunkIndex) * m_chunkTiles * sizeof(T), MADV_WILLNEED);
+#endif
+}
+
+template<typename T, std::size_t ChunkEdgeTiles>
+template<typename Self, typename F>
+void MappedStorage<T, ChunkEdgeTiles>::forEachInRectOf(Self& self, const std::size_t beginX, const std::size_t beginY, const std::size_t endX, const std::size_t endY, F& f)
+{
+   if (beginX >= endX || beginY >= endY)
+      return;
+
+   const auto beginChunkX = beginX / ChunkEdgeTiles;
+   const auto endChunkX   = (endX - 1) / ChunkEdgeTiles + 1;
+   const auto endChunkY   = (endY - 1) / ChunkEdgeTiles + 1;
+
+   for (auto chunkY = beginY / ChunkEdgeTiles; chunkY < endChunkY; ++chunkY)
+   {
+      // The chunks of the rect in one chunk row are next to each other in the mapping
+      if (chunkY + 1 < endChunkY)
+      {
+         self.willNeed((chunkY + 1) * self.m_widthChunks + beginChunkX, (chunkY + 1) * self.m_widthChunks + endChunkX);
+      }
+
+      const auto chunkBeginY = std::max(beginY, chunkY * ChunkEdgeTiles);
+      const auto chunkEndY   = std::min(endY, (chunkY + 1) * ChunkEdgeTiles);
+
+      for (auto chunkX = beginChunkX; chunkX < endChunkX; ++chunkX)
+      {
+         const auto chunkBeginX = std::max(beginX, chunkX * ChunkEdgeTiles);
+         const auto chunkEndX   = std::min(endX, (chunkX + 1) * ChunkEdgeTiles);
+
+         auto* chunk = self.m_tiles + (chunkY * self.m_widthChunks + chunkX) * m_chunkTiles;
+
+         for (auto y = chunkBeginY; y < chunkEndY; ++y)
+         {
+            auto* row = chunk + (y % ChunkEdgeTiles) * ChunkEdgeTiles;
+
+            for (auto x = chunkBeginX; x < chunkEndX; ++x)
+            {
+               f(x, y, row[x % ChunkEdgeTiles]);
+            }
+         }
+      }
+   }
+}
+
+#endif // MAPPEDSTORAGE_HPP
@@ -0,0 +1,100 @@
+#ifndef OCCUPANCYGRID_HPP
+#define OCCUPANCYGRID_HPP
+
+#include <atomic>
+#include <memory>
+#include <cstdint>
+#include <algorithm>
+
+// Number of villagers per world tile. Villagers are ticked by several workers at once, and a villager can enter a
+// tile of another worker's region, so the counters are atomics: entering and leaving never take a lock, and since
+// only additions and subtractions are done, the counts after a tick do not depend on the order villagers were
+// ticked in.
+//
+// The tiles form a uniform grid, so neighbourhood queries are plain sums over a rectangle of tiles.
+class OccupancyGrid final
+{
+public:
+   OccupancyGrid(const std::size_t width, const std::size_t height);
+
+   OccupancyGrid(const OccupancyGrid&) = delete;
+   OccupancyGrid(OccupancyGrid&&) noexcept = default;
+
+   ~OccupancyGrid() = default;
+
+   OccupancyGrid& operator=(const OccupancyGrid&) = delete;
+   OccupancyGrid& operator=(OccupancyGrid&&) noexcept = default;
+
+   void enter(const std::size_t x, const std::size_t y);
+   void leave(const std::size_t x, const std::size_t y);
+
+   std::uint32_t at(const std::size_t x, const std::size_t y) const;
+
+   // Villagers on all tiles at most radius tiles away from (x, y) on either axis, clipped to the grid
+   std::uint32_t countAround(const std::size_t x, const std::size_t y, const std::size_t radius) const;
+
+   std::size_t width() const;
+   std::size_t height() const;
+
+private:
+   std::size_t m_width;
+   std::size_t m_height;
+
+   // Only the counts themselves are shared between threads, relaxed ordering is enough
+   std::unique_ptr<std::atomic<std::uint32_t>[]> m_counts;
+};
+
+inline OccupancyGrid::OccupancyGrid(const std::size_t width, const std::size_t height):
+   m_width{width},
+   m_height{height},
+   m_counts{std::make_unique<std::atomic<std::uint32_t>[]>(width * height)}
+{
+   // NOP
+}
+
+inline void OccupancyGrid::enter(const std::size_t x, const std::size_t y)
+{
+   m_counts[y * m_width + x].fetch_add(1, std::memory_order_relaxed);
+}
+
+inline void OccupancyGrid::leave(const std::size_t x, const std::size_t y)
+{
+   m_counts[y * m_width + x].fetch_sub(1, std::memory_order_relaxed);
+}
+
+inline std::uint32_t OccupancyGrid::at(const std::size_t x, const std::size_t y) const
+{
+   return m_counts[y * m_width + x].load(std::memory_order_relaxed);
+}
+
+inline std::uint32_t OccupancyGrid::countAround(const std::size_t x, const std::size_t y, const std::size_t radius) const
+{
+   const auto beginX = (x > radius) ? (x - radius) : 0;
+   const auto beginY = (y > radius) ? (y - radius) : 0;
+   const auto endX = std::min(x + radius + 1, m_width);
+   const auto endY = std::min(y + radius + 1, m_height);
+
+   std::uint32_t count = 0;
+
+   for (auto tileY = beginY; tileY < endY; ++tileY)
+   {
+      for (auto tileX = beginX; tileX < endX; ++tileX)
+      {
+         count += at(tileX, tileY);
+      }
+   }
+
+   return count;
+}
+
+inline std::size_t OccupancyGrid::width() const
+{
+   return m_width;
+}
+
+inline std::size_t OccupancyGrid::height() const
+{
+   return m_height;
+}
+
+#endif // OCCUPANCYGRID_HPP
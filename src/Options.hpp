@@ -2,6 +2,8 @@
 #define OPTIONS_HPP
 
 #include <cstdlib>
+#include <cstdint>
+#include <string>
 
 struct Options final
 {
@@ -10,9 +12,26 @@ struct Options final
 
    int targetFPS = 60; // 0 to disable
 
+   int simulationTicksPerSec = 60; // Every tick advances the simulation by 1 / simulationTicksPerSec seconds
+   int simulationSpeed = 1; // Simulated seconds per real second, 0 for as fast as possible
+   int simulationFrameBudgetMillisec = 10; // Time spent ticking before handing a new state to the renderer
+
+   bool deterministicSimulation = false; // Apply paths at fixed ticks instead of whenever they are done
+
+   bool headless = false; // Simulate without a window, then write the results to outputPath
+   int simulationSeconds = 60; // Only used if headless
+   std::string outputPath = "output"; // Only used if headless, directory is created if needed
+   bool checkAllocations = false; // Only used if headless, fail if the simulation thread allocated during the second half of the run, needs DESIREPATHSIM_COUNT_ALLOCATIONS
+
+   std::uint64_t seed = 0; // 0 for random
+
+   std::string layerDirectory; // Map the world layers from scratch files in this directory instead of memory, empty for memory. Snapshots and pathfinding state stay in memory
+
    bool removeStreetsAfterGeneration = false;
 
    std::size_t villagerCount = 1000;
+   std::size_t villagerCapacity = 100000; // Maximum number of villagers alive at the same time, all memory is allocated up front
+   int villagerSpawnRatePerSec = 0; // Villagers to spawn per simulated second until the capacity is reached
 
    std::size_t voronoiCentroidCountPerLevel = 6;
    int voronoiSubdivideProbabilityLevel1 = 90;
@@ -27,10 +46,27 @@ struct Options final
    bool placeLargeTrees = true;
    bool placeSmallTrees = true;
 
-   std::size_t pathfindingThreadCount = 4;
+   std::size_t pathfindingThreadCount = 4; // 0 for adaptive
+   std::size_t pathfindingMinThreadCount = 1; // Only used if adaptive
+   std::size_t pathfindingMaxThreadCount = 0; // Only used if adaptive, 0 for number of hardware threads
+   bool mortonPathfinding = false; // Lay out the search state of every pathfinding thread in Z-order instead of row by row
+   int pathCoalesceTicks = 30; // Requests may join a pending search for the same tiles on a world snapshot up to this many ticks older, ignored if deterministic
+
+   std::size_t tickThreadCount = 1; // Results do not depend on this
+
+   bool eventDrivenMovement = false; // Only process villagers when they reach a tile instead of moving all every tick
+   bool villagerLOD = false; // Move villagers outside of the camera view at a lower rate, same tiles and stress but applied later, so desire paths differ slightly
+   bool analyticTrips = false; // Walk every path within a single tick, only the resulting desire paths are meaningful
+
+   int congestionCost = 0; // Traversal cost added per villager on or next to a tile, 0 to ignore crowding
+
+   bool packedTileRecords = false; // Let pathfinding read tile type and costs from one 32 bit record per tile
 
    bool paveDesirePaths = true;
    bool decayDesirePaths = true;
+
+   int convergenceWindowSeconds = 0; // Simulated seconds desire paths are watched for change, 0 to disable
+   int convergenceThresholdPerMille = 10; // Less change than this over the window counts as converged, headless runs stop then
 };
 
 #endif // OPTIONS_HPP
@@ -0,0 +1,206 @@
+#ifndef PACKEDBITMAP_HPP
+#define PACKEDBITMAP_HPP
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Bitmap with one bit per tile instead of one byte. Every row starts at a new word, bit x % 64 of word x / 64 holds
+// tile x. The bits past the width in the last word of a row are always 0, so operations can work on whole words
+// without caring about the edge.
+class PackedBitmap final
+{
+public:
+   using Word = std::uint64_t;
+
+   static constexpr std::size_t m_wordBits = 64;
+
+   PackedBitmap(const std::size_t width, const std::size_t height, const std::uint8_t fill = 0);
+
+   PackedBitmap(const PackedBitmap&) = default;
+   PackedBitmap(PackedBitmap&&) noexcept = default;
+
+   ~PackedBitmap() = default;
+
+   PackedBitmap& operator=(const PackedBitmap&) = default;
+   PackedBitmap& operator=(PackedBitmap&&) noexcept = default;
+
+   std::uint8_t at(const std::size_t x, const std::size_t y) const;
+   void set(const std::size_t x, const std::size_t y, const std::uint8_t value);
+
+   std::size_t width() const;
+   std::size_t height() const;
+
+   std::size_t wordsPerRow() const;
+
+   const Word* row(const std::size_t y) const;
+   Word* row(const std::size_t y);
+
+   // Bits of the last word of a row that belong to tiles
+   Word lastWordMask() const;
+   static Word lastWordMask(const std::size_t width);
+
+private:
+   std::size_t m_width;
+   std::size_t m_height;
+
+   std::size_t m_wordsPerRow;
+
+   std::vector<Word> m_words;
+};
+
+inline PackedBitmap::PackedBitmap(const std::size_t width, const std::size_t height, const std::uint8_t fill):
+   m_width{width},
+   m_height{height},
+   m_wordsPerRow{(width + m_wordBits - 1) / m_wordBits},
+   m_words(m_wordsPerRow * height, (fill != 0) ? ~Word{0} : Word{0})
+{
+   if (fill != 0 && m_wordsPerRow > 0)
+   {
+      for (std::size_t y = 0; y < m_height; ++y)
+      {
+         row(y)[m_wordsPerRow - 1] &= lastWordMask();
+      }
+   }
+}
+
+inline std::uint8_t PackedBitmap::at(const std::size_t x, const std::size_t y) const
+{
+   return static_cast<std::uint8_t>((row(y)[x / m_wordBits] >> (x % m_wordBits)) & 1);
+}
+
+inline void PackedBitmap::set(const std::size_t x, const std::size_t y, const std::uint8_t value)
+{
+   const auto bit = Word{1} << (x % m_wordBits);
+
+   if (value != 0)
+   {
+      row(y)[x / m_wordBits] |= bit;
+   }
+   else
+   {
+      row(y)[x / m_wordBits] &= ~bit;
+   }
+}
+
+inline std::size_t PackedBitmap::width() const
+{
+   return m_width;
+}
+
+inline std::size_t PackedBitmap::height() const
+{
+   return m_height;
+}
+
+inline std::size_t PackedBitmap::wordsPerRow() const
+{
+   return m_wordsPerRow;
+}
+
+inline const PackedBitmap::Word* PackedBitmap::row(const std::size_t y) const
+{
+   return m_words.data() + y * m_wordsPerRow;
+}
+
+inline PackedBitmap::Word* PackedBitmap::row(const std::size_t y)
+{
+   return m_words.data() + y * m_wordsPerRow;
+}
+
+inline PackedBitmap::Word PackedBitmap::lastWordMask() const
+{
+   return lastWordMask(m_width);
+}
+
+inline PackedBitmap::Word PackedBitmap::lastWordMask(const std::size_t width)
+{
+   const auto usedBits = width % m_wordBits;
+
+   return (usedBits == 0) ? ~Word{0} : ((Word{1} << usedBits) - 1);
+}
+
+// Word operations on rows of a PackedBitmap, used by BitmapPipeline
+namespace PackedRow
+{
+using Word = PackedBitmap::Word;
+
+// Word of a row with words outside of the row reading as 0
+inline Word wordAt(const Word* row, const std::size_t wordsPerRow, const std::ptrdiff_t wordIndex)
+{
+   if (wordIndex < 0 || wordIndex >= static_cast<std::ptrdiff_t>(wordsPerRow))
+      return 0;
+
+   return row[wordIndex];
+}
+
+// Word wordIndex of the row moved by deltaX tiles, bit x holds tile x - deltaX. Reads the words up to
+// (|deltaX| + 63) / 64 + 1 before and after wordIndex.
+inline Word shiftedWord(const Word* row, const std::size_t wordsPerRow, const std::size_t wordIndex, const int deltaX)
+{
+   constexpr auto wordBits = static_cast<std::ptrdiff_t>(PackedBitmap::m_wordBits);
+
+   const auto firstBit = static_cast<std::ptrdiff_t>(wordIndex) * wordBits - deltaX;
+
+   const auto firstWordIndex = (firstBit >= 0) ? (firstBit / wordBits) : -((-firstBit + wordBits - 1) / wordBits);
+   const auto bitOffset = firstBit - firstWordIndex * wordBits;
+
+   auto word = wordAt(row, wordsPerRow, firstWordIndex) >> bitOffset;
+
+   if (bitOffset != 0)
+   {
+      word |= wordAt(row, wordsPerRow, firstWordIndex + 1) << (wordBits - bitOffset);
+   }
+
+   return word;
+}
+
+// Bit x holds tile x - 1
+inline Word westNeighbors(const Word* row, const std::size_t wordIndex)
+{
+   return (row[wordIndex] << 1) | ((wordIndex > 0) ? (row[wordIndex - 1] >> (PackedBitmap::m_wordBits - 1)) : 0);
+}
+
+// Bit x holds tile x + 1
+inline Word eastNeighbors(const Word* row, const std::size_t wordsPerRow, const std::size_t wordIndex)
+{
+   return (row[wordIndex] >> 1) | ((wordIndex + 1 < wordsPerRow) ? (row[wordIndex + 1] << (PackedBitmap::m_wordBits - 1)) : 0);
+}
+
+inline void setBits(Word* row, const std::size_t beginX, const std::size_t endX)
+{
+   for (auto x = beginX; x < endX; ++x)
+   {
+      row[x / PackedBitmap::m_wordBits] |= Word{1} << (x % PackedBitmap::m_wordBits);
+   }
+}
+
+// Returns combine(center, anyNeighbor, allNeighbors) for a word of rowCenter, reads the words before and after
+// wordIndex as well
+template<typename F>
+Word combineNeighborhood(const Word* rowAbove, const Word* rowCenter, const Word* rowBelow, const std::size_t wordsPerRow, const std::size_t wordIndex, const bool includeDiagonals, F&& combine)
+{
+   const auto west  = westNeighbors(rowCenter, wordIndex);
+   const auto east  = eastNeighbors(rowCenter, wordsPerRow, wordIndex);
+   const auto north = rowAbove[wordIndex];
+   const auto south = rowBelow[wordIndex];
+
+   auto anyNeighbor  = west | east | north | south;
+   auto allNeighbors = west & east & north & south;
+
+   if (includeDiagonals)
+   {
+      const auto northWest = westNeighbors(rowAbove, wordIndex);
+      const auto northEast = eastNeighbors(rowAbove, wordsPerRow, wordIndex);
+      const auto southWest = westNeighbors(rowBelow, wordIndex);
+      const auto southEast = eastNeighbors(rowBelow, wordsPerRow, wordIndex);
+
+      anyNeighbor  |= northWest | northEast | southWest | southEast;
+      allNeighbors &= northWest & northEast & southWest & southEast;
+   }
+
+   return combine(rowCenter[wordIndex], anyNeighbor, allNeighbors);
+}
+} // namespace PackedRow
+
+#endif // PACKEDBITMAP_HPP
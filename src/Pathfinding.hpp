@@ -5,35 +5,45 @@
 #include <cassert>
 #include <algorithm>
 #include <memory>
+#include <limits>
+#include <cstdint>
+#include <cstddef>
 
 #include "Util.hpp"
+#include "GridIndex.hpp"
+#include "HugePageAllocator.hpp"
 
-class Pathfinder final
+// A* on a grid of width x height tiles with 8-connected neighbours. The per-tile search state is laid out by NodeIndex,
+// see GridIndex.hpp.
+template<typename NodeIndex>
+class BasicPathfinder final
 {
 private:
+   // 16 bytes per tile, every pathfinding thread keeps one per tile of the world. Nodes refer to each other by their
+   // index in m_pathNodeMap, the coordinates of a node follow from its index.
    struct PathNode final
    {
-      PathNode* m_parent = nullptr;
+      static constexpr std::uint32_t m_noNode = std::numeric_limits<std::uint32_t>::max();
 
-      std::size_t m_x = 0;
-      std::size_t m_y = 0;
+      // Values of m_openListIndex for nodes not in the open list
+      static constexpr std::uint32_t m_unvisited = std::numeric_limits<std::uint32_t>::max();
+      static constexpr std::uint32_t m_closed = m_unvisited - 1;
 
-      bool m_inOpenList = false;
-      bool m_closed = false;
+      std::uint32_t m_parent = m_noNode;
 
-      std::size_t m_openListIndex = 0;
+      std::uint32_t m_openListIndex = m_unvisited;
 
       std::int32_t m_f = 0;
       std::int32_t m_g = 0;
-      std::int32_t m_h = 0;
 
-      PathNode() = default;
+      bool isClosed() const
+      {
+         return (m_openListIndex == m_closed);
+      }
 
-      PathNode(const std::size_t x, const std::size_t y):
-         m_x{x},
-         m_y{y}
+      bool isInOpenList() const
       {
-         // NOP
+         return (m_openListIndex < m_closed);
       }
    };
 
@@ -62,25 +72,22 @@ private:
    std::size_t m_width;
    std::size_t m_height;
 
-   std::vector<PathNode> m_pathNodeMap;
+   NodeIndex m_nodeIndex;
+
+   std::vector<PathNode, HugePageAllocator<PathNode>> m_pathNodeMap;
 
-   std::vector<PathNode*> m_openList;
+   // Indices into m_pathNodeMap
+   std::vector<std::uint32_t> m_openList;
 
 public:
-   Pathfinder(const std::size_t width, const std::size_t height):
+   BasicPathfinder(const std::size_t width, const std::size_t height):
       m_width{width},
-      m_height{height}
+      m_height{height},
+      m_nodeIndex{width, height}
    {
-      m_pathNodeMap.resize(m_width * m_height);
+      assert(m_nodeIndex.size() < PathNode::m_noNode);
 
-      for (std::size_t y = 0; y < m_height; ++y)
-      {
-         for (std::size_t x = 0; x < m_width; ++x)
-         {
-            m_pathNodeMap[y * m_width + x].m_x = x;
-            m_pathNodeMap[y * m_width + x].m_y = y;
-         }
-      }
+      m_pathNodeMap.resize(m_nodeIndex.size());
    }
 
    template<typename CanTraverseCallable = decltype(alwaysTraversable), typename TraversalCostCallable = decltype(zeroCost), typename HeuristicCallable = decltype(defaultHeuristic)>
@@ -94,16 +101,15 @@ public:
    {
       bool success = false;
 
-      auto& startPathNode = getPathNodeAt(startX, startY);
-      auto& endPathNode   = getPathNodeAt(endX  , endY  );
+      const auto startPathNodeIndex = static_cast<std::uint32_t>(m_nodeIndex(startX, startY));
+      const auto endPathNodeIndex   = static_cast<std::uint32_t>(m_nodeIndex(endX  , endY  ));
 
       // Make some room for the nodes using heuristic distance
-      m_openList.reserve(std::max(absDiff(startPathNode.m_x, endPathNode.m_x), absDiff(startPathNode.m_y, endPathNode.m_y)));
+      m_openList.reserve(std::max(absDiff(startX, endX), absDiff(startY, endY)));
 
-      m_openList.emplace_back(&startPathNode);
+      m_openList.emplace_back(startPathNodeIndex);
 
-      startPathNode.m_inOpenList = true;
-      startPathNode.m_openListIndex = 0;
+      m_pathNodeMap[startPathNodeIndex].m_openListIndex = 0;
 
       // As we work through the open, we do not pop anything from the front, instead we increase the starting position.
       // This ensures consistent indices and no overhead caused by memory shifts when popping. It comes with the cost of
@@ -113,49 +119,55 @@ public:
 
       while (openListStartingPosition < m_openList.size())
       {
-         PathNode& smallestFPathNode = *m_openList[openListStartingPosition];
+         const auto smallestFPathNodeIndex = m_openList[openListStartingPosition];
+
+         PathNode& smallestFPathNode = m_pathNodeMap[smallestFPathNodeIndex];
 
          openListStartingPosition += 1;
 
-         smallestFPathNode.m_inOpenList = false;
-         smallestFPathNode.m_closed = true;
+         smallestFPathNode.m_openListIndex = PathNode::m_closed;
 
-         if (smallestFPathNode.m_x == endPathNode.m_x && smallestFPathNode.m_y == endPathNode.m_y)
+         if (smallestFPathNodeIndex == endPathNodeIndex)
          {
             success = true;
             break;
          }
 
-         auto handleAdjacentPathNode = [&] (PathNode& adjacentPathNode)
+         const auto [smallestFX, smallestFY] = m_nodeIndex.coordinates(smallestFPathNodeIndex);
+
+         auto handleAdjacentPathNode = [&] (const int dx, const int dy)
          {
-            if (adjacentPathNode.m_closed || canTraverse(smallestFPathNode.m_x, smallestFPathNode.m_y, adjacentPathNode.m_x, adjacentPathNode.m_y) == false)
+            const auto adjacentX = smallestFX + static_cast<std::ptrdiff_t>(dx);
+            const auto adjacentY = smallestFY + static_cast<std::ptrdiff_t>(dy);
+
+            const auto adjacentPathNodeIndex = static_cast<std::uint32_t>(m_nodeIndex.neighbor(smallestFPathNodeIndex, smallestFX, smallestFY, dx, dy));
+
+            PathNode& adjacentPathNode = m_pathNodeMap[adjacentPathNodeIndex];
+
+            if (adjacentPathNode.isClosed() || canTraverse(smallestFX, smallestFY, adjacentX, adjacentY) == false)
                return;
 
             // G is the distance from the start node to this node plus any costs for traversing this node
-            const std::int32_t tempG = smallestFPathNode.m_g + getTraversalCost(smallestFPathNode.m_x, smallestFPathNode.m_y, adjacentPathNode.m_x, adjacentPathNode.m_y);
+            const std::int32_t tempG = smallestFPathNode.m_g + getTraversalCost(smallestFX, smallestFY, adjacentX, adjacentY);
 
-            if (adjacentPathNode.m_inOpenList == false)
+            if (adjacentPathNode.isInOpenList() == false)
             {
-               adjacentPathNode.m_parent = &smallestFPathNode;
+               adjacentPathNode.m_parent = smallestFPathNodeIndex;
 
                // Set G
                adjacentPathNode.m_g = tempG;
 
-               // H is the heuristic distance to the end node, it has to be less than or equal to the actual cost neccessary
-               adjacentPathNode.m_h = heuristic(adjacentPathNode.m_x, adjacentPathNode.m_y, endX, endY);
-
-               // F is the sum of G and H
-               adjacentPathNode.m_f = adjacentPathNode.m_g + adjacentPathNode.m_h;
-
-               adjacentPathNode.m_inOpenList = true;
+               // F is the sum of G and H, the heuristic distance to the end node, which has to be less than or equal to
+               // the actual cost neccessary
+               adjacentPathNode.m_f = adjacentPathNode.m_g + heuristic(adjacentX, adjacentY, endX, endY);
 
                // Find out where to insert
                const auto insertionPoint =
                   std::upper_bound(
                      std::begin(m_openList) + openListStartingPosition,
                      std::end(m_openList),
-                     &adjacentPathNode,
-                     [] (const auto pathNodeA, const auto pathNodeB) { return (pathNodeA->m_f < pathNodeB->m_f); }
+                     adjacentPathNode.m_f,
+                     [&] (const std::int32_t f, const std::uint32_t pathNodeIndex) { return (f < m_pathNodeMap[pathNodeIndex].m_f); }
                );
 
                if (insertionPoint == std::end(m_openList))
@@ -163,91 +175,96 @@ public:
                   // We can just push it back at the end, its value is the largest so far
 
                   // Store the index in the PathNode
-                  adjacentPathNode.m_openListIndex = m_openList.size();
+                  adjacentPathNode.m_openListIndex = static_cast<std::uint32_t>(m_openList.size());
 
-                  m_openList.emplace_back(&adjacentPathNode);
+                  m_openList.emplace_back(adjacentPathNodeIndex);
                }
                else
                {
                   const std::size_t insertionIndex = std::distance(std::begin(m_openList) + openListStartingPosition, insertionPoint) + openListStartingPosition;
 
                   // Store the new index in the PathNode
-                  adjacentPathNode.m_openListIndex = insertionIndex;
+                  adjacentPathNode.m_openListIndex = static_cast<std::uint32_t>(insertionIndex);
 
                   // Inserting into the middle
-                  m_openList.insert(insertionPoint, &adjacentPathNode);
+                  m_openList.insert(insertionPoint, adjacentPathNodeIndex);
                }
+
+               assert(m_openList.size() < PathNode::m_closed);
             }
             else
             {
                // Better G?
                if (tempG < adjacentPathNode.m_g)
                {
-                  adjacentPathNode.m_parent = &smallestFPathNode;
+                  // H stays the same
+                  const auto h = adjacentPathNode.m_f - adjacentPathNode.m_g;
+
+                  adjacentPathNode.m_parent = smallestFPathNodeIndex;
 
                   adjacentPathNode.m_g = tempG;
-                  adjacentPathNode.m_f = adjacentPathNode.m_g + adjacentPathNode.m_h;
+                  adjacentPathNode.m_f = adjacentPathNode.m_g + h;
 
                   // The entry might have to move up in the list to keep the list sorted
 
-                  auto insertionIndex = adjacentPathNode.m_openListIndex;
+                  std::size_t insertionIndex = adjacentPathNode.m_openListIndex;
 
                   // Counting downwards until we wrap around
-                  while ((--insertionIndex < (adjacentPathNode.m_openListIndex + 1)) && (insertionIndex >= openListStartingPosition))
+                  while ((--insertionIndex < (std::size_t{adjacentPathNode.m_openListIndex} + 1)) && (insertionIndex >= openListStartingPosition))
                   {
-                     if (m_openList[insertionIndex]->m_f <= adjacentPathNode.m_f)
+                     if (m_pathNodeMap[m_openList[insertionIndex]].m_f <= adjacentPathNode.m_f)
                         break; // We reached the insertion point
                   }
 
                   if (insertionIndex < adjacentPathNode.m_openListIndex)
                   {
                      // Store the new index in the PathNode
-                     adjacentPathNode.m_openListIndex = insertionIndex;
+                     adjacentPathNode.m_openListIndex = static_cast<std::uint32_t>(insertionIndex);
 
-                     m_openList.insert(std::begin(m_openList) + insertionIndex, &adjacentPathNode);
+                     m_openList.insert(std::begin(m_openList) + insertionIndex, adjacentPathNodeIndex);
                   }
                }
             }
          };
 
-         if (smallestFPathNode.m_y > 0)
+         if (smallestFY > 0)
          {
-            handleAdjacentPathNode(getPathNodeAt(smallestFPathNode.m_x, smallestFPathNode.m_y - 1));
+            handleAdjacentPathNode(0, -1);
 
-            if (smallestFPathNode.m_x > 0)
+            if (smallestFX > 0)
             {
-               handleAdjacentPathNode(getPathNodeAt(smallestFPathNode.m_x - 1, smallestFPathNode.m_y - 1));
+               handleAdjacentPathNode(-1, -1);
             }
 
-            if (smallestFPathNode.m_x < m_width - 1)
+            if (smallestFX < m_width - 1)
             {
-               handleAdjacentPathNode(getPathNodeAt(smallestFPathNode.m_x + 1, smallestFPathNode.m_y - 1));
+               handleAdjacentPathNode(1, -1);
             }
          }
 
-         if (smallestFPathNode.m_y < m_height - 1)
+         if (smallestFY < m_height - 1)
          {
-            handleAdjacentPathNode(getPathNodeAt(smallestFPathNode.m_x, smallestFPathNode.m_y + 1));
+            handleAdjacentPathNode(0, 1);
 
-            if (smallestFPathNode.m_x > 0)
+            if (smallestFX > 0)
             {
-               handleAdjacentPathNode(getPathNodeAt(smallestFPathNode.m_x - 1, smallestFPathNode.m_y + 1));
+               handleAdjacentPathNode(-1, 1);
             }
 
-            if (smallestFPathNode.m_x < m_width - 1)
+            if (smallestFX < m_width - 1)
             {
-               handleAdjacentPathNode(getPathNodeAt(smallestFPathNode.m_x + 1, smallestFPathNode.m_y + 1));
+               handleAdjacentPathNode(1, 1);
             }
          }
 
-         if (smallestFPathNode.m_x > 0)
+         if (smallestFX > 0)
          {
-            handleAdjacentPathNode(getPathNodeAt(smallestFPathNode.m_x - 1, smallestFPathNode.m_y));
+            handleAdjacentPathNode(-1, 0);
          }
 
-         if (smallestFPathNode.m_x < m_width - 1)
+         if (smallestFX < m_width - 1)
          {
-            handleAdjacentPathNode(getPathNodeAt(smallestFPathNode.m_x + 1, smallestFPathNode.m_y));
+            handleAdjacentPathNode(1, 0);
          }
       }
 
@@ -257,14 +274,9 @@ public:
 
          mapNodes.reserve(m_width + m_height);
 
-         PathNode* node = &endPathNode;
-
-         mapNodes.emplace_back(node->m_x, node->m_y);
-
-         while (node->m_parent != nullptr)
+         for (auto pathNodeIndex = endPathNodeIndex; pathNodeIndex != PathNode::m_noNode; pathNodeIndex = m_pathNodeMap[pathNodeIndex].m_parent)
          {
-            mapNodes.emplace_back(node->m_parent->m_x, node->m_parent->m_y);
-            node = node->m_parent;
+            mapNodes.emplace_back(m_nodeIndex.coordinates(pathNodeIndex));
          }
 
          std::reverse(std::begin(mapNodes), std::end(mapNodes));
@@ -280,23 +292,21 @@ public:
    }
 
 private:
-   PathNode& getPathNodeAt(const std::size_t x, const std::size_t y)
-   {
-      return m_pathNodeMap[y * m_width + x];
-   }
-
    void clearOpenList()
    {
-      for (auto* const pathNode : m_openList)
+      for (const auto pathNodeIndex : m_openList)
       {
-         pathNode->m_parent = nullptr;
+         auto& pathNode = m_pathNodeMap[pathNodeIndex];
 
-         pathNode->m_inOpenList = false;
-         pathNode->m_closed = false;
+         pathNode.m_parent = PathNode::m_noNode;
+         pathNode.m_openListIndex = PathNode::m_unvisited;
       }
 
       m_openList.clear();
    }
 };
 
+using Pathfinder       = BasicPathfinder<RowMajorIndex>;
+using MortonPathfinder = BasicPathfinder<MortonIndex>;
+
 #endif // PATHFINDING_HPP
@@ -0,0 +1,449 @@
+#include "PathfindingService.hpp"
+
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <thread>
+#include <optional>
+
+#include "WorldMap.hpp"
+#include "Util.hpp"
+
+PathfindingService::PathfindingService(const std::size_t minThreadCount, const std::size_t maxThreadCount, const std::size_t worldWidth, const std::size_t worldHeight, const std::uint64_t seed, const bool mortonNodeLayout, const std::uint64_t maxSnapshotAgeTicks):
+   m_seed{seed},
+   m_worldWidth{worldWidth},
+   m_worldHeight{worldHeight},
+   m_maxSnapshotAgeTicks{maxSnapshotAgeTicks},
+   m_pendingSearches{PoolAllocator<std::shared_ptr<Search>>{m_searchPool}},
+   m_searchesInFlight{SearchesInFlight::allocator_type{m_searchPool}},
+   m_ticketsInFlight{TicketSet::allocator_type{m_searchPool}},
+   m_cancelledTickets{TicketSet::allocator_type{m_searchPool}},
+   m_minThreadCount{std::max<std::size_t>(minThreadCount, 1)},
+   m_maxThreadCount{std::max(maxThreadCount, m_minThreadCount)},
+   m_activeThreadCount{m_maxThreadCount},
+   m_lastAdaptionTime{std::chrono::steady_clock::now()}
+{
+   m_workerFutures.reserve(m_maxThreadCount);
+
+   for (std::size_t threadIndex = 0; threadIndex < m_maxThreadCount; ++threadIndex)
+   {
+      m_workerFutures.emplace_back(std::async(std::launch::async, [this, threadIndex, mortonNodeLayout]
+      {
+         if (mortonNodeLayout)
+         {
+            workerLoop<MortonPathfinder>(threadIndex);
+         }
+         else
+         {
+            workerLoop<Pathfinder>(threadIndex);
+         }
+      }));
+   }
+}
+
+PathfindingService::~PathfindingService()
+{
+   {
+      std::lock_guard lock{m_activeThreadMutex};
+
+      m_stop.store(true);
+   }
+
+   m_activeThreadCond.notify_all();
+
+   for (auto& workerFuture : m_workerFutures)
+   {
+      workerFuture.wait();
+   }
+}
+
+PathfindingService::Search::Search(const PoolAllocator<Waiter>& allocator):
+   waiters(allocator)
+{
+   // NOP
+}
+
+PathTicket PathfindingService::submit(const PathRequest& request)
+{
+   // Keyed by villager and trip, so the endpoints do not depend on when the request is processed
+   CounterRNG pathfindingRNG{m_seed, RNGSubsystem::Pathfinding, request.villagerId, request.tripIndex};
+
+   auto search = std::allocate_shared<Search>(PoolAllocator<Search>{m_searchPool}, PoolAllocator<Waiter>{m_searchPool});
+
+   std::tie(search->spawn, search->destination) = pickEndpoints(*request.worldSnapshot, pathfindingRNG);
+
+   const auto ticket = m_nextTicket++;
+
+   {
+      std::lock_guard lock{m_ticketsMutex};
+
+      m_ticketsInFlight.insert(ticket);
+   }
+
+   std::lock_guard lock{m_searchesMutex};
+
+   auto& searchInFlight = m_searchesInFlight[getSearchKey(*search)];
+
+   // A search on an older snapshot could give a different path, so it is only joined if the world is still the same
+   // or not older than allowed
+   const auto canJoin = (searchInFlight != nullptr) && (searchInFlight->worldSnapshot == request.worldSnapshot || searchInFlight->worldSnapshot->tickIndex + m_maxSnapshotAgeTicks >= request.worldSnapshot->tickIndex);
+
+   if (canJoin)
+   {
+      searchInFlight->waiters.emplace_back(Waiter{ticket, request.villager});
+
+      m_savedSearchCount.fetch_add(1, std::memory_order_relaxed);
+   }
+   else
+   {
+      search->worldSnapshot = request.worldSnapshot;
+      search->submitTime = std::chrono::steady_clock::now();
+      search->waiters.emplace_back(Waiter{ticket, request.villager});
+
+      searchInFlight = search;
+
+      m_pendingSearches.push(std::move(search));
+   }
+
+   return ticket;
+}
+
+void PathfindingService::cancel(const PathTicket ticket)
+{
+   if (ticket == 0)
+      return;
+
+   std::lock_guard lock{m_ticketsMutex};
+
+   if (m_ticketsInFlight.count(ticket) == 0)
+      return; // Already handed out or dropped, nothing would ever take it out of the cancelled set again
+
+   m_cancelledTickets.insert(ticket);
+}
+
+void PathfindingService::drainCompletions(std::vector<PathCompletion>& completions)
+{
+   adaptActiveThreadCount();
+
+   completions.clear();
+
+   {
+      std::lock_guard lock{m_completionsMutex};
+
+      std::swap(completions, m_completions);
+   }
+
+   // A request may have been cancelled after a worker had already picked it up
+
+   completions.erase(std::remove_if(std::begin(completions), std::end(completions), [this] (const PathCompletion& completion)
+   {
+      return retireTicket(completion.ticket);
+   }), std::end(completions));
+}
+
+void PathfindingService::waitForCompletions()
+{
+   std::unique_lock lock{m_completionsMutex};
+
+   m_completionsCond.wait(lock, [this] { return m_completions.empty() == false; });
+}
+
+std::uint64_t PathfindingService::savedSearchCount() const
+{
+   return m_savedSearchCount.load(std::memory_order_relaxed);
+}
+
+std::size_t PathfindingService::activeThreadCount() const
+{
+   return m_activeThreadCount.load();
+}
+
+template<typename PathfinderType>
+void PathfindingService::workerLoop(const std::size_t threadIndex)
+{
+   using namespace std::chrono_literals;
+
+   // The search state covers the whole world, threads that are put to sleep before they ever get a search do not need one
+   std::optional<PathfinderType> pathfinder;
+
+   while (m_stop.load() == false)
+   {
+      if (threadIndex >= m_activeThreadCount.load())
+      {
+         waitUntilActive(threadIndex);
+
+         continue;
+      }
+
+      auto pendingSearch = m_pendingSearches.tryPopFor(100ms);
+
+      if (pendingSearch.has_value() == false)
+         continue;
+
+      const auto& search = *pendingSearch;
+
+      {
+         std::lock_guard lock{m_searchesMutex};
+
+         // Requests cancelled while queued do not need a result anymore, nor does the search if no one is left
+
+         search->waiters.erase(std::remove_if(std::begin(search->waiters), std::end(search->waiters), [this] (const Waiter& waiter)
+         {
+            return dropIfCancelled(waiter.ticket);
+         }), std::end(search->waiters));
+
+         if (search->waiters.empty())
+         {
+            eraseSearchInFlight(search);
+
+            continue;
+         }
+      }
+
+      if (pathfinder.has_value() == false)
+      {
+         pathfinder.emplace(m_worldWidth, m_worldHeight);
+      }
+
+      const SharedPath path = std::make_shared<const Path>(findPath(*search, *pathfinder));
+
+      const auto latency = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - search->submitTime);
+
+      m_latencySumMicroseconds.fetch_add(static_cast<std::uint64_t>(latency.count()), std::memory_order_relaxed);
+      m_latencySampleCount.fetch_add(1, std::memory_order_relaxed);
+
+      Waiters waiters{PoolAllocator<Waiter>{m_searchPool}};
+
+      {
+         std::lock_guard lock{m_searchesMutex};
+
+         eraseSearchInFlight(search);
+
+         std::swap(waiters, search->waiters);
+      }
+
+      {
+         std::lock_guard lock{m_completionsMutex};
+
+         for (const auto& waiter : waiters)
+         {
+            m_completions.emplace_back(PathCompletion{waiter.ticket, waiter.villager, path});
+         }
+      }
+
+      m_completionsCond.notify_all();
+   }
+}
+
+bool PathfindingService::waitUntilActive(const std::size_t threadIndex)
+{
+   std::unique_lock lock{m_activeThreadMutex};
+
+   m_activeThreadCond.wait(lock, [&] { return m_stop.load() || threadIndex < m_activeThreadCount.load(); });
+
+   return (m_stop.load() == false);
+}
+
+void PathfindingService::adaptActiveThreadCount()
+{
+   using namespace std::chrono_literals;
+
+   if (m_minThreadCount == m_maxThreadCount)
+      return;
+
+   static constexpr auto adaptionInterval = 250ms;
+
+   // Searches taking longer than this from submission to result are considered slow
+   static constexpr auto targetLatency = 100ms;
+
+   const auto now = std::chrono::steady_clock::now();
+
+   if (now - m_lastAdaptionTime < adaptionInterval)
+      return;
+
+   m_lastAdaptionTime = now;
+
+   const auto latencySampleCount = m_latencySampleCount.exchange(0, std::memory_order_relaxed);
+   const auto latencySumMicroseconds = m_latencySumMicroseconds.exchange(0, std::memory_order_relaxed);
+
+   const auto averageLatency = std::chrono::microseconds{(latencySampleCount > 0) ? (latencySumMicroseconds / latencySampleCount) : 0};
+
+   const auto queueDepth = m_pendingSearches.size();
+
+   const auto activeThreadCount = m_activeThreadCount.load();
+
+   if ((queueDepth > activeThreadCount * 2 || averageLatency > targetLatency) && activeThreadCount < m_maxThreadCount)
+   {
+      setActiveThreadCount(std::min(activeThreadCount * 2, m_maxThreadCount)); // Grow fast to absorb bursts
+   }
+   else if (queueDepth == 0 && averageLatency < targetLatency / 4 && activeThreadCount > m_minThreadCount)
+   {
+      setActiveThreadCount(activeThreadCount - 1);
+   }
+}
+
+void PathfindingService::setActiveThreadCount(const std::size_t activeThreadCount)
+{
+   {
+      std::lock_guard lock{m_activeThreadMutex};
+
+      m_activeThreadCount.store(activeThreadCount);
+   }
+
+   m_activeThreadCond.notify_all();
+}
+
+std::size_t PathfindingService::SearchKeyHash::operator()(const SearchKey& searchKey) const
+{
+   // Fibonacci hashing spreads the spawn index, so searches from the same spawn point do not collide
+   return static_cast<std::size_t>((searchKey.first * 0x9E3779B97F4A7C15ull) ^ searchKey.second);
+}
+
+PathfindingService::SearchKey PathfindingService::getSearchKey(const Search& search) const
+{
+   const auto spawnTileIndex       = static_cast<std::uint64_t>(search.spawn      .second) * m_worldWidth + search.spawn      .first;
+   const auto destinationTileIndex = static_cast<std::uint64_t>(search.destination.second) * m_worldWidth + search.destination.first;
+
+   return {spawnTileIndex, destinationTileIndex};
+}
+
+void PathfindingService::eraseSearchInFlight(const std::shared_ptr<Search>& search)
+{
+   const auto searchIt = m_searchesInFlight.find(getSearchKey(*search));
+
+   // Might have been replaced by a search on a newer snapshot
+   if (searchIt != std::end(m_searchesInFlight) && searchIt->second == search)
+   {
+      m_searchesInFlight.erase(searchIt);
+   }
+}
+
+bool PathfindingService::dropIfCancelled(const PathTicket ticket)
+{
+   std::lock_guard lock{m_ticketsMutex};
+
+   if (m_cancelledTickets.erase(ticket) == 0)
+      return false;
+
+   m_ticketsInFlight.erase(ticket);
+
+   return true;
+}
+
+bool PathfindingService::retireTicket(const PathTicket ticket)
+{
+   std::lock_guard lock{m_ticketsMutex};
+
+   m_ticketsInFlight.erase(ticket);
+
+   return (m_cancelledTickets.erase(ticket) > 0);
+}
+
+std::pair<std::pair<std::size_t, std::size_t> /*spawn*/, std::pair<std::size_t, std::size_t> /*destination*/>
+PathfindingService::pickEndpoints(const WorldSnapshot& worldSnapshot, CounterRNG& rng)
+{
+   const auto width = worldSnapshot.worldMap.width();
+
+   const auto& buildingEntrances = *worldSnapshot.buildingEntrances;
+
+   std::uniform_int_distribution<std::size_t> rngWidth {0, width                          - 1};
+   std::uniform_int_distribution<std::size_t> rngHeight{0, worldSnapshot.worldMap.height() - 1};
+
+   // Same result as searching the world map from a random tile on and wrapping around, but without walking the tiles
+   auto findRandomBuildingEntrance = [&] () -> std::pair<std::size_t, std::size_t>
+   {
+      // Row first, as the former world map search drew them (its arguments were evaluated right to left), to keep results
+      const auto startY = rngHeight(rng);
+      const auto startX = rngWidth(rng);
+
+      if (buildingEntrances.empty())
+         return {0, 0}; // Fallback, entrances should always exist
+
+      auto buildingEntranceIt = std::lower_bound(std::begin(buildingEntrances), std::end(buildingEntrances), static_cast<std::uint64_t>(startY) * width + startX);
+
+      if (buildingEntranceIt == std::end(buildingEntrances))
+      {
+         buildingEntranceIt = std::begin(buildingEntrances);
+      }
+
+      return {static_cast<std::size_t>(*buildingEntranceIt % width), static_cast<std::size_t>(*buildingEntranceIt / width)};
+   };
+
+   const auto spawn = findRandomBuildingEntrance();
+
+   std::pair<std::size_t, std::size_t> destination;
+
+   do
+   {
+      destination = findRandomBuildingEntrance();
+   }
+   while (spawn == destination); // Spawn point and destination must differ
+
+   return {spawn, destination};
+}
+
+template<typename PathfinderType>
+Path PathfindingService::findPath(const Search& search, PathfinderType& pathfinder)
+{
+   const auto& [spawnX, spawnY] = search.spawn;
+   const auto& [destinationX, destinationY] = search.destination;
+
+   // Same search on either tile layout, isBlockedAt(x, y) and costAt(x, y) are the only ways tiles are read
+   auto findPathOn = [&] (const auto& isBlockedAt, const auto& costAt)
+   {
+      auto canTraverse = [&] (const std::size_t fromX, const std::size_t fromY, const std::size_t toX, const std::size_t toY)
+      {
+         if (isBlockedAt(toX, toY))
+            return false;
+
+         if (fromX == toX || fromY == toY)
+            return true;
+
+         // Diagonal movement is allowed if both "corners" are free
+         return ((isBlockedAt(fromX, toY) == false) && (isBlockedAt(toX, fromY) == false));
+      };
+
+      auto getTraversalCost = [&] (const std::size_t fromX, const std::size_t fromY, const std::size_t toX, const std::size_t toY)
+      {
+         const bool isDiagonal = (fromX != toX && fromY != toY);
+
+         const std::uint8_t factor = isDiagonal ? 14 : 10; // (sqrt(2) * 10) or (1 * 10)
+
+         return static_cast<std::int32_t>(factor * costAt(toX, toY));
+      };
+
+      // See http://theory.stanford.edu/~amitp/GameProgramming/Heuristics.html
+      auto heuristic = [&] (const std::size_t fromX, const std::size_t fromY, const std::size_t toX, const std::size_t toY)
+      {
+         // Diagonal distance (times 10)
+         const auto diffX = absDiff(fromX, toX);
+         const auto diffY = absDiff(fromY, toY);
+
+         static constexpr std::size_t d = 10; // 1 * 10
+         static constexpr std::size_t d2 = 14; // sqrt(2) * 10
+
+         return static_cast<std::int32_t>(d * (diffX + diffY) + (d2 - 2 * d) * std::min(diffX, diffY));
+      };
+
+      return pathfinder.getPath(spawnX, spawnY, destinationX, destinationY, canTraverse, getTraversalCost, heuristic);
+   };
+
+   if (search.worldSnapshot->tileRecords.has_value())
+   {
+      const auto& tileRecords = search.worldSnapshot->tileRecords.value();
+
+      return findPathOn(
+         [&] (const std::size_t x, const std::size_t y) { return tileRecords.at(x, y).isBlocked(); },
+         [&] (const std::size_t x, const std::size_t y) { return tileRecords.at(x, y).cost(); }
+      );
+   }
+
+   const auto& worldMap          = search.worldSnapshot->worldMap;
+   const auto& baseCostMap       = search.worldSnapshot->baseCostMap;
+   const auto& congestionCostMap = search.worldSnapshot->congestionCostMap;
+
+   return findPathOn(
+      [&] (const std::size_t x, const std::size_t y) { return isBlockedForVillagers(worldMap.at(x, y)); },
+      [&] (const std::size_t x, const std::size_t y) { return static_cast<std::int32_t>(baseCostMap.at(x, y)) + static_cast<std::int32_t>(congestionCostMap.at(x, y)); }
+   );
+}
@@ -0,0 +1,208 @@
+#ifndef PATHFINDINGSERVICE_HPP
+#define PATHFINDINGSERVICE_HPP
+
+#include <vector>
+#include <utility>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <future>
+#include <condition_variable>
+#include <chrono>
+#include <unordered_set>
+#include <unordered_map>
+#include <cstdint>
+
+#include "Pathfinding.hpp"
+#include "WorldSnapshot.hpp"
+#include "CounterRNG.hpp"
+#include "Queue.hpp"
+#include "BlockPool.hpp"
+#include "VillagerHandle.hpp"
+
+// Identifies a submitted path request, 0 is never handed out and can be used for "no request"
+using PathTicket = std::uint64_t;
+
+using Path = std::vector<std::pair<std::size_t, std::size_t>>;
+
+// Paths are never modified once found, so all requests served by the same search share one
+using SharedPath = std::shared_ptr<const Path>;
+
+struct PathRequest final
+{
+   // Completions are handed out for this handle, the owner checks it is still valid before applying them
+   VillagerHandle villager;
+
+   // Key the random stream for picking spawn point and destination
+   std::uint64_t villagerId;
+   std::uint64_t tripIndex;
+
+   // World state to search on, stays alive until the request is done
+   std::shared_ptr<const WorldSnapshot> worldSnapshot;
+};
+
+struct PathCompletion final
+{
+   PathTicket ticket;
+
+   VillagerHandle villager;
+
+   // Empty if no path could be found
+   SharedPath path;
+};
+
+// Runs path requests on its own threads. Requests are submitted by a single owner thread, which collects the results
+// in batches through drainCompletions. Completions of cancelled requests are never handed out.
+// A request for the same spawn point and destination as a search that has not finished yet does not start a search of
+// its own, but is attached to the pending one and receives the same result. That search must be on the same world
+// snapshot, or on one published at most maxSnapshotAgeTicks before the request's.
+// If the minimum and maximum thread count differ, the number of active threads follows the load: all threads start out
+// active to serve the first burst of requests, are put to sleep while the queue stays empty, and are added again while
+// searches pile up or take long to be served.
+// Every thread keeps the search state of all tiles, laid out in Z-order if mortonNodeLayout is set, row-major otherwise.
+// That state is only allocated once the thread takes its first search.
+// The bookkeeping of searches is allocated from a pool, so submitting does not allocate once the number of searches in
+// flight has peaked.
+class PathfindingService final
+{
+public:
+   PathfindingService(const std::size_t minThreadCount, const std::size_t maxThreadCount, const std::size_t worldWidth, const std::size_t worldHeight, const std::uint64_t seed, const bool mortonNodeLayout, const std::uint64_t maxSnapshotAgeTicks);
+
+   PathfindingService(const PathfindingService&) = delete;
+   PathfindingService(PathfindingService&&) = delete;
+
+   ~PathfindingService();
+
+   PathfindingService& operator=(const PathfindingService&) = delete;
+   PathfindingService& operator=(PathfindingService&&) = delete;
+
+   PathTicket submit(const PathRequest& request);
+
+   // Cancelling a ticket that has already been drained, or dropped for an earlier cancel, has no effect
+   void cancel(const PathTicket ticket);
+
+   // Replaces the contents of completions with all requests finished since the last call
+   void drainCompletions(std::vector<PathCompletion>& completions);
+
+   // Blocks until there is something to drain
+   void waitForCompletions();
+
+   // Number of requests that were attached to an already pending search, can be called from any thread
+   std::uint64_t savedSearchCount() const;
+
+   // Number of threads currently taking searches, can be called from any thread
+   std::size_t activeThreadCount() const;
+
+private:
+   struct Waiter final
+   {
+      PathTicket ticket;
+      VillagerHandle villager;
+   };
+
+   using Waiters = std::vector<Waiter, PoolAllocator<Waiter>>;
+
+   struct Search final
+   {
+      explicit Search(const PoolAllocator<Waiter>& allocator);
+
+      std::pair<std::size_t, std::size_t> spawn;
+      std::pair<std::size_t, std::size_t> destination;
+
+      std::shared_ptr<const WorldSnapshot> worldSnapshot;
+
+      std::chrono::steady_clock::time_point submitTime;
+
+      // Guarded by m_searchesMutex
+      Waiters waiters;
+   };
+
+   // Row-major tile indices of spawn point and destination
+   using SearchKey = std::pair<std::uint64_t, std::uint64_t>;
+
+   struct SearchKeyHash final
+   {
+      std::size_t operator()(const SearchKey& searchKey) const;
+   };
+
+   using SearchesInFlight = std::unordered_map<SearchKey, std::shared_ptr<Search>, SearchKeyHash, std::equal_to<SearchKey>, PoolAllocator<std::pair<const SearchKey, std::shared_ptr<Search>>>>;
+   using TicketSet = std::unordered_set<PathTicket, std::hash<PathTicket>, std::equal_to<PathTicket>, PoolAllocator<PathTicket>>;
+
+   std::uint64_t m_seed;
+
+   std::size_t m_worldWidth;
+   std::size_t m_worldHeight;
+
+   std::uint64_t m_maxSnapshotAgeTicks;
+
+   PathTicket m_nextTicket = 1;
+
+   // Searches, their waiters and the containers below
+   std::shared_ptr<BlockPool> m_searchPool = std::make_shared<BlockPool>();
+
+   Queue<std::shared_ptr<Search>, PoolAllocator<std::shared_ptr<Search>>> m_pendingSearches;
+
+   // Searches that have been queued but not finished yet, by spawn and destination tile index
+   std::mutex m_searchesMutex;
+   SearchesInFlight m_searchesInFlight;
+
+   // Tickets submitted but neither drained nor dropped yet, only those can be cancelled, so a cancelled ticket always
+   // leaves m_cancelledTickets again once a worker or the drain gets to it
+   std::mutex m_ticketsMutex;
+   TicketSet m_ticketsInFlight;
+   TicketSet m_cancelledTickets;
+
+   std::mutex m_completionsMutex;
+   std::condition_variable m_completionsCond;
+   std::vector<PathCompletion> m_completions;
+
+   std::atomic<std::uint64_t> m_savedSearchCount = 0;
+
+   std::size_t m_minThreadCount;
+   std::size_t m_maxThreadCount;
+
+   // Threads with an index of at least this wait on m_activeThreadCond
+   std::atomic<std::size_t> m_activeThreadCount;
+
+   std::mutex m_activeThreadMutex;
+   std::condition_variable m_activeThreadCond;
+
+   // Time from submitting to finishing searches since the last adaption
+   std::atomic<std::uint64_t> m_latencySumMicroseconds = 0;
+   std::atomic<std::uint64_t> m_latencySampleCount = 0;
+
+   std::chrono::steady_clock::time_point m_lastAdaptionTime;
+
+   std::atomic<bool> m_stop = false;
+
+   std::vector<std::future<void>> m_workerFutures;
+
+   template<typename PathfinderType>
+   void workerLoop(const std::size_t threadIndex);
+
+   // Blocks until the thread is among the active ones, returns false if the service is stopping instead
+   bool waitUntilActive(const std::size_t threadIndex);
+
+   void adaptActiveThreadCount();
+   void setActiveThreadCount(const std::size_t activeThreadCount);
+
+   SearchKey getSearchKey(const Search& search) const;
+
+   // Must be called with m_searchesMutex held
+   void eraseSearchInFlight(const std::shared_ptr<Search>& search);
+
+   // Forgets ticket if it has been cancelled, returns whether it was
+   bool dropIfCancelled(const PathTicket ticket);
+
+   // Forgets a ticket that is done with, returns whether it was cancelled
+   bool retireTicket(const PathTicket ticket);
+
+   // Picks two different building entrances, each the first one at or after a random tile in row-major order
+   static std::pair<std::pair<std::size_t, std::size_t> /*spawn*/, std::pair<std::size_t, std::size_t> /*destination*/>
+   pickEndpoints(const WorldSnapshot& worldSnapshot, CounterRNG& rng);
+
+   template<typename PathfinderType>
+   static Path findPath(const Search& search, PathfinderType& pathfinder);
+};
+
+#endif // PATHFINDINGSERVICE_HPP
@@ -2,16 +2,20 @@
 #define QUEUE_HPP
 
 #include <queue>
+#include <deque>
+#include <memory>
 #include <mutex>
 #include <condition_variable>
 #include <optional>
 #include <chrono>
 
-template<typename T>
+// Values are kept in a deque using Allocator
+template<typename T, typename Allocator = std::allocator<T>>
 class Queue final
 {
 public:
    Queue() = default;
+   explicit Queue(const Allocator& allocator);
 
    Queue(const Queue&) = default;
    Queue(Queue&&) noexcept = default;
@@ -25,52 +29,69 @@ public:
    T pop();
    std::optional<T> tryPopFor(std::chrono::milliseconds duration);
 
+   std::size_t size();
+
 private:
-   std::queue<T> m_queue;
+   std::queue<T, std::deque<T, Allocator>> m_queue;
 
    std::mutex m_mutex;
    std::condition_variable m_cond;
 };
 
-template<typename T>
-void Queue<T>::push(T value)
+template<typename T, typename Allocator>
+Queue<T, Allocator>::Queue(const Allocator& allocator):
+   m_queue(allocator)
+{
+   // NOP
+}
+
+template<typename T, typename Allocator>
+void Queue<T, Allocator>::push(T value)
 {
    {
       std::lock_guard lock{m_mutex};
 
-      m_queue.push(value);
+      m_queue.push(std::move(value));
    }
 
    m_cond.notify_one();
 }
 
-template<typename T>
-T Queue<T>::pop()
+template<typename T, typename Allocator>
+T Queue<T, Allocator>::pop()
 {
    std::unique_lock lock{m_mutex};
 
    m_cond.wait(lock, [&] { return m_queue.empty() == false; });
 
-   T value = m_queue.front();
+   T value = std::move(m_queue.front());
 
    m_queue.pop();
 
    return value;
 }
 
-template<typename T>
-std::optional<T> Queue<T>::tryPopFor(std::chrono::milliseconds duration)
+template<typename T, typename Allocator>
+std::optional<T> Queue<T, Allocator>::tryPopFor(std::chrono::milliseconds duration)
 {
    std::unique_lock lock{m_mutex};
 
    if (m_cond.wait_for(lock, duration, [&] { return m_queue.empty() == false; }) == false)
       return std::nullopt;
 
-   T value = m_queue.front();
+   T value = std::move(m_queue.front());
 
    m_queue.pop();
 
    return value;
 }
 
+template<typename T, typename Allocator>
+std::size_t Queue<T, Allocator>::size()
+{
+   std::lock_guard lock{m_mutex};
+
+   return m_queue.size();
+}
+
 #endif // QUEUE_HPP
@@ -0,0 +1,42 @@
+#ifndef RENDERSTATE_HPP
+#define RENDERSTATE_HPP
+
+#include <vector>
+#include <cstdint>
+
+#include <raylib.h>
+
+#include "UpdateRect.hpp"
+#include "MapView.hpp"
+
+// Everything the render thread needs from one simulation tick, published by the simulation thread
+struct RenderState final
+{
+   struct Villager final
+   {
+      Vector2 position;
+      Color color;
+   };
+
+   std::vector<Villager> villagers;
+
+   // Desire paths to redraw for this tick. The stress copy covers the update rect plus a border of one tile,
+   // as far as the map allows, so the render thread can blend with neighbors.
+   UpdateRect desirePathsUpdateRect;
+   UpdateRect desirePathsCopyRect;
+   std::vector<std::uint8_t> desirePathsCopy;
+
+   int ticksPerSecond = 0;
+
+   // Change of the desire path network over the convergence window, -1 as long as there is no whole window
+   int desirePathsChangePerMille = -1;
+   bool desirePathsConverged = false;
+
+   // Tile (0, 0) of the view is the top left of the copy rect
+   MapView<std::uint8_t> desirePathsCopyView() const
+   {
+      return MapView<std::uint8_t>{desirePathsCopy.data(), desirePathsCopyRect.width(), desirePathsCopyRect.height(), 1, static_cast<std::ptrdiff_t>(desirePathsCopyRect.width())};
+   }
+};
+
+#endif // RENDERSTATE_HPP
@@ -0,0 +1,55 @@
+#ifndef TILERECORD_HPP
+#define TILERECORD_HPP
+
+#include <cstdint>
+
+#include "TileType.hpp"
+
+inline bool isBlockedForVillagers(const TileType tileType)
+{
+   switch (tileType)
+   {
+   case TileType::Street:
+   case TileType::BuildingEntrance:
+   case TileType::Grass:
+   //case TileType::Water:
+      return false;
+   default:
+      return true;
+   }
+}
+
+// Everything pathfinding reads per tile, packed into 32 bits. With separate layers, expanding a node touches the world
+// map, the base cost map and the congestion cost map, each in its own cache line; a record serves all of them with a
+// single load.
+struct TileRecord final
+{
+   static constexpr std::uint8_t m_flagBlocked = 0x01;
+
+   TileType type;
+   std::uint8_t baseCost;
+   std::uint8_t congestionCost;
+   std::uint8_t flags;
+
+   bool isBlocked() const;
+   std::int32_t cost() const;
+};
+
+static_assert(sizeof(TileRecord) == 4, "TileRecord is meant to be packed into 32 bits");
+
+inline bool TileRecord::isBlocked() const
+{
+   return ((flags & m_flagBlocked) != 0);
+}
+
+inline std::int32_t TileRecord::cost() const
+{
+   return static_cast<std::int32_t>(baseCost) + static_cast<std::int32_t>(congestionCost);
+}
+
+inline TileRecord makeTileRecord(const TileType type, const std::uint8_t baseCost, const std::uint8_t congestionCost)
+{
+   return TileRecord{type, baseCost, congestionCost, isBlockedForVillagers(type) ? TileRecord::m_flagBlocked : std::uint8_t{0}};
+}
+
+#endif // TILERECORD_HPP
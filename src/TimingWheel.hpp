@@ -0,0 +1,144 @@
+#ifndef TIMINGWHEEL_HPP
+#define TIMINGWHEEL_HPP
+
+#include <vector>
+#include <array>
+#include <cstdint>
+
+// Hierarchical timing wheel for scheduling ids at whole ticks. Level 0 holds one slot per tick for the next
+// m_slotCount ticks, every further level covers m_slotCount times the range of the level below. Entries are moved
+// down a level whenever the lower level wraps around, so scheduling and advancing by one tick are O(1) regardless
+// of how many entries there are. Entries beyond the range of the top level are kept in its farthest slot and are
+// rescheduled from there.
+// An id can be scheduled multiple times, every entry is handed out once.
+class TimingWheel final
+{
+public:
+   explicit TimingWheel(const std::uint64_t startTick = 0);
+
+   TimingWheel(const TimingWheel&) = default;
+   TimingWheel(TimingWheel&&) noexcept = default;
+
+   ~TimingWheel() = default;
+
+   TimingWheel& operator=(const TimingWheel&) = default;
+   TimingWheel& operator=(TimingWheel&&) noexcept = default;
+
+   // Entries due at or before the current tick are handed out on the next advance
+   void schedule(const std::size_t id, const std::uint64_t dueTick);
+
+   // Moves the current tick forward to tick and appends the ids of all entries due until then to dueIds
+   void advance(const std::uint64_t tick, std::vector<std::size_t>& dueIds);
+
+   std::uint64_t currentTick() const;
+
+private:
+   static constexpr std::size_t m_slotBits = 6;
+   static constexpr std::size_t m_slotCount = std::size_t{1} << m_slotBits;
+   static constexpr std::size_t m_slotMask = m_slotCount - 1;
+   static constexpr std::size_t m_levelCount = 4;
+
+   struct Entry final
+   {
+      std::size_t id;
+      std::uint64_t dueTick;
+   };
+
+   using Slot = std::vector<Entry>;
+
+   std::array<std::array<Slot, m_slotCount>, m_levelCount> m_levels;
+
+   std::uint64_t m_currentTick;
+
+   void insert(const Entry& entry);
+
+   void cascade(const std::size_t level);
+};
+
+inline TimingWheel::TimingWheel(const std::uint64_t startTick):
+   m_currentTick{startTick}
+{
+   // NOP
+}
+
+inline void TimingWheel::schedule(const std::size_t id, const std::uint64_t dueTick)
+{
+   insert(Entry{id, (dueTick > m_currentTick) ? dueTick : (m_currentTick + 1)});
+}
+
+inline void TimingWheel::advance(const std::uint64_t tick, std::vector<std::size_t>& dueIds)
+{
+   while (m_currentTick < tick)
+   {
+      m_currentTick += 1;
+
+      // Bring down the entries of every level whose lower levels have wrapped around, highest level first
+
+      std::size_t wrappedLevelCount = 0;
+
+      while (wrappedLevelCount + 1 < m_levelCount && ((m_currentTick >> (m_slotBits * (wrappedLevelCount + 1))) << (m_slotBits * (wrappedLevelCount + 1))) == m_currentTick)
+      {
+         wrappedLevelCount += 1;
+      }
+
+      for (std::size_t level = wrappedLevelCount; level > 0; --level)
+      {
+         cascade(level);
+      }
+
+      auto& slot = m_levels[0][m_currentTick & m_slotMask];
+
+      for (const auto& entry : slot)
+      {
+         dueIds.emplace_back(entry.id);
+      }
+
+      slot.clear();
+   }
+}
+
+inline std::uint64_t TimingWheel::currentTick() const
+{
+   return m_currentTick;
+}
+
+inline void TimingWheel::insert(const Entry& entry)
+{
+   const auto ticksAhead = entry.dueTick - m_currentTick;
+
+   for (std::size_t level = 0; level < m_levelCount; ++level)
+   {
+      if (ticksAhead < (std::uint64_t{1} << (m_slotBits * (level + 1))))
+      {
+         m_levels[level][(entry.dueTick >> (m_slotBits * level)) & m_slotMask].emplace_back(entry);
+
+         return;
+      }
+   }
+
+   // Too far ahead, park in the farthest top level slot and reinsert once that comes around
+   m_levels[m_levelCount - 1][((m_currentTick >> (m_slotBits * (m_levelCount - 1))) - 1) & m_slotMask].emplace_back(entry);
+}
+
+inline void TimingWheel::cascade(const std::size_t level)
+{
+   auto& slot = m_levels[level][(m_currentTick >> (m_slotBits * level)) & m_slotMask];
+
+   Slot entries;
+
+   std::swap(entries, slot);
+
+   for (const auto& entry : entries)
+   {
+      insert(entry);
+   }
+
+   if (slot.empty())
+   {
+      // Keep the capacity for the next time around
+      entries.clear();
+      std::swap(entries, slot);
+   }
+}
+
+#endif // TIMINGWHEEL_HPP
@@ -0,0 +1,73 @@
+#ifndef TRIPLEBUFFER_HPP
+#define TRIPLEBUFFER_HPP
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+// Lock-free hand-over of the latest value from one writer thread to one reader thread. The writer fills the back
+// buffer and publishes it, the reader picks up the most recently published buffer. Neither side ever waits for the
+// other, values published in between two reads are skipped.
+template<typename T>
+class TripleBuffer final
+{
+public:
+   TripleBuffer() = default;
+
+   TripleBuffer(const TripleBuffer&) = delete;
+   TripleBuffer(TripleBuffer&&) = delete;
+
+   ~TripleBuffer() = default;
+
+   TripleBuffer& operator=(const TripleBuffer&) = delete;
+   TripleBuffer& operator=(TripleBuffer&&) = delete;
+
+   // Writer side
+   T& writeBuffer();
+   void publish();
+
+   // Reader side, returns true if a newer value than the one in the read buffer was published
+   bool consume();
+   const T& readBuffer() const;
+
+private:
+   static constexpr std::uint8_t m_freshFlag = 0x4;
+   static constexpr std::uint8_t m_indexMask = 0x3;
+
+   std::array<T, 3> m_buffers = {};
+
+   std::uint8_t m_writeIndex = 0;
+   std::atomic<std::uint8_t> m_middle = 1; // Buffer index plus m_freshFlag if the writer published since the last read
+   std::uint8_t m_readIndex = 2;
+};
+
+template<typename T>
+T& TripleBuffer<T>::writeBuffer()
+{
+   return m_buffers[m_writeIndex];
+}
+
+template<typename T>
+void TripleBuffer<T>::publish()
+{
+   m_writeIndex = m_middle.exchange(m_writeIndex | m_freshFlag, std::memory_order_acq_rel) & m_indexMask;
+}
+
+template<typename T>
+bool TripleBuffer<T>::consume()
+{
+   if ((m_middle.load(std::memory_order_relaxed) & m_freshFlag) == 0)
+      return false;
+
+   m_readIndex = m_middle.exchange(m_readIndex, std::memory_order_acq_rel) & m_indexMask;
+
+   return true;
+}
+
+template<typename T>
+const T& TripleBuffer<T>::readBuffer() const
+{
+   return m_buffers[m_readIndex];
+}
+
+#endif // TRIPLEBUFFER_HPP
@@ -1,28 +1,23 @@
 #ifndef VILLAGER_HPP
 #define VILLAGER_HPP
 
-#include <vector>
-#include <utility>
-#include <atomic>
-#include <random>
+#include <cstdint>
 
 #include <raylib.h>
 
-#include "WorldMap.hpp"
-#include "UpdateRect.hpp"
-#include "CostMap.hpp"
-#include "DesirePaths.hpp"
-#include "Pathfinding.hpp"
+#include "PathfindingService.hpp"
 
+// Per-villager state that is not needed for moving along a path, see VillagerStore for the rest
 class Villager final
 {
 public:
    enum class State
    {
-      AwaitingPath,    // Villager has no path and is not yet enqueued for pathfinding
-      EnqueuedForPath, // Villager has been put into pathfinding queue
+      AwaitingPath,    // Villager has no path and no path request has been submitted yet
+      EnqueuedForPath, // A path request has been submitted, see m_pathTicket
       PathProvided,    // Villager has been assigned a path but is not yet moving
-      Moving           // Villager is moving along its current path
+      Moving,          // Villager is moving along its current path
+      Despawned        // Slot is not in use
    };
 
 public:
@@ -36,79 +31,39 @@ public:
    Villager& operator=(const Villager&) = default;
    Villager& operator=(Villager&&) noexcept = default;
 
-   Vector2 m_position = {0.0f, 0.0f};
+   // Unique for every villager ever spawned, unlike its index, which is reused after despawning
+   std::uint64_t m_id = 0;
 
    float m_movementPixelPerSec = 50.0f;
 
    Color m_color = {0, 0, 0, 255};
 
+   // Number of paths requested so far, keys the pathfinding random stream
+   std::uint64_t m_tripCount = 0;
+
+   // Request of the path the villager is waiting for, only valid in State::EnqueuedForPath
+   PathTicket m_pathTicket = 0;
+
+   // Shared with all villagers whose requests were served by the same search
+   SharedPath m_path;
+
+   std::size_t m_currentPathIndex = 0;
+
+   // Pixel position of the tile the villager is currently walking to
+   Vector2 m_tileToTileMovementTarget = {0.0f, 0.0f};
+
    State getState() const
    {
-      return m_state.load();
+      return m_state;
    }
 
    void setState(const State state)
    {
-      m_state.store(state);
+      m_state = state;
    }
 
-   void tick(
-      WorldMap& worldMap,
-      UpdateRect& mapUpdateRect,
-      CostMap& baseCostMap,
-      DesirePathsMap& desirePathsMap,
-      const bool pavePaths,
-      const int tileWidthPixels,
-      const int tileHeightPixels,
-      std::mt19937_64& rng,
-      const float delta
-   );
-
-   void reset(
-      const WorldMap& worldMap,
-      Pathfinder& pathfinder,
-      const CostMap& baseCostMap,
-      const int tileWidthPixels,
-      const int tileHeightPixels,
-      std::mt19937_64& rng
-   );
-
 private:
-   std::vector<std::pair<std::size_t, std::size_t>> m_path;
-
-   Vector2 m_tileToTileMovementStart = {0.0f, 0.0f};
-   Vector2 m_tileToTileMovementTarget = {0.0f, 0.0f};
-   Vector2 m_tileToTileMovementDirection = {0.0f, 0.0f};
-   float m_tileToTileMovementDistance = 0.0f;
-
-   std::size_t m_currentPathIndex = 0;
-
-   std::atomic<State> m_state = State::AwaitingPath;
-
-   void moveOntoTile(
-      const std::size_t tileX,
-      const std::size_t tileY,
-      WorldMap& worldMap,
-      UpdateRect& mapUpdateRect,
-      CostMap& baseCostMap,
-      DesirePathsMap& desirePathsMap,
-      const bool pavePaths,
-      const int tileWidthPixels,
-      const int tileHeightPixels,
-      std::mt19937_64& rng
-   );
-
-   void paveTile(
-      const std::size_t tileX,
-      const std::size_t tileY,
-      WorldMap& worldMap,
-      UpdateRect& mapUpdateRect,
-      CostMap& baseCostMap,
-      DesirePathsMap& desirePathsMap,
-      const int tileWidthPixels,
-      const int tileHeightPixels,
-      std::mt19937_64& rng
-   );
+   State m_state = State::Despawned;
 };
 
 #endif // VILLAGER_HPP
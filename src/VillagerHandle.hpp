@@ -0,0 +1,14 @@
+#ifndef VILLAGERHANDLE_HPP
+#define VILLAGERHANDLE_HPP
+
+#include <cstdint>
+
+// Refers to a villager for as long as it lives. Once the villager is despawned the handle turns invalid, even if the
+// index has been reused for a new villager. See VillagerStore::isValid.
+struct VillagerHandle final
+{
+   std::uint32_t index;
+   std::uint32_t generation;
+};
+
+#endif // VILLAGERHANDLE_HPP
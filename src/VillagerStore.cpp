@@ -0,0 +1,314 @@
+#include "VillagerStore.hpp"
+
+#include <cmath>
+#include <random>
+#include <limits>
+#include <cassert>
+
+VillagerStore::VillagerStore(const std::size_t capacity, const std::size_t worldWidthTiles, const std::size_t worldHeightTiles):
+   m_positionX(capacity, 0.0f),
+   m_positionY(capacity, 0.0f),
+   m_directionX(capacity, 0.0f),
+   m_directionY(capacity, 0.0f),
+   m_remainingDistance(capacity, std::numeric_limits<float>::infinity()),
+   m_speed(capacity, 0.0f),
+   m_segmentStartTime(capacity, 0.0),
+   m_deferredTime(capacity, 0.0f),
+   m_villagers(capacity),
+   m_generations(capacity, 0),
+   m_occupancy{worldWidthTiles, worldHeightTiles},
+   m_occupiedTiles(capacity, m_noTile)
+{
+   m_freeIndices.reserve(capacity);
+}
+
+std::optional<VillagerHandle> VillagerStore::spawn(const std::uint64_t villagerId)
+{
+   std::size_t villagerIndex;
+
+   if (m_freeIndices.empty() == false)
+   {
+      villagerIndex = m_freeIndices.back();
+
+      m_freeIndices.pop_back();
+   }
+   else if (m_usedSlotCount < capacity())
+   {
+      villagerIndex = m_usedSlotCount++;
+   }
+   else
+   {
+      return std::nullopt; // Full
+   }
+
+   auto& villager = m_villagers[villagerIndex];
+
+   villager = Villager{};
+   villager.m_id = villagerId;
+
+   m_positionX[villagerIndex] = 0.0f;
+   m_positionY[villagerIndex] = 0.0f;
+
+   m_deferredTime[villagerIndex] = 0.0f;
+
+   stop(villagerIndex);
+
+   return handle(villagerIndex);
+}
+
+void VillagerStore::despawn(const std::size_t villagerIndex)
+{
+   assert(isAlive(villagerIndex));
+
+   stop(villagerIndex);
+
+   leaveTile(villagerIndex);
+
+   m_villagers[villagerIndex].setState(Villager::State::Despawned);
+   m_villagers[villagerIndex].m_pathTicket = 0;
+
+   m_deferredTime[villagerIndex] = 0.0f;
+
+   m_generations[villagerIndex] += 1;
+
+   m_freeIndices.emplace_back(villagerIndex);
+}
+
+void VillagerStore::tickVillager(
+   const std::size_t villagerIndex,
+   const WorldMap& worldMap,
+   std::vector<DesirePathStressDelta>& stressDeltas,
+   const int tileWidthPixels,
+   const int tileHeightPixels,
+   const std::uint64_t seed,
+   const double time
+)
+{
+   auto& villager = m_villagers[villagerIndex];
+
+   const auto& path = *villager.m_path;
+
+   if (villager.getState() == Villager::State::PathProvided)
+   {
+      assert(path.size() >= 2);
+
+      // "Spawn" at first point in path
+      villager.m_currentPathIndex = 0;
+
+      const auto startTileX = path[villager.m_currentPathIndex].first;
+      const auto startTileY = path[villager.m_currentPathIndex].second;
+
+      moveOntoTile(villagerIndex, villager.m_currentPathIndex, worldMap, stressDeltas, seed);
+
+      m_positionX[villagerIndex] = static_cast<float>(static_cast<int>(startTileX) * tileWidthPixels);
+      m_positionY[villagerIndex] = static_cast<float>(static_cast<int>(startTileY) * tileHeightPixels);
+
+      beginSegment(villagerIndex, tileWidthPixels, tileHeightPixels, time);
+
+      villager.setState(Villager::State::Moving);
+   }
+   else if (villager.getState() == Villager::State::Moving) // Next tile reached
+   {
+      // Continue from the exact arrival time rather than the current time, so event-driven movement does not lag
+      // behind by up to a tick per tile
+      const auto reachedTime = std::min(arrivalTime(villagerIndex), time);
+
+      m_positionX[villagerIndex] = villager.m_tileToTileMovementTarget.x;
+      m_positionY[villagerIndex] = villager.m_tileToTileMovementTarget.y;
+
+      villager.m_currentPathIndex += 1;
+
+      moveOntoTile(villagerIndex, villager.m_currentPathIndex, worldMap, stressDeltas, seed);
+
+      if (path.size() > villager.m_currentPathIndex + 1)
+      {
+         beginSegment(villagerIndex, tileWidthPixels, tileHeightPixels, reachedTime);
+      }
+      else
+      {
+         stop(villagerIndex);
+      }
+   }
+}
+
+void VillagerStore::catchUpVillager(
+   const std::size_t villagerIndex,
+   const WorldMap& worldMap,
+   std::vector<DesirePathStressDelta>& stressDeltas,
+   const int tileWidthPixels,
+   const int tileHeightPixels,
+   const std::uint64_t seed,
+   const double time
+)
+{
+   auto& villager = m_villagers[villagerIndex];
+
+   for (;;)
+   {
+      if (villager.getState() == Villager::State::PathProvided)
+      {
+         tickVillager(villagerIndex, worldMap, stressDeltas, tileWidthPixels, tileHeightPixels, seed, time);
+
+         continue;
+      }
+
+      if (villager.getState() != Villager::State::Moving)
+         break; // Time spent without a path is not made up for
+
+      if (needsTick(villagerIndex))
+      {
+         tickVillager(villagerIndex, worldMap, stressDeltas, tileWidthPixels, tileHeightPixels, seed, time);
+
+         continue;
+      }
+
+      const auto timeToNextTile = m_remainingDistance[villagerIndex] / m_speed[villagerIndex];
+
+      if (m_deferredTime[villagerIndex] < timeToNextTile)
+      {
+         moveAlongSegments(&m_positionX[villagerIndex], &m_positionY[villagerIndex], &m_remainingDistance[villagerIndex], &m_directionX[villagerIndex], &m_directionY[villagerIndex], &m_speed[villagerIndex], 1, m_deferredTime[villagerIndex]);
+
+         break;
+      }
+
+      // Reached the next tile, tickVillager puts the villager right onto it
+      m_deferredTime[villagerIndex] -= timeToNextTile;
+
+      tickVillager(villagerIndex, worldMap, stressDeltas, tileWidthPixels, tileHeightPixels, seed, time);
+   }
+
+   m_deferredTime[villagerIndex] = 0.0f;
+}
+
+void VillagerStore::walkPath(
+   const std::size_t villagerIndex,
+   const WorldMap& worldMap,
+   std::vector<DesirePathStressDelta>& stressDeltas,
+   const int tileWidthPixels,
+   const int tileHeightPixels,
+   const std::uint64_t seed
+)
+{
+   auto& villager = m_villagers[villagerIndex];
+
+   assert(villager.getState() == Villager::State::PathProvided);
+
+   const auto& path = *villager.m_path;
+
+   // Same tiles in the same order as walking tile by tile, so the same stress is added
+   for (std::size_t pathIndex = 0; pathIndex < path.size(); ++pathIndex)
+   {
+      moveOntoTile(villagerIndex, pathIndex, worldMap, stressDeltas, seed);
+   }
+
+   m_positionX[villagerIndex] = static_cast<float>(static_cast<int>(path.back().first ) * tileWidthPixels );
+   m_positionY[villagerIndex] = static_cast<float>(static_cast<int>(path.back().second) * tileHeightPixels);
+
+   stop(villagerIndex);
+}
+
+void VillagerStore::setPath(const std::size_t villagerIndex, SharedPath path)
+{
+   auto& villager = m_villagers[villagerIndex];
+
+   villager.m_pathTicket = 0;
+
+   // Nothing held back from before belongs to the new path
+   m_deferredTime[villagerIndex] = 0.0f;
+
+   if (path == nullptr || path->size() < 2)
+   {
+      stop(villagerIndex);
+
+      return;
+   }
+
+   villager.m_path = std::move(path);
+   villager.m_currentPathIndex = 0;
+
+   villager.setState(Villager::State::PathProvided);
+
+   m_speed[villagerIndex] = 0.0f;
+   m_remainingDistance[villagerIndex] = 0.0f; // Picked up by the next tick
+}
+
+void VillagerStore::stop(const std::size_t villagerIndex)
+{
+   auto& villager = m_villagers[villagerIndex];
+
+   villager.m_path.reset();
+   villager.m_currentPathIndex = 0;
+
+   villager.setState(Villager::State::AwaitingPath);
+
+   m_speed[villagerIndex] = 0.0f;
+   m_remainingDistance[villagerIndex] = std::numeric_limits<float>::infinity();
+}
+
+void VillagerStore::beginSegment(const std::size_t villagerIndex, const int tileWidthPixels, const int tileHeightPixels, const double startTime)
+{
+   auto& villager = m_villagers[villagerIndex];
+
+   const auto& path = *villager.m_path;
+
+   const auto nextTileX = path[villager.m_currentPathIndex + 1].first;
+   const auto nextTileY = path[villager.m_currentPathIndex + 1].second;
+
+   villager.m_tileToTileMovementTarget.x = static_cast<float>(static_cast<int>(nextTileX) * tileWidthPixels);
+   villager.m_tileToTileMovementTarget.y = static_cast<float>(static_cast<int>(nextTileY) * tileHeightPixels);
+
+   const auto diffX = villager.m_tileToTileMovementTarget.x - m_positionX[villagerIndex];
+   const auto diffY = villager.m_tileToTileMovementTarget.y - m_positionY[villagerIndex];
+
+   const auto distance = std::sqrt(diffX * diffX + diffY * diffY); // Once per segment, not per tick
+
+   m_directionX[villagerIndex] = (distance > 0.0f) ? (diffX / distance) : 0.0f;
+   m_directionY[villagerIndex] = (distance > 0.0f) ? (diffY / distance) : 0.0f;
+
+   m_remainingDistance[villagerIndex] = distance;
+
+   m_speed[villagerIndex] = villager.m_movementPixelPerSec;
+
+   m_segmentStartTime[villagerIndex] = startTime;
+}
+
+void VillagerStore::moveOntoTile(
+   const std::size_t villagerIndex,
+   const std::size_t pathIndex,
+   const WorldMap& worldMap,
+   std::vector<DesirePathStressDelta>& stressDeltas,
+   const std::uint64_t seed
+)
+{
+   const auto& villager = m_villagers[villagerIndex];
+
+   const auto [tileX, tileY] = (*villager.m_path)[pathIndex];
+
+   leaveTile(villagerIndex);
+
+   m_occupancy.enter(tileX, tileY);
+
+   m_occupiedTiles[villagerIndex] = static_cast<std::uint32_t>(tileY * m_occupancy.width() + tileX);
+
+   if (worldMap.at(tileX, tileY) == TileType::Grass)
+   {
+      // The path being walked was requested as the last trip so far
+      const auto tripIndex = villager.m_tripCount - 1;
+
+      CounterRNG stepRNG{seed, RNGSubsystem::VillagerStep, villager.m_id, (tripIndex << 32) | pathIndex};
+
+      stressDeltas.emplace_back(DesirePathStressDelta{tileX, tileY, std::uniform_int_distribution<>{2, 6}(stepRNG)});
+   }
+}
+
+void VillagerStore::leaveTile(const std::size_t villagerIndex)
+{
+   const auto occupiedTile = m_occupiedTiles[villagerIndex];
+
+   if (occupiedTile != m_noTile)
+   {
+      m_occupancy.leave(occupiedTile % m_occupancy.width(), occupiedTile / m_occupancy.width());
+
+      m_occupiedTiles[villagerIndex] = m_noTile;
+   }
+}
@@ -0,0 +1,372 @@
+#ifndef VILLAGERSTORE_HPP
+#define VILLAGERSTORE_HPP
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <optional>
+#include <limits>
+
+#include "Villager.hpp"
+#include "VillagerHandle.hpp"
+#include "WorldMap.hpp"
+#include "DesirePaths.hpp"
+#include "PathfindingService.hpp"
+#include "CounterRNG.hpp"
+#include "OccupancyGrid.hpp"
+
+// All villagers, stored as structure of arrays. Everything moveVillagers touches every tick lives in its own tightly
+// packed array, everything else is kept in a Villager per index.
+//
+// A villager walks its path one tile-to-tile segment at a time. Per segment, the direction and length are computed
+// once, moveVillagers then only counts down the remaining distance. Villagers with a remaining distance of 0 or
+// less need to be handed to tickVillager, which is the case for villagers that reached the end of their segment and
+// for villagers that have just been given a path. Villagers without a path never reach that point.
+//
+// Storage for all villagers is allocated once for the given capacity and never grows, so indices and references stay
+// valid for the lifetime of the store. Despawned villagers free their index for the next spawn. Their slot keeps a
+// remaining distance of infinity and a speed of 0, so moveVillagers can still run over all slots up to size() without
+// checking which ones are in use.
+//
+// Instead of calling moveVillagers every tick, villagers can also be moved event-driven: positions then stay at the
+// start of the segment, which together with m_segmentStartTime is enough to compute the arrival time up front and the
+// current position on demand using positionAt.
+//
+// Villagers no one is looking at can be held back by moveVillagers and caught up later with catchUpVillager, which
+// walks them whole tiles at a time and enters the same tiles, with the same stress, as moving them every tick would.
+// Only time spent moving is held back, a villager that waits for a path off screen does not jump ahead once it has one.
+//
+// Every villager occupies the tile it has last entered in occupancy(), from its first path until it is despawned.
+class VillagerStore final
+{
+public:
+   VillagerStore(const std::size_t capacity, const std::size_t worldWidthTiles, const std::size_t worldHeightTiles);
+
+   VillagerStore(const VillagerStore&) = delete;
+   VillagerStore(VillagerStore&&) noexcept = default;
+
+   ~VillagerStore() = default;
+
+   VillagerStore& operator=(const VillagerStore&) = delete;
+   VillagerStore& operator=(VillagerStore&&) noexcept = default;
+
+   std::vector<float> m_positionX;
+   std::vector<float> m_positionY;
+
+   std::vector<float> m_directionX;
+   std::vector<float> m_directionY;
+
+   std::vector<float> m_remainingDistance;
+
+   // Pixels per second along the current segment, 0 if not moving
+   std::vector<float> m_speed;
+
+   // Simulation time in seconds the current segment was started at
+   std::vector<double> m_segmentStartTime;
+
+   // Seconds of movement held back, see catchUpVillager
+   std::vector<float> m_deferredTime;
+
+   // Number of slots that have ever been used, slots below that can be despawned, see isAlive
+   std::size_t size() const;
+
+   std::size_t capacity() const;
+   std::size_t aliveCount() const;
+
+   // Memory taken by the store per slot
+   static constexpr std::size_t bytesPerVillager();
+
+   // The new villager awaits a path, no index is handed out if the store is full
+   std::optional<VillagerHandle> spawn(const std::uint64_t villagerId);
+   void despawn(const std::size_t villagerIndex);
+
+   bool isAlive(const std::size_t villagerIndex) const;
+   bool isValid(const VillagerHandle handle) const;
+
+   VillagerHandle handle(const std::size_t villagerIndex) const;
+
+   Villager& villager(const std::size_t villagerIndex);
+   const Villager& villager(const std::size_t villagerIndex) const;
+
+   bool needsTick(const std::size_t villagerIndex) const;
+
+   const OccupancyGrid& occupancy() const;
+
+   // Tile index (y * width + x) in occupancy() the villager occupies, m_noTile until its first path
+   static constexpr std::uint32_t m_noTile = std::numeric_limits<std::uint32_t>::max();
+
+   std::uint32_t occupiedTile(const std::size_t villagerIndex) const;
+
+   // Moves the villagers in [beginIndex, endIndex) along their current segments, without any branches or square
+   // roots per villager
+   void moveVillagers(const std::size_t beginIndex, const std::size_t endIndex, const float delta);
+
+   // Same as above, but villagers whose entry in onScreen is 0 are not moved, delta is added to their deferred time if
+   // they are moving
+   void moveVillagers(const std::size_t beginIndex, const std::size_t endIndex, const float delta, const std::uint8_t* onScreen);
+
+   bool hasDeferredTime(const std::size_t villagerIndex) const;
+
+   // Handles a villager needsTick is true for, or whose arrival time has come if moved event-driven. Only reads the
+   // world, stress for tiles walked onto is appended to stressDeltas.
+   void tickVillager(
+      const std::size_t villagerIndex,
+      const WorldMap& worldMap,
+      std::vector<DesirePathStressDelta>& stressDeltas,
+      const int tileWidthPixels,
+      const int tileHeightPixels,
+      const std::uint64_t seed,
+      const double time
+   );
+
+   // Moves a villager by all of its deferred time, one tile at a time, handling every tile reached on the way like
+   // tickVillager does
+   void catchUpVillager(
+      const std::size_t villagerIndex,
+      const WorldMap& worldMap,
+      std::vector<DesirePathStressDelta>& stressDeltas,
+      const int tileWidthPixels,
+      const int tileHeightPixels,
+      const std::uint64_t seed,
+      const double time
+   );
+
+   // Walks the whole path of a villager in State::PathProvided at once: stress for every tile on the path is appended
+   // to stressDeltas, the villager ends up on the last tile, awaiting the next path
+   void walkPath(
+      const std::size_t villagerIndex,
+      const WorldMap& worldMap,
+      std::vector<DesirePathStressDelta>& stressDeltas,
+      const int tileWidthPixels,
+      const int tileHeightPixels,
+      const std::uint64_t seed
+   );
+
+   // Only valid if moved event-driven
+   double arrivalTime(const std::size_t villagerIndex) const;
+   Vector2 positionAt(const std::size_t villagerIndex, const double time) const;
+
+   // Paths with less than two tiles are rejected and leave the villager awaiting a new one
+   void setPath(const std::size_t villagerIndex, SharedPath path);
+
+   // Drops the current path without moving the villager
+   void stop(const std::size_t villagerIndex);
+
+private:
+   std::vector<Villager> m_villagers;
+
+   // Incremented on every despawn
+   std::vector<std::uint32_t> m_generations;
+
+   // Despawned indices, the most recently freed one is reused first
+   std::vector<std::size_t> m_freeIndices;
+
+   std::size_t m_usedSlotCount = 0;
+
+   OccupancyGrid m_occupancy;
+
+   // See occupiedTile
+   std::vector<std::uint32_t> m_occupiedTiles;
+
+   void beginSegment(const std::size_t villagerIndex, const int tileWidthPixels, const int tileHeightPixels, const double startTime);
+
+   // The arrays must not overlap, which lets the compiler vectorise the loop
+   static void moveAlongSegments(
+      float* __restrict positionX,
+      float* __restrict positionY,
+      float* __restrict remainingDistance,
+      const float* __restrict directionX,
+      const float* __restrict directionY,
+      const float* __restrict speed,
+      const std::size_t count,
+      const float delta
+   );
+
+   static void moveAlongSegmentsOnScreen(
+      float* __restrict positionX,
+      float* __restrict positionY,
+      float* __restrict remainingDistance,
+      float* __restrict deferredTime,
+      const float* __restrict directionX,
+      const float* __restrict directionY,
+      const float* __restrict speed,
+      const std::uint8_t* __restrict onScreen,
+      const std::size_t count,
+      const float delta
+   );
+
+   // Stress for the tile at pathIndex of the current path is drawn from a stream keyed by villager, trip and path
+   // index, so walking a path adds the same stress no matter in which ticks the tiles are reached
+   void moveOntoTile(
+      const std::size_t villagerIndex,
+      const std::size_t pathIndex,
+      const WorldMap& worldMap,
+      std::vector<DesirePathStressDelta>& stressDeltas,
+      const std::uint64_t seed
+   );
+
+   void leaveTile(const std::size_t villagerIndex);
+};
+
+inline std::size_t VillagerStore::size() const
+{
+   return m_usedSlotCount;
+}
+
+inline std::size_t VillagerStore::capacity() const
+{
+   return m_villagers.size();
+}
+
+inline std::size_t VillagerStore::aliveCount() const
+{
+   return m_usedSlotCount - m_freeIndices.size();
+}
+
+constexpr std::size_t VillagerStore::bytesPerVillager()
+{
+   return 7 * sizeof(float) + sizeof(double) + sizeof(Villager) + 2 * sizeof(std::uint32_t) + sizeof(std::size_t);
+}
+
+inline bool VillagerStore::isAlive(const std::size_t villagerIndex) const
+{
+   return (m_villagers[villagerIndex].getState() != Villager::State::Despawned);
+}
+
+inline bool VillagerStore::isValid(const VillagerHandle handle) const
+{
+   return (handle.index < m_usedSlotCount && m_generations[handle.index] == handle.generation && isAlive(handle.index));
+}
+
+inline VillagerHandle VillagerStore::handle(const std::size_t villagerIndex) const
+{
+   return {static_cast<std::uint32_t>(villagerIndex), m_generations[villagerIndex]};
+}
+
+inline Villager& VillagerStore::villager(const std::size_t villagerIndex)
+{
+   return m_villagers[villagerIndex];
+}
+
+inline const Villager& VillagerStore::villager(const std::size_t villagerIndex) const
+{
+   return m_villagers[villagerIndex];
+}
+
+inline bool VillagerStore::needsTick(const std::size_t villagerIndex) const
+{
+   return (m_remainingDistance[villagerIndex] <= 0.0f);
+}
+
+inline const OccupancyGrid& VillagerStore::occupancy() const
+{
+   return m_occupancy;
+}
+
+inline std::uint32_t VillagerStore::occupiedTile(const std::size_t villagerIndex) const
+{
+   return m_occupiedTiles[villagerIndex];
+}
+
+inline bool VillagerStore::hasDeferredTime(const std::size_t villagerIndex) const
+{
+   return (m_deferredTime[villagerIndex] > 0.0f);
+}
+
+inline double VillagerStore::arrivalTime(const std::size_t villagerIndex) const
+{
+   if (m_speed[villagerIndex] <= 0.0f)
+      return m_segmentStartTime[villagerIndex];
+
+   return m_segmentStartTime[villagerIndex] + static_cast<double>(m_remainingDistance[villagerIndex] / m_speed[villagerIndex]);
+}
+
+inline Vector2 VillagerStore::positionAt(const std::size_t villagerIndex, const double time) const
+{
+   const auto travelled = std::clamp(static_cast<float>(time - m_segmentStartTime[villagerIndex]) * m_speed[villagerIndex], 0.0f, std::max(m_remainingDistance[villagerIndex], 0.0f));
+
+   return {m_positionX[villagerIndex] + m_directionX[villagerIndex] * travelled, m_positionY[villagerIndex] + m_directionY[villagerIndex] * travelled};
+}
+
+inline void VillagerStore::moveVillagers(const std::size_t beginIndex, const std::size_t endIndex, const float delta)
+{
+   moveAlongSegments(
+      m_positionX.data() + beginIndex,
+      m_positionY.data() + beginIndex,
+      m_remainingDistance.data() + beginIndex,
+      m_directionX.data() + beginIndex,
+      m_directionY.data() + beginIndex,
+      m_speed.data() + beginIndex,
+      endIndex - beginIndex,
+      delta
+   );
+}
+
+inline void VillagerStore::moveVillagers(const std::size_t beginIndex, const std::size_t endIndex, const float delta, const std::uint8_t* onScreen)
+{
+   moveAlongSegmentsOnScreen(
+      m_positionX.data() + beginIndex,
+      m_positionY.data() + beginIndex,
+      m_remainingDistance.data() + beginIndex,
+      m_deferredTime.data() + beginIndex,
+      m_directionX.data() + beginIndex,
+      m_directionY.data() + beginIndex,
+      m_speed.data() + beginIndex,
+      onScreen + beginIndex,
+      endIndex - beginIndex,
+      delta
+   );
+}
+
+inline void VillagerStore::moveAlongSegments(
+   float* __restrict positionX,
+   float* __restrict positionY,
+   float* __restrict remainingDistance,
+   const float* __restrict directionX,
+   const float* __restrict directionY,
+   const float* __restrict speed,
+   const std::size_t count,
+   const float delta
+)
+{
+   for (std::size_t index = 0; index < count; ++index)
+   {
+      const float step = speed[index] * delta;
+
+      positionX[index] += directionX[index] * step;
+      positionY[index] += directionY[index] * step;
+
+      remainingDistance[index] -= step;
+   }
+}
+
+inline void VillagerStore::moveAlongSegmentsOnScreen(
+   float* __restrict positionX,
+   float* __restrict positionY,
+   float* __restrict remainingDistance,
+   float* __restrict deferredTime,
+   const float* __restrict directionX,
+   const float* __restrict directionY,
+   const float* __restrict speed,
+   const std::uint8_t* __restrict onScreen,
+   const std::size_t count,
+   const float delta
+)
+{
+   for (std::size_t index = 0; index < count; ++index)
+   {
+      const float movedTime = delta * static_cast<float>(onScreen[index]);
+
+      // Only villagers walking a path have movement to make up for, waiting or despawned ones have a speed of 0
+      deferredTime[index] += (delta - movedTime) * static_cast<float>(speed[index] > 0.0f);
+
+      const float step = speed[index] * movedTime;
+
+      positionX[index] += directionX[index] * step;
+      positionY[index] += directionY[index] * step;
+
+      remainingDistance[index] -= step;
+   }
+}
+
+#endif // VILLAGERSTORE_HPP
@@ -7,8 +7,10 @@
 #include <raylib.h>
 
 #include "Map.hpp"
+#include "MappedStorage.hpp"
+#include "CounterRNG.hpp"
 
-using VoronoiMap = Map<std::size_t>;
+using VoronoiMap = Map<std::size_t, MappedStorage<std::size_t>>;
 
 struct VoronoiCentroid final
 {
@@ -51,7 +53,7 @@ inline bool alwaysTruePredicate(const std::size_t, const std::size_t)
 }
 
 template<typename PredT = decltype(alwaysTruePredicate)>
-VoronoiCentroidList generateCentroids(const std::size_t areaLeft, const std::size_t areaTop, const std::size_t areaWidth, const std::size_t areaHeight, const std::size_t count, std::mt19937_64& rng, PredT predicate = alwaysTruePredicate)
+VoronoiCentroidList generateCentroids(const std::size_t areaLeft, const std::size_t areaTop, const std::size_t areaWidth, const std::size_t areaHeight, const std::size_t count, CounterRNG& rng, PredT predicate = alwaysTruePredicate)
 {
    VoronoiCentroidList centroidList;
 
@@ -119,7 +121,7 @@ void subdivide(
    const std::size_t subdivideCentroidIndex,
    VoronoiMap& voronoiMap,
    const std::size_t centroidCountToAdd,
-   std::mt19937_64& rng,
+   CounterRNG& rng,
    DistanceF getDistance
 )
 {
@@ -132,68 +134,37 @@ void subdivide(
    std::size_t bottomRightX = 0;
    std::size_t bottomRightY = 0;
 
-   for (std::size_t voronoiY = 0; voronoiY < voronoiMap.height(); ++voronoiY)
+   // Chunk by chunk, every page of the map is only touched once
+   voronoiMap.forEachInRect(0, 0, voronoiMap.width(), voronoiMap.height(), [&] (const std::size_t voronoiX, const std::size_t voronoiY, const std::size_t centroidIndex)
    {
-      for (std::size_t voronoiX = 0; voronoiX < voronoiMap.width(); ++voronoiX)
+      if (centroidIndex == subdivideCentroidIndex)
       {
-         if (voronoiMap.at(voronoiX, voronoiY) == subdivideCentroidIndex)
-         {
-            if (voronoiX < topLeftX)
-            {
-               topLeftX = voronoiX;
-            }
-
-            if (voronoiX > bottomRightX)
-            {
-               bottomRightX = voronoiX;
-            }
-
-            if (voronoiY < topLeftY)
-            {
-               topLeftY = voronoiY;
-            }
-
-            if (voronoiY > bottomRightY)
-            {
-               bottomRightY = voronoiY;
-            }
-         }
+         topLeftX = std::min(topLeftX, voronoiX);
+         topLeftY = std::min(topLeftY, voronoiY);
+         bottomRightX = std::max(bottomRightX, voronoiX);
+         bottomRightY = std::max(bottomRightY, voronoiY);
       }
-   }
+   });
 
+   // The area is subdivided in place, within its bounding box
    const auto innerVoronoiMapWidth = bottomRightX - topLeftX + 1;
    const auto innerVoronoiMapHeight = bottomRightY - topLeftY + 1;
 
-   VoronoiMap newVoronoiMap{innerVoronoiMapWidth, innerVoronoiMapHeight};
-
    // Create new set of Centroids within the chosen area
-   const auto newCentroids = Voronoi::generateCentroids(topLeftX, topLeftY, newVoronoiMap.width(), newVoronoiMap.height(), centroidCountToAdd, rng, [&] (const std::size_t kiX, const std::size_t kiY)
+   const auto newCentroids = Voronoi::generateCentroids(topLeftX, topLeftY, innerVoronoiMapWidth, innerVoronoiMapHeight, centroidCountToAdd, rng, [&] (const std::size_t kiX, const std::size_t kiY)
    {
       return (voronoiMap.at(kiX, kiY) == subdivideCentroidIndex);
    });
 
-   for (std::size_t innerVoronoiY = 0; innerVoronoiY < innerVoronoiMapHeight; ++innerVoronoiY)
-   {
-      for (std::size_t innerVoronoiX = 0; innerVoronoiX < innerVoronoiMapWidth; ++innerVoronoiX)
-      {
-         newVoronoiMap.at(innerVoronoiX, innerVoronoiY) = getShortestDistanceCentroidIndex(topLeftX + innerVoronoiX, topLeftY + innerVoronoiY, newCentroids, getDistance);
-      }
-   }
    // Combine inner with outer
 
-   for (std::size_t innerVoronoiY = 0; innerVoronoiY < innerVoronoiMapHeight; ++innerVoronoiY)
+   voronoiMap.forEachInRect(topLeftX, topLeftY, bottomRightX + 1, bottomRightY + 1, [&] (const std::size_t voronoiX, const std::size_t voronoiY, std::size_t& centroidIndex)
    {
-      for (std::size_t innerVoronoiX = 0; innerVoronoiX < innerVoronoiMapWidth; ++innerVoronoiX)
+      if (centroidIndex == subdivideCentroidIndex)
       {
-         const auto outerVoronoiX = topLeftX + innerVoronoiX;
-         const auto outerVoronoiY = topLeftY + innerVoronoiY;
-
-         if (voronoiMap.at(outerVoronoiX, outerVoronoiY) == subdivideCentroidIndex)
-         {
-            voronoiMap.at(outerVoronoiX, outerVoronoiY) = newVoronoiMap.at(innerVoronoiX, innerVoronoiY) + newCentroidStartIndex;
-         }
+         centroidIndex = getShortestDistanceCentroidIndex(voronoiX, voronoiY, newCentroids, getDistance) + newCentroidStartIndex;
       }
-   }
+   });
 
    // Extend Centroid list
 
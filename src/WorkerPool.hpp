@@ -0,0 +1,175 @@
+#ifndef WORKERPOOL_HPP
+#define WORKERPOOL_HPP
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstdint>
+
+// Persistent set of threads for splitting per-frame work into independent tasks. The calling thread takes part in
+// processing, so a pool with a thread count of 1 runs everything inline without any synchronization.
+class WorkerPool final
+{
+public:
+   explicit WorkerPool(const std::size_t threadCount);
+
+   WorkerPool(const WorkerPool&) = delete;
+   WorkerPool(WorkerPool&&) = delete;
+
+   ~WorkerPool();
+
+   WorkerPool& operator=(const WorkerPool&) = delete;
+   WorkerPool& operator=(WorkerPool&&) = delete;
+
+   std::size_t threadCount() const;
+
+   // Calls task(taskIndex) for every taskIndex in [0, taskCount) and returns once all of them are done.
+   // There is no guarantee about which thread processes which task or in which order.
+   template<typename TaskF>
+   void run(const std::size_t taskCount, TaskF task);
+
+private:
+   std::vector<std::thread> m_threads;
+
+   std::mutex m_mutex;
+   std::condition_variable m_startCond;
+   std::condition_variable m_doneCond;
+
+   // The task stays on the stack of run() until all threads are done with it, so it is only referenced, which keeps
+   // handing it over free of heap allocations whatever it captures
+   void (*m_callTask)(void* task, std::size_t taskIndex) = nullptr;
+   void* m_task = nullptr;
+   std::size_t m_taskCount = 0;
+   std::atomic<std::size_t> m_nextTaskIndex = 0;
+
+   std::size_t m_busyThreadCount = 0;
+   std::uint64_t m_generation = 0;
+   bool m_stop = false;
+
+   void workerLoop();
+   void processTasks();
+};
+
+inline WorkerPool::WorkerPool(const std::size_t threadCount)
+{
+   if (threadCount > 1)
+   {
+      m_threads.reserve(threadCount - 1);
+
+      for (std::size_t threadIndex = 1; threadIndex < threadCount; ++threadIndex)
+      {
+         m_threads.emplace_back([this] { workerLoop(); });
+      }
+   }
+}
+
+inline WorkerPool::~WorkerPool()
+{
+   {
+      std::lock_guard lock{m_mutex};
+
+      m_stop = true;
+   }
+
+   m_startCond.notify_all();
+
+   for (auto& thread : m_threads)
+   {
+      thread.join();
+   }
+}
+
+inline std::size_t WorkerPool::threadCount() const
+{
+   return m_threads.size() + 1;
+}
+
+template<typename TaskF>
+void WorkerPool::run(const std::size_t taskCount, TaskF task)
+{
+   if (m_threads.empty() || taskCount <= 1)
+   {
+      for (std::size_t taskIndex = 0; taskIndex < taskCount; ++taskIndex)
+      {
+         task(taskIndex);
+      }
+
+      return;
+   }
+
+   {
+      std::lock_guard lock{m_mutex};
+
+      m_callTask = [] (void* task, const std::size_t taskIndex) { (*static_cast<TaskF*>(task))(taskIndex); };
+      m_task = &task;
+      m_taskCount = taskCount;
+      m_nextTaskIndex.store(0);
+
+      m_busyThreadCount = m_threads.size();
+      m_generation += 1;
+   }
+
+   m_startCond.notify_all();
+
+   processTasks();
+
+   std::unique_lock lock{m_mutex};
+
+   m_doneCond.wait(lock, [&] { return m_busyThreadCount == 0; });
+
+   m_callTask = nullptr;
+   m_task = nullptr;
+}
+
+inline void WorkerPool::workerLoop()
+{
+   std::uint64_t lastGeneration = 0;
+
+   for (;;)
+   {
+      {
+         std::unique_lock lock{m_mutex};
+
+         m_startCond.wait(lock, [&] { return m_stop || m_generation != lastGeneration; });
+
+         if (m_stop)
+            return;
+
+         lastGeneration = m_generation;
+      }
+
+      processTasks();
+
+      bool lastOneDone = false;
+
+      {
+         std::lock_guard lock{m_mutex};
+
+         m_busyThreadCount -= 1;
+
+         lastOneDone = (m_busyThreadCount == 0);
+      }
+
+      if (lastOneDone)
+      {
+         m_doneCond.notify_one();
+      }
+   }
+}
+
+inline void WorkerPool::processTasks()
+{
+   for (;;)
+   {
+      const auto taskIndex = m_nextTaskIndex.fetch_add(1);
+
+      if (taskIndex >= m_taskCount)
+         break;
+
+      m_callTask(m_task, taskIndex);
+   }
+}
+
+#endif // WORKERPOOL_HPP
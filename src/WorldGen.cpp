@@ -1,8 +1,6 @@
 #include "WorldGen.hpp"
 
-#include <stack>
-
-WorldGen::WorldGen(WorldMap& worldMap, std::mt19937_64& rng):
+WorldGen::WorldGen(WorldMap& worldMap, CounterRNG& rng):
    m_worldMap{worldMap},
    m_rng{rng},
    m_rngScaledPercent{1, 100 * m_rngScaledPercentFactor},
@@ -12,8 +10,10 @@ WorldGen::WorldGen(WorldMap& worldMap, std::mt19937_64& rng):
    // NOP
 }
 
-bool WorldGen::findPattern(const Pattern& pattern, std::size_t& x, std::size_t& y, const std::size_t startX, const std::size_t startY) const
+bool WorldGen::findPattern(const MapView<TileType>& pattern, std::size_t& x, std::size_t& y, const std::size_t startX, const std::size_t startY) const
 {
+   const auto chunkEdgeTiles = m_worldMap.storage().m_chunkEdgeTiles;
+
    for (std::size_t mapY = startY; mapY < m_worldMap.height() - pattern.height() + 1; ++mapY)
    {
       for (std::size_t mapX = (mapY == startY ? startX : 0); mapX < m_worldMap.width() - pattern.width() + 1; ++mapX)
@@ -22,12 +22,22 @@ bool WorldGen::findPattern(const Pattern& pattern, std::size_t& x, std::size_t&
 
          for (std::size_t patternY = 0; patternY < pattern.height(); ++patternY)
          {
-            for (std::size_t patternX = 0; patternX < pattern.width(); ++patternX)
+            // Tiles of a row are only next to each other up to the edge of a chunk
+            const auto* worldMapTile = &m_worldMap.at(mapX, mapY + patternY);
+            auto tilesLeftInChunk = chunkEdgeTiles - mapX % chunkEdgeTiles;
+
+            for (std::size_t patternX = 0; patternX < pattern.width(); ++patternX, ++worldMapTile, --tilesLeftInChunk)
             {
+               if (tilesLeftInChunk == 0)
+               {
+                  worldMapTile = &m_worldMap.at(mapX + patternX, mapY + patternY);
+                  tilesLeftInChunk = chunkEdgeTiles;
+               }
+
                if (pattern.at(patternX, patternY) == TileType::PatternAny)
                   continue;
 
-               if (m_worldMap.at(mapX + patternX, mapY + patternY) != pattern.at(patternX, patternY))
+               if (*worldMapTile != pattern.at(patternX, patternY))
                {
                   breakPattern = true;
                   break;
@@ -52,7 +62,7 @@ bool WorldGen::findPattern(const Pattern& pattern, std::size_t& x, std::size_t&
    return false;
 }
 
-void WorldGen::applyPatch(const Patch& patch, const std::size_t x, const std::size_t y)
+void WorldGen::applyPatch(const MapView<TileType>& patch, const std::size_t x, const std::size_t y)
 {
    for (std::size_t patchY = 0; patchY < patch.height(); ++patchY)
    {
@@ -73,7 +83,7 @@ std::size_t WorldGen::floodFill(const std::size_t x, const std::size_t y, const
 
    std::size_t count = 0;
 
-   std::stack<std::pair<std::size_t, std::size_t>> coordStack;
+   auto& coordStack = m_floodFillStack;
 
    coordStack.emplace(x, y);
 
@@ -253,16 +263,13 @@ void WorldGen::placeFullPavedAreas(const float fillLimitInPercent, const float a
 
 void WorldGen::replaceAll(const TileType replaceWhat, const TileType replaceWith)
 {
-   for (std::size_t y = 0; y < m_worldMap.height(); ++y)
+   m_worldMap.forEachInRect(0, 0, m_worldMap.width(), m_worldMap.height(), [&] (const std::size_t /*x*/, const std::size_t /*y*/, TileType& tileType)
    {
-      for (std::size_t x = 0; x < m_worldMap.width(); ++x)
+      if (tileType == replaceWhat)
       {
-         if (m_worldMap.at(x, y) == replaceWhat)
-         {
-            m_worldMap.at(x, y) = replaceWith;
-         }
+         tileType = replaceWith;
       }
-   }
+   });
 }
 
 void WorldGen::placeBuildings(const int fillRate)
@@ -291,8 +298,14 @@ void WorldGen::placeBuildings(const int fillRate)
    const std::size_t minEstateHeight = minBuildingHeight + 5;
    const std::size_t maxEstateHeight = maxBuildingHeight + 5;
 
-   std::vector<Pattern> patterns;
-   std::vector<std::vector<Patch>> patches; // Inner array is for variations
+   using PatchVariations = std::vector<Patch, ArenaAllocator<Patch>>;
+
+   m_phaseArena.reset();
+
+   const ArenaAllocator<TileType> phaseAllocator{m_phaseArena};
+
+   std::vector<Pattern, ArenaAllocator<Pattern>> patterns{phaseAllocator};
+   std::vector<PatchVariations, ArenaAllocator<PatchVariations>> patches{phaseAllocator};
 
    patterns.reserve((maxBuildingWidth - minBuildingWidth) * (maxBuildingHeight - minBuildingHeight));
    patches.reserve(patterns.capacity());
@@ -301,7 +314,7 @@ void WorldGen::placeBuildings(const int fillRate)
    {
       for (std::size_t estateWidth = minEstateWidth; estateWidth <= maxEstateWidth; ++estateWidth)
       {
-         Patch pattern{estateWidth, estateHeight, TileType::Grass};
+         Pattern pattern{estateWidth, estateHeight, TileType::Grass, phaseAllocator};
 
          // Street short
          for (std::size_t x = 0; x < pattern.width(); ++x)
@@ -322,13 +335,13 @@ void WorldGen::placeBuildings(const int fillRate)
 
          patterns.emplace_back(std::move(pattern));
 
-         std::vector<Patch> patchVariations;
+         PatchVariations patchVariations{phaseAllocator};
 
          for (std::size_t buildingHeight = minBuildingHeight; buildingHeight <= estateHeight - 5; ++buildingHeight)
          {
             const auto buildingWidth = estateWidth - 2;
 
-            Patch patch{estateWidth, estateHeight, TileType::PatchKeep};
+            Patch patch{estateWidth, estateHeight, TileType::PatchKeep, phaseAllocator};
 
             // Building
             for (std::size_t y = 1; y <= buildingHeight; ++y)
@@ -478,7 +491,7 @@ void WorldGen::placeBuildings(const int fillRate)
       }
    }
 
-   auto applyPatches = [this] (const Pattern& pattern, const std::vector<Patch>& patchVariations, const int scaledFillRate)
+   auto applyPatches = [this] (const MapView<TileType>& pattern, const PatchVariations& patchVariations, const std::size_t quarterTurns, const int scaledFillRate)
    {
       std::size_t patternPosX = 0;
       std::size_t patternPosY = 0;
@@ -495,7 +508,7 @@ void WorldGen::placeBuildings(const int fillRate)
          {
             const auto& patch = patchVariations[std::uniform_int_distribution<std::size_t>{0, patchVariations.size() - 1}(m_rng)];
 
-            applyPatch(patch, patternPosX, patternPosY);
+            applyPatch(MapView<TileType>{patch}.rotatedCW(quarterTurns), patternPosX, patternPosY);
          }
 
          findStartPosX = patternPosX + pattern.width();
@@ -503,78 +516,16 @@ void WorldGen::placeBuildings(const int fillRate)
       }
    };
 
-   for (std::size_t index = patterns.size(); index --> 0;)
-   {
-      const auto scaledFillRate = fillRate * m_rngScaledPercentFactor / static_cast<int>(patterns.size()) * m_rngScaledPercentFactor;
-
-      applyPatches(patterns[index], patches[index], scaledFillRate);
-   }
-
-   // Rotate
-
-   for (auto& pattern : patterns)
-   {
-      pattern = pattern.rotated90CW();
-   }
-
-   for (auto& patchVariations : patches)
-   {
-      for (auto& patchVariation : patchVariations)
-      {
-         patchVariation = patchVariation.rotated90CW();
-      }
-   }
-
-   for (std::size_t index = patterns.size(); index --> 0;)
+   // Once per direction, patterns and patches are rotated as views instead of copies
+   for (std::size_t quarterTurns = 0; quarterTurns < 4; ++quarterTurns)
    {
-      const auto scaledFillRate = fillRate * m_rngScaledPercentFactor / static_cast<int>(patterns.size()) * m_rngScaledPercentFactor;
-
-      applyPatches(patterns[index], patches[index], scaledFillRate);
-   }
-
-   // Rotate
-
-   for (auto& pattern : patterns)
-   {
-      pattern = pattern.rotated90CW();
-   }
-
-   for (auto& patchVariations : patches)
-   {
-      for (auto& patchVariation : patchVariations)
+      for (std::size_t index = patterns.size(); index --> 0;)
       {
-         patchVariation = patchVariation.rotated90CW();
-      }
-   }
+         const auto scaledFillRate = fillRate * m_rngScaledPercentFactor / static_cast<int>(patterns.size()) * m_rngScaledPercentFactor;
 
-   for (std::size_t index = patterns.size(); index --> 0;)
-   {
-      const auto scaledFillRate = fillRate * m_rngScaledPercentFactor / static_cast<int>(patterns.size()) * m_rngScaledPercentFactor;
-
-      applyPatches(patterns[index], patches[index], scaledFillRate);
-   }
-
-   // Rotate
-
-   for (auto& pattern : patterns)
-   {
-      pattern = pattern.rotated90CW();
-   }
-
-   for (auto& patchVariations : patches)
-   {
-      for (auto& patchVariation : patchVariations)
-      {
-         patchVariation = patchVariation.rotated90CW();
+         applyPatches(MapView<TileType>{patterns[index]}.rotatedCW(quarterTurns), patches[index], quarterTurns, scaledFillRate);
       }
    }
-
-   for (std::size_t index = patterns.size(); index --> 0;)
-   {
-      const auto scaledFillRate = fillRate * m_rngScaledPercentFactor / static_cast<int>(patterns.size()) * m_rngScaledPercentFactor;
-
-      applyPatches(patterns[index], patches[index], scaledFillRate);
-   }
 }
 
 void WorldGen::placeLargeTrees(const int fillRate)
@@ -776,8 +727,10 @@ void WorldGen::placeRoundaboutsB()
          ->  .1111.
    */
 
-   Pattern crossingStreetPatternA{4, 5, TileType::Street};
-   Pattern crossingStreetPatternB{5, 4, TileType::Street};
+   m_phaseArena.reset();
+
+   Pattern crossingStreetPatternA{4, 5, TileType::Street, ArenaAllocator<TileType>{m_phaseArena}};
+   Pattern crossingStreetPatternB{5, 4, TileType::Street, ArenaAllocator<TileType>{m_phaseArena}};
 
    auto placeRoundabout = [&] (const std::size_t x, const std::size_t y)
    {
@@ -2,25 +2,31 @@
 #define WORLDGEN_HPP
 
 #include <random>
+#include <stack>
+#include <vector>
 
 #include "WorldMap.hpp"
+#include "MapView.hpp"
 #include "Voronoi.hpp"
+#include "CounterRNG.hpp"
+#include "Arena.hpp"
 
 class WorldGen final
 {
 public:
-   using Pattern  = Map<TileType>;
-   using Patch    = Map<TileType>;
+   // Only live for one phase, made in m_phaseArena
+   using Pattern  = Map<TileType, RowMajorStorage<TileType, ArenaAllocator<TileType>>>;
+   using Patch    = Map<TileType, RowMajorStorage<TileType, ArenaAllocator<TileType>>>;
 
 public:
-   WorldGen(WorldMap& worldMap, std::mt19937_64& rng);
+   WorldGen(WorldMap& worldMap, CounterRNG& rng);
 
-   WorldGen(const WorldGen&) = default;
+   WorldGen(const WorldGen&) = delete;
    WorldGen(WorldGen&&) noexcept = default;
 
    ~WorldGen() = default;
 
-   WorldGen& operator=(const WorldGen&) = default;
+   WorldGen& operator=(const WorldGen&) = delete;
    WorldGen& operator=(WorldGen&&) noexcept = default;
 
    void placeStreetsFromVoronoiMap(const VoronoiMap& voronoiMap);
@@ -44,14 +50,20 @@ private:
 
    WorldMap& m_worldMap;
 
-   std::mt19937_64& m_rng;
+   CounterRNG& m_rng;
    std::uniform_int_distribution<> m_rngScaledPercent; // Scaled by m_rngScaledPercentFactor
    std::uniform_int_distribution<std::size_t> m_rngWorldMapWidth;
    std::uniform_int_distribution<std::size_t> m_rngWorldMapHeight;
 
-   bool findPattern(const Pattern& pattern, std::size_t& x, std::size_t& y, const std::size_t startX = 0, const std::size_t startY = 0) const;
+   // Patterns, patches and their containers, reset at the start of every phase using them
+   Arena m_phaseArena;
 
-   void applyPatch(const Patch& patch, const std::size_t x, const std::size_t y);
+   // Reused by floodFill to keep its capacity
+   std::stack<std::pair<std::size_t, std::size_t>, std::vector<std::pair<std::size_t, std::size_t>>> m_floodFillStack;
+
+   bool findPattern(const MapView<TileType>& pattern, std::size_t& x, std::size_t& y, const std::size_t startX = 0, const std::size_t startY = 0) const;
+
+   void applyPatch(const MapView<TileType>& patch, const std::size_t x, const std::size_t y);
 
    std::size_t floodFill(const std::size_t x, const std::size_t y, const TileType fillTileType);
 };
@@ -4,11 +4,13 @@
 #include <random>
 
 #include "Map.hpp"
+#include "MappedStorage.hpp"
 #include "TileType.hpp"
+#include "CounterRNG.hpp"
 
-using WorldMap = Map<TileType>;
+using WorldMap = Map<TileType, MappedStorage<TileType>>;
 
-inline std::uint8_t getBaseCostForValue(const TileType tileType, std::mt19937_64& rng)
+inline std::uint8_t getBaseCostForValue(const TileType tileType, CounterRNG& rng)
 {
    switch (tileType)
    {
@@ -0,0 +1,40 @@
+#ifndef WORLDSNAPSHOT_HPP
+#define WORLDSNAPSHOT_HPP
+
+#include <vector>
+#include <memory>
+#include <optional>
+#include <cstdint>
+
+#include "ChunkedSnapshot.hpp"
+#include "WorldMap.hpp"
+#include "CostMap.hpp"
+#include "TileRecord.hpp"
+
+using WorldMapView   = ChunkedSnapshot<TileType>::View;
+using CostMapView    = ChunkedSnapshot<std::uint8_t>::View;
+using TileRecordView = ChunkedSnapshot<TileRecord>::View;
+
+// Read-only state of all layers pathfinding depends on. All layers are always published together, so a search
+// sees the world map and the cost maps of the same simulation frame.
+struct WorldSnapshot final
+{
+   // Simulation tick the snapshot was published in
+   std::uint64_t tickIndex = 0;
+
+   WorldMapView worldMap;
+   CostMapView baseCostMap;
+
+   // Added on top of the base cost, all 0 unless crowding is taken into account
+   CostMapView congestionCostMap;
+
+   // The three layers above packed per tile, only published if packed tile records are enabled. Pathfinding prefers
+   // them if present.
+   std::optional<TileRecordView> tileRecords;
+
+   // Row-major indices of all building entrance tiles, ascending. Only world generation places entrances, so every
+   // snapshot shares the same list.
+   std::shared_ptr<const std::vector<std::uint64_t>> buildingEntrances;
+};
+
+#endif // WORLDSNAPSHOT_HPP
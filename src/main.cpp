@@ -18,6 +18,16 @@ catch (...)
    throw std::runtime_error{"Error parsing argument \"" + arg + "\""};
 }
 
+std::optional<std::string> tryReadArgStr(const std::string& arg, const std::string& name)
+{
+   std::string argStart = '-' + name + '=';
+
+   if (arg.find(argStart) == 0)
+      return arg.substr(argStart.length());
+
+   return std::nullopt;
+}
+
 std::optional<bool> tryReadArgBool(const std::string& arg, const std::string& name)
 {
    const auto v = tryReadArgInt(arg, name);
@@ -38,25 +48,49 @@ int main(int argc, char** argv)
       {
          std::string arg = argv[argIndex];
 
-              if (auto v = tryReadArgInt (arg, "width"                 ); v.has_value()) options.screenWidthPixels                 = v.value();
-         else if (auto v = tryReadArgInt (arg, "height"                ); v.has_value()) options.screenHeightPixels                = v.value();
-         else if (auto v = tryReadArgInt (arg, "target_fps"            ); v.has_value()) options.targetFPS                         = v.value();
-         else if (auto v = tryReadArgBool(arg, "remove_streets"        ); v.has_value()) options.removeStreetsAfterGeneration      = v.value();
-         else if (auto v = tryReadArgInt (arg, "villager_count"        ); v.has_value()) options.villagerCount                     = v.value();
-         else if (auto v = tryReadArgInt (arg, "centroid_count"        ); v.has_value()) options.voronoiCentroidCountPerLevel      = v.value();
-         else if (auto v = tryReadArgInt (arg, "subdiv_prob_1"         ); v.has_value()) options.voronoiSubdivideProbabilityLevel1 = v.value();
-         else if (auto v = tryReadArgInt (arg, "subdiv_prob_2"         ); v.has_value()) options.voronoiSubdivideProbabilityLevel2 = v.value();
-         else if (auto v = tryReadArgInt (arg, "minkowski_0"           ); v.has_value()) options.voronoiLevel0MinkowskiP           = static_cast<float>(v.value());
-         else if (auto v = tryReadArgInt (arg, "minkowski_1"           ); v.has_value()) options.voronoiLevel1MinkowskiP           = static_cast<float>(v.value());
-         else if (auto v = tryReadArgInt (arg, "minkowski_2"           ); v.has_value()) options.voronoiLevel2MinkowskiP           = static_cast<float>(v.value());
-         else if (auto v = tryReadArgBool(arg, "place_roundabouts"     ); v.has_value()) options.placeRoundabouts                  = v.value();
-         else if (auto v = tryReadArgBool(arg, "place_ponds"           ); v.has_value()) options.placePonds                        = v.value();
-         else if (auto v = tryReadArgBool(arg, "place_full_paved_areas"); v.has_value()) options.placeFullPavedAreas               = v.value();
-         else if (auto v = tryReadArgBool(arg, "place_large_trees"     ); v.has_value()) options.placeLargeTrees                   = v.value();
-         else if (auto v = tryReadArgBool(arg, "place_small_trees"     ); v.has_value()) options.placeSmallTrees                   = v.value();
-         else if (auto v = tryReadArgInt (arg, "pathfinding_threads"   ); v.has_value()) options.pathfindingThreadCount            = v.value();
-         else if (auto v = tryReadArgBool(arg, "pave_desire_paths"     ); v.has_value()) options.paveDesirePaths                   = v.value();
-         else if (auto v = tryReadArgBool(arg, "decay_desire_paths"    ); v.has_value()) options.decayDesirePaths                  = v.value();
+              if (auto v = tryReadArgInt (arg, "width"                  ); v.has_value()) options.screenWidthPixels                 = v.value();
+         else if (auto v = tryReadArgInt (arg, "height"                 ); v.has_value()) options.screenHeightPixels                = v.value();
+         else if (auto v = tryReadArgInt (arg, "target_fps"             ); v.has_value()) options.targetFPS                         = v.value();
+         else if (auto v = tryReadArgInt (arg, "sim_rate"               ); v.has_value()) options.simulationTicksPerSec             = v.value();
+         else if (auto v = tryReadArgInt (arg, "sim_speed"              ); v.has_value()) options.simulationSpeed                   = v.value();
+         else if (auto v = tryReadArgInt (arg, "sim_budget_ms"          ); v.has_value()) options.simulationFrameBudgetMillisec     = v.value();
+         else if (auto v = tryReadArgBool(arg, "deterministic"          ); v.has_value()) options.deterministicSimulation           = v.value();
+         else if (auto v = tryReadArgBool(arg, "headless"               ); v.has_value()) options.headless                          = v.value();
+         else if (auto v = tryReadArgInt (arg, "sim_seconds"            ); v.has_value()) options.simulationSeconds                 = v.value();
+         else if (auto v = tryReadArgStr (arg, "output"                 ); v.has_value()) options.outputPath                        = v.value();
+         else if (auto v = tryReadArgBool(arg, "check_allocations"      ); v.has_value()) options.checkAllocations                  = v.value();
+         else if (auto v = tryReadArgInt (arg, "seed"                   ); v.has_value()) options.seed                              = static_cast<std::uint64_t>(v.value());
+         else if (auto v = tryReadArgStr (arg, "layer_dir"              ); v.has_value()) options.layerDirectory                    = v.value();
+         else if (auto v = tryReadArgBool(arg, "remove_streets"         ); v.has_value()) options.removeStreetsAfterGeneration      = v.value();
+         else if (auto v = tryReadArgInt (arg, "villager_count"         ); v.has_value()) options.villagerCount                     = v.value();
+         else if (auto v = tryReadArgInt (arg, "villager_capacity"      ); v.has_value()) options.villagerCapacity                  = v.value();
+         else if (auto v = tryReadArgInt (arg, "villager_spawn_rate"    ); v.has_value()) options.villagerSpawnRatePerSec           = v.value();
+         else if (auto v = tryReadArgInt (arg, "centroid_count"         ); v.has_value()) options.voronoiCentroidCountPerLevel      = v.value();
+         else if (auto v = tryReadArgInt (arg, "subdiv_prob_1"          ); v.has_value()) options.voronoiSubdivideProbabilityLevel1 = v.value();
+         else if (auto v = tryReadArgInt (arg, "subdiv_prob_2"          ); v.has_value()) options.voronoiSubdivideProbabilityLevel2 = v.value();
+         else if (auto v = tryReadArgInt (arg, "minkowski_0"            ); v.has_value()) options.voronoiLevel0MinkowskiP           = static_cast<float>(v.value());
+         else if (auto v = tryReadArgInt (arg, "minkowski_1"            ); v.has_value()) options.voronoiLevel1MinkowskiP           = static_cast<float>(v.value());
+         else if (auto v = tryReadArgInt (arg, "minkowski_2"            ); v.has_value()) options.voronoiLevel2MinkowskiP           = static_cast<float>(v.value());
+         else if (auto v = tryReadArgBool(arg, "place_roundabouts"      ); v.has_value()) options.placeRoundabouts                  = v.value();
+         else if (auto v = tryReadArgBool(arg, "place_ponds"            ); v.has_value()) options.placePonds                        = v.value();
+         else if (auto v = tryReadArgBool(arg, "place_full_paved_areas" ); v.has_value()) options.placeFullPavedAreas               = v.value();
+         else if (auto v = tryReadArgBool(arg, "place_large_trees"      ); v.has_value()) options.placeLargeTrees                   = v.value();
+         else if (auto v = tryReadArgBool(arg, "place_small_trees"      ); v.has_value()) options.placeSmallTrees                   = v.value();
+         else if (auto v = tryReadArgInt (arg, "pathfinding_threads"    ); v.has_value()) options.pathfindingThreadCount            = v.value();
+         else if (auto v = tryReadArgInt (arg, "pathfinding_threads_min"); v.has_value()) options.pathfindingMinThreadCount         = v.value();
+         else if (auto v = tryReadArgInt (arg, "pathfinding_threads_max"); v.has_value()) options.pathfindingMaxThreadCount         = v.value();
+         else if (auto v = tryReadArgBool(arg, "morton_pathfinding"     ); v.has_value()) options.mortonPathfinding                 = v.value();
+         else if (auto v = tryReadArgInt (arg, "path_coalesce_ticks"    ); v.has_value()) options.pathCoalesceTicks                 = v.value();
+         else if (auto v = tryReadArgInt (arg, "tick_threads"           ); v.has_value()) options.tickThreadCount                   = v.value();
+         else if (auto v = tryReadArgBool(arg, "event_driven"           ); v.has_value()) options.eventDrivenMovement               = v.value();
+         else if (auto v = tryReadArgBool(arg, "villager_lod"           ); v.has_value()) options.villagerLOD                       = v.value();
+         else if (auto v = tryReadArgBool(arg, "analytic_trips"         ); v.has_value()) options.analyticTrips                     = v.value();
+         else if (auto v = tryReadArgInt (arg, "congestion_cost"        ); v.has_value()) options.congestionCost                    = v.value();
+         else if (auto v = tryReadArgBool(arg, "packed_tiles"           ); v.has_value()) options.packedTileRecords                 = v.value();
+         else if (auto v = tryReadArgBool(arg, "pave_desire_paths"      ); v.has_value()) options.paveDesirePaths                   = v.value();
+         else if (auto v = tryReadArgBool(arg, "decay_desire_paths"     ); v.has_value()) options.decayDesirePaths                  = v.value();
+         else if (auto v = tryReadArgInt (arg, "convergence_window"     ); v.has_value()) options.convergenceWindowSeconds          = v.value();
+         else if (auto v = tryReadArgInt (arg, "convergence_permille"   ); v.has_value()) options.convergenceThresholdPerMille      = v.value();
       }
    }
    catch (const std::exception& ex)
@@ -65,9 +99,17 @@ int main(int argc, char** argv)
       return EXIT_FAILURE;
    }
 
-   DesirePathSim desirePathSim{options};
+   try
+   {
+      DesirePathSim desirePathSim{options};
 
-   desirePathSim.run();
+      desirePathSim.run();
+   }
+   catch (const std::exception& ex)
+   {
+      std::cerr << ex.what();
+      return EXIT_FAILURE;
+   }
 
    return EXIT_SUCCESS;
 }